@@ -0,0 +1,69 @@
+// Compares the virtual and the closed-set dispatch paths on the default scene.
+//
+// USAGE: DispatchBench [num_rays] [max_depth]
+//
+// Configure with -DRT2D_CLOSED_SET=ON to let the closed-set path be inlined
+// across translation units; the virtual path is measured in the same binary.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+
+using namespace RayTracer2D;
+
+template <typename F>
+static double TimeSeconds(F &&f) {
+  auto begin = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char *argv[]) {
+  size_t num_rays = argc > 1 ? atoi(argv[1]) : 200000;
+  size_t depth = argc > 2 ? atoi(argv[2]) : 25;
+  auto option = Options(256, 256, num_rays, depth);
+  auto rt = RayTracer(option);
+  const double bounces = static_cast<double>(num_rays) * depth;
+
+  // Intersection only: re-query the emitted ray so both paths do the same work.
+  auto ray = rt.EmitRay(0);
+  double sink = 0;
+  auto dynamic_hit = TimeSeconds([&] {
+    for (size_t i = 0; i < num_rays * depth; i++) {
+      sink += rt.scene_->FindFirstHit(ray)->first;
+    }
+  });
+  auto closed_hit = TimeSeconds([&] {
+    for (size_t i = 0; i < num_rays * depth; i++) {
+      sink += rt.scene_->FindFirstHitClosed(ray)->t_;
+    }
+  });
+
+  // Full bounce: intersection, normal, segment rasterization and shading.
+  // Interleave the runs so neither path benefits from a warmer image buffer.
+  double dynamic_bounce = 0;
+  double closed_bounce = 0;
+  for (auto round = 0; round < 4; round++) {
+    dynamic_bounce += TimeSeconds([&] {
+      for (size_t i = 0; i < num_rays / 4; i++) {
+        rt.PropagateRayDynamic(rt.EmitRay(round * num_rays + i), depth);
+      }
+    });
+    closed_bounce += TimeSeconds([&] {
+      for (size_t i = 0; i < num_rays / 4; i++) {
+        rt.PropagateRayClosed(rt.EmitRay(round * num_rays + i), depth);
+      }
+    });
+  }
+
+  printf("closed-set build: %s (checksum %g)\n", kClosedSetDispatch ? "yes" : "no", sink);
+  printf("%-20s %12s %12s %9s\n", "stage", "virtual", "closed", "speedup");
+  printf("%-20s %9.2f ns %9.2f ns %8.2fx\n", "intersect", 1e9 * dynamic_hit / bounces, 1e9 * closed_hit / bounces,
+         dynamic_hit / closed_hit);
+  printf("%-20s %9.2f ns %9.2f ns %8.2fx\n", "bounce", 1e9 * dynamic_bounce / bounces,
+         1e9 * closed_bounce / bounces, dynamic_bounce / closed_bounce);
+  return 0;
+}
@@ -0,0 +1,139 @@
+// Compares utils/fast_math.h against libm on the loops of the render hot paths.
+//
+// USAGE: FastMathBench [num_elements]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "utils/fast_math.h"
+
+using namespace RayTracer2D;
+
+template <typename F>
+static double TimeSeconds(F &&f) {
+  auto begin = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+static void Report(const char *stage, size_t n, double libm, double fast) {
+  printf("%-20s %9.2f ns %9.2f ns %8.2fx\n", stage, 1e9 * libm / n, 1e9 * fast / n, libm / fast);
+}
+
+int main(int argc, char *argv[]) {
+  size_t n = argc > 1 ? atoi(argv[1]) : 1 << 22;
+  auto gen = std::mt19937(1);
+  auto angles = std::vector<double>(n);
+  auto values = std::vector<double>(n);
+  auto coords = std::vector<double>(n);
+  for (size_t i = 0; i < n; i++) {
+    angles[i] = std::uniform_real_distribution<double>(-M_PI / 2, M_PI / 2)(gen);
+    values[i] = std::uniform_real_distribution<double>(0, 1000)(gen);
+    coords[i] = std::uniform_real_distribution<double>(0, 4096)(gen);
+  }
+  auto out = std::vector<double>(n);
+  double sink = 0;
+
+  printf("%-20s %12s %12s %9s\n", "stage", "libm", "fast", "speedup");
+
+  // ScatteringMaterial: one sincos per bounce.
+  auto libm_sincos = TimeSeconds([&] {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = std::cos(angles[i]) + std::sin(angles[i]);
+    }
+  });
+  sink += out[n / 2];
+  auto fast_sincos = TimeSeconds([&] {
+    for (size_t i = 0; i < n; i++) {
+      double s, c;
+      FastSinCos(angles[i], &s, &c);
+      out[i] = c + s;
+    }
+  });
+  sink += out[n / 2];
+  Report("sincos", n, libm_sincos, fast_sincos);
+
+  // AdjustGamma: the tone curve over every accumulator element.
+  auto libm_log = TimeSeconds([&] {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = std::log(values[i] + 1.5);
+    }
+  });
+  sink += out[n / 2];
+  auto fast_log = TimeSeconds([&] {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = FastLog(values[i] + 1.5);
+    }
+  });
+  sink += out[n / 2];
+  Report("tone curve (log)", n, libm_log, fast_log);
+
+  auto libm_exp = TimeSeconds([&] {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = std::exp(-angles[i] * angles[i]);
+    }
+  });
+  sink += out[n / 2];
+  auto fast_exp = TimeSeconds([&] {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = FastExp(-angles[i] * angles[i]);
+    }
+  });
+  sink += out[n / 2];
+  Report("exp", n, libm_exp, fast_exp);
+
+  // Rasterizers: one round per coordinate per pixel.
+  auto libm_round = TimeSeconds([&] {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = static_cast<int>(std::round(coords[i]));
+    }
+  });
+  sink += out[n / 2];
+  auto fast_round = TimeSeconds([&] {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = FastRound(coords[i]);
+    }
+  });
+  sink += out[n / 2];
+  Report("round", n, libm_round, fast_round);
+
+  // Image::SetPixel: nine exp calls per splat against two table lookups.
+  auto libm_splat = TimeSeconds([&] {
+    for (size_t i = 0; i + 1 < n; i += 2) {
+      auto x = coords[i], y = coords[i + 1];
+      auto xx = std::round(x), yy = std::round(y);
+      double sum = 0;
+      for (auto px = xx - 1; px <= xx + 1; px++) {
+        for (auto py = yy - 1; py <= yy + 1; py++) {
+          sum += std::exp(-(((x - px) * (x - px)) + ((y - py) * (y - py))) * .5);
+        }
+      }
+      out[i] = sum;
+    }
+  });
+  sink += out[n / 2];
+  auto fast_splat = TimeSeconds([&] {
+    for (size_t i = 0; i + 1 < n; i += 2) {
+      auto x = coords[i], y = coords[i + 1];
+      double wx[3], wy[3];
+      GaussianSplatWeights(x - FastRound(x), wx);
+      GaussianSplatWeights(y - FastRound(y), wy);
+      double sum = 0;
+      for (auto px = 0; px < 3; px++) {
+        for (auto py = 0; py < 3; py++) {
+          sum += wx[px] * wy[py];
+        }
+      }
+      out[i] = sum;
+    }
+  });
+  sink += out[n / 2];
+  Report("3x3 splat weights", n / 2, libm_splat, fast_splat);
+
+  printf("(checksum %g)\n", sink);
+  return 0;
+}
@@ -0,0 +1,211 @@
+#include "core/autotune.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "core/segment.h"
+#include "utils/hash.h"
+#include "utils/parallel.h"
+
+namespace RayTracer2D {
+
+void TunedParameters::ApplyTo(Options &option) const {
+  option.threads_ = threads_;
+  option.batch_size_ = batch_size_;
+  option.tile_size_ = tile_size_;
+  option.deferred_ = deferred_;
+}
+
+static uint64_t HashBytes(uint64_t seed, const void *data, size_t size) {
+  const auto *bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; i += 8) {
+    uint64_t word = 0;
+    memcpy(&word, bytes + i, std::min<size_t>(8, size - i));
+    seed = HashCombine(seed, word);
+  }
+  return seed;
+}
+
+auto SceneFingerprint(const Options &option, const RayTracerFactory &factory, size_t paths) -> uint64_t {
+  auto probe = option;
+  probe.sx_ = probe.sy_ = 1;
+  probe.roi_.reset();
+  probe.sparse_ = false;
+  probe.accumulator_ = AccumulatorFormat::kDouble;
+  probe.sampler_ = SamplerType::kOwenSobol;
+  probe.trace_path_.clear();
+  auto rt = factory(probe);
+
+  uint64_t hash = 0;
+  auto segments = SegmentBuffer();
+  for (size_t i = 0; i < paths; i++) {
+    segments.clear();
+    rt->PropagateRay(rt->EmitRay(i), option.depth_, &segments);
+    for (const auto &segment : segments) {
+      const double values[] = {segment.begin_.x, segment.begin_.y, segment.end_.x, segment.end_.y,
+                               segment.colour_.R_, segment.colour_.G_, segment.colour_.B_};
+      hash = HashBytes(hash, values, sizeof(values));
+    }
+  }
+  return hash;
+}
+
+auto CpuModel() -> std::string {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.rfind("model name", 0) == 0 && line.find(':') != std::string::npos) {
+      return line.substr(line.find(':') + 2);
+    }
+  }
+  return "unknown";
+}
+
+// Everything the best parameters depend on besides the scene.
+static uint64_t CacheKey(const Options &option, uint64_t fingerprint) {
+  const auto cpu = CpuModel();
+  auto key = HashBytes(fingerprint, cpu.data(), cpu.size());
+  for (uint64_t value : {static_cast<uint64_t>(ResolveThreads(0)), static_cast<uint64_t>(option.sx_),
+                         static_cast<uint64_t>(option.sy_), static_cast<uint64_t>(option.depth_),
+                         static_cast<uint64_t>(option.accumulator_), static_cast<uint64_t>(option.sparse_),
+                         static_cast<uint64_t>(option.roi_.has_value()), static_cast<uint64_t>(option.sampler_)}) {
+    key = HashCombine(key, value);
+  }
+  return key;
+}
+
+// The cache is a text file with one line per key:
+//   <key> <threads> <batch size> <tile size> <deferred> <rays per second>
+static bool ReadCache(const std::string &path, uint64_t key, TunedParameters &parameters) {
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    uint64_t line_key;
+    size_t threads, batch, tile;
+    int deferred;
+    double rate;
+    if (sscanf(line.c_str(), "%" SCNx64 " %zu %zu %zu %d %lf", &line_key, &threads, &batch, &tile, &deferred, &rate) ==
+            6 &&
+        line_key == key) {
+      parameters = TunedParameters{threads, batch, tile, deferred != 0, rate, true};
+      return true;
+    }
+  }
+  return false;
+}
+
+// Replace the entry of `key`, through a temporary file so that concurrent
+// readers never see a partial cache.
+static void WriteCache(const std::string &path, uint64_t key, const TunedParameters &parameters) {
+  std::ostringstream kept;
+  {
+    std::ifstream file(path);
+    std::string line;
+    uint64_t line_key;
+    while (std::getline(file, line)) {
+      if (sscanf(line.c_str(), "%" SCNx64, &line_key) == 1 && line_key != key) {
+        kept << line << '\n';
+      }
+    }
+  }
+  char entry[160];
+  snprintf(entry, sizeof(entry), "%016" PRIx64 " %zu %zu %zu %d %.0f\n", key, parameters.threads_,
+           parameters.batch_size_, parameters.tile_size_, parameters.deferred_ ? 1 : 0, parameters.rays_per_second_);
+  const auto temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary);
+    file << kept.str() << entry;
+    if (!file) {
+      fprintf(stderr, "can not write autotune cache %s\n", path.c_str());
+      return;
+    }
+  }
+  std::rename(temporary.c_str(), path.c_str());
+}
+
+// Rays per second of a `rays` ray render with the given parameters, best of
+// two runs so that a single hiccup does not rule out a good candidate.
+static double Measure(Options option, const TunedParameters &parameters, size_t rays, const RayTracerFactory &factory) {
+  parameters.ApplyTo(option);
+  option.num_rays_ = rays;
+  option.preview_path_.clear();
+  option.trace_path_.clear();
+  option.progress_ = false;
+  double best = 0;
+  for (int run = 0; run < 2; run++) {
+    auto rt = factory(option);
+    const auto begin = std::chrono::steady_clock::now();
+    rt->Render(parameters.threads_);
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    best = std::max(best, rays / std::max(seconds, 1e-9));
+  }
+  return best;
+}
+
+// Candidate thread counts: powers of two up to the core count, and the core
+// count itself.
+static auto ThreadCandidates() -> std::vector<size_t> {
+  const auto cores = static_cast<size_t>(ResolveThreads(0));
+  auto candidates = std::vector<size_t>();
+  for (size_t threads = 1; threads < cores; threads *= 2) {
+    candidates.push_back(threads);
+  }
+  candidates.push_back(cores);
+  return candidates;
+}
+
+auto Autotune(const Options &option, const RayTracerFactory &factory, double burst_seconds) -> TunedParameters {
+  uint64_t key = 0;
+  auto parameters = TunedParameters{static_cast<size_t>(ResolveThreads(option.threads_)),
+                                    option.batch_size_,
+                                    option.tile_size_,
+                                    option.deferred_,
+                                    0,
+                                    false};
+  if (!option.autotune_cache_.empty()) {
+    key = CacheKey(option, SceneFingerprint(option, factory));
+    if (ReadCache(option.autotune_cache_, key, parameters)) {
+      return parameters;
+    }
+  }
+
+  // Size the bursts from a first short run with the requested parameters.
+  const auto calibration = std::min<size_t>(option.num_rays_, 2000);
+  const auto rate = Measure(option, parameters, calibration, factory);
+  const auto rays = std::clamp(static_cast<size_t>(rate * burst_seconds), calibration, option.num_rays_);
+  parameters.rays_per_second_ = Measure(option, parameters, rays, factory);
+
+  auto tune = [&](auto member, const auto &candidates) {
+    for (auto candidate : candidates) {
+      auto trial = parameters;
+      trial.*member = candidate;
+      const auto trial_rate = Measure(option, trial, rays, factory);
+      if (trial_rate > parameters.rays_per_second_) {
+        parameters = trial;
+        parameters.rays_per_second_ = trial_rate;
+      }
+    }
+  };
+  tune(&TunedParameters::threads_, ThreadCandidates());
+  tune(&TunedParameters::batch_size_, std::vector<size_t>{1024, 4096, 16384, 65536});
+  // Only images accepting concurrent adds can skip the deferred splatter.
+  if (option.accumulator_ != AccumulatorFormat::kDouble && option.preview_path_.empty()) {
+    tune(&TunedParameters::deferred_, std::vector<bool>{false, true});
+  }
+  const auto splats_by_tile = parameters.deferred_ || !option.preview_path_.empty() ||
+                              (parameters.threads_ > 1 && option.accumulator_ == AccumulatorFormat::kDouble);
+  if (splats_by_tile) {
+    tune(&TunedParameters::tile_size_, std::vector<size_t>{16, 32, 64, 128});
+  }
+
+  if (!option.autotune_cache_.empty()) {
+    WriteCache(option.autotune_cache_, key, parameters);
+  }
+  return parameters;
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+
+namespace RayTracer2D {
+
+// Builds the tracer of the render being tuned, for the given options.
+using RayTracerFactory = std::function<std::unique_ptr<RayTracer>(const Options &)>;
+
+// Render parameters picked by `Autotune`.
+struct TunedParameters {
+  size_t threads_;
+  size_t batch_size_;
+  size_t tile_size_;
+  bool deferred_;
+  // Throughput of the chosen configuration during calibration.
+  double rays_per_second_;
+  // Whether the parameters come from `autotune_cache_` instead of a calibration.
+  bool cached_;
+
+  void ApplyTo(Options &option) const;
+};
+
+// Pick the thread count, ray batch size, splatting tile size and, for images
+// accepting concurrent adds, deferred or shared splatting that render the
+// scene fastest on this machine.
+//
+// Every candidate renders a short burst of about `burst_seconds` into a
+// scratch tracer from `factory`, and the parameters are tuned one after the
+// other, keeping the best value of each. With `autotune_cache_` set, results
+// are stored in that file under a key made of the scene fingerprint, the
+// image settings and the CPU model, and reused on later runs.
+auto Autotune(const Options &option, const RayTracerFactory &factory, double burst_seconds = 0.2) -> TunedParameters;
+
+// Hash of the first `paths` light paths of the tracer's scene and light,
+// traced with a fixed sampler: changes whenever the geometry, the materials
+// or the light do.
+auto SceneFingerprint(const Options &option, const RayTracerFactory &factory, size_t paths = 64) -> uint64_t;
+
+// Model name of the CPU, from /proc/cpuinfo where available.
+auto CpuModel() -> std::string;
+
+}  // namespace RayTracer2D
@@ -0,0 +1,438 @@
+#include "core/beam_tracer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "core/rect.h"
+#include "core/stage_profiler.h"
+#include "core/tile_splatter.h"
+#include "light/laser_light.h"
+#include "light/point_light.h"
+#include "material/reflective.h"
+#include "shapes/circle.h"
+#include "shapes/wall.h"
+#include "utils/constants.h"
+#include "utils/fast_math.h"
+#include "utils/parallel.h"
+
+namespace RayTracer2D {
+
+static constexpr double kTwoPi = 2 * M_PI;
+
+// Angle of `d` in [0, 2 pi).
+static double Angle(const Point2d &d) {
+  auto a = std::atan2(d.y, d.x);
+  return a < 0 ? a + kTwoPi : a;
+}
+
+static Point2d Direction(const double a) {
+  return Point2d(std::cos(a), std::sin(a));
+}
+
+// `a` shifted by whole turns into [from, from + 2 pi).
+static double Unwrap(const double a, const double from) {
+  return a - std::floor((a - from) / kTwoPi) * kTwoPi;
+}
+
+// Flat mirrors reflect a whole wedge alike.
+static const Wall *AsMirror(const Shape *shape) {
+  auto *wall = dynamic_cast<const Wall *>(shape);
+  return wall != nullptr && dynamic_cast<const ReflectiveMaterial *>(shape->material()) != nullptr ? wall : nullptr;
+}
+
+// Distance along the unit direction `d` from `p` to the line through `wall`.
+static double DistanceToLine(const Point2d &p, const Point2d &d, const Wall &wall) {
+  const auto w = wall.end() - wall.begin();
+  const auto cross = Cross(d, w);
+  return cross == 0 ? std::numeric_limits<double>::infinity() : Cross(wall.begin() - p, w) / cross;
+}
+
+// Where a ray reflected at `p` of `wall` into `d` starts, moved off the wall
+// like RayTracer::ContinuePath does.
+static Point2d SpawnPoint(const Wall &wall, const Point2d &p, const Point2d &d) {
+  const auto w = (wall.end() - wall.begin()).Normalized();
+  const auto n = Point2d(-w.y, w.x);
+  const auto scale = std::max({1.0, std::abs(p.x), std::abs(p.y)});
+  return p + n * (Dot(d, n) >= 0 ? kSpawnOffset * scale : -kSpawnOffset * scale);
+}
+
+BeamTracer::BeamTracer(RayTracer &rt)
+    : rt_(rt),
+      light_(rt.EmitRay(0).p_),
+      colour_(rt.EmitRay(0).colour_),
+      laser_(dynamic_cast<LaserLight *>(rt.light_.get()) != nullptr) {}
+
+bool BeamTracer::Supports(const RayTracer &rt) {
+  const auto *light = rt.light_.get();
+  if (dynamic_cast<const PointLight *>(light) == nullptr && dynamic_cast<const LaserLight *>(light) == nullptr) {
+    return false;
+  }
+  // Wedges are only clipped against the edges of walls and circles.
+  const auto &scene = *rt.scene_;
+  for (uint32_t i = 0; i < scene.size(); i++) {
+    const auto *shape = scene.shape(i);
+    if (dynamic_cast<const Circle *>(shape) == nullptr && dynamic_cast<const Wall *>(shape) == nullptr) {
+      return false;
+    }
+  }
+  return !scene.HasMedia() && rt.option_.trace_path_.empty() && !rt.image_.IsConcurrent();
+}
+
+void BeamTracer::Render(const size_t threads) {
+  threads_ = ResolveThreads(threads);
+  if (laser_) {
+    TraceLaser();
+  } else {
+    std::vector<Wedge> pending{Wedge{light_, 0, kTwoPi, nullptr, 1, 0, 1}};
+    while (!pending.empty()) {
+      auto wedge = pending.back();
+      pending.pop_back();
+      TraceWedge(wedge, pending);
+    }
+  }
+  TraceHandOvers();
+}
+
+double BeamTracer::DistanceToStart(const Wedge &wedge, const Point2d &d) {
+  return wedge.start_ == nullptr ? 0 : DistanceToLine(wedge.apex_, d, *wedge.start_);
+}
+
+// The first hit only changes at the directions of wall endpoints and circle
+// tangents (or the corners of the bounds of other shapes). Between two of
+// them, one ray tells which surface the whole part ends on.
+void BeamTracer::TraceWedge(const Wedge &wedge, std::vector<Wedge> &pending) {
+  StageScope scope(Stage::kIntersection);
+  const auto &scene = *rt_.scene_;
+  std::vector<double> cuts{wedge.a0_, wedge.a1_};
+  auto cut_at = [&](double a) {
+    a = Unwrap(a, wedge.a0_);
+    if (a > wedge.a0_ && a < wedge.a1_) {
+      cuts.push_back(a);
+    }
+  };
+  auto cut_towards = [&](const Point2d &p) {
+    const auto d = p - wedge.apex_;
+    if (d.x != 0 || d.y != 0) {
+      cut_at(Angle(d));
+    }
+  };
+  for (const auto *shape : scene) {
+    if (const auto *wall = dynamic_cast<const Wall *>(shape)) {
+      cut_towards(wall->begin());
+      cut_towards(wall->end());
+    } else if (const auto *circle = dynamic_cast<const Circle *>(shape)) {
+      const auto d = circle->center() - wedge.apex_;
+      const auto distance = d.Length();
+      if (distance > circle->radius()) {
+        const auto half = std::asin(circle->radius() / distance);
+        cut_at(Angle(d) - half);
+        cut_at(Angle(d) + half);
+      }
+    } else if (auto bounds = shape->Bounds()) {
+      cut_towards(Point2d(bounds->left_, bounds->top_));
+      cut_towards(Point2d(bounds->right_, bounds->top_));
+      cut_towards(Point2d(bounds->left_, bounds->bottom_));
+      cut_towards(Point2d(bounds->right_, bounds->bottom_));
+    }
+  }
+  std::sort(cuts.begin(), cuts.end());
+
+  struct Part {
+    double a0_, a1_;
+    const Shape *end_;
+  };
+  std::vector<Part> parts;
+  for (size_t i = 0; i + 1 < cuts.size(); i++) {
+    if (!(cuts[i + 1] > cuts[i])) {
+      continue;
+    }
+    const auto d = Direction((cuts[i] + cuts[i + 1]) / 2);
+    auto ray = Ray(wedge.apex_ + d * DistanceToStart(wedge, d), d, colour_);
+    ray.origin_ = wedge.start_;
+    auto hit = scene.FindFirstHit(ray);
+    if (!hit.has_value()) {
+      continue;
+    }
+    if (!parts.empty() && parts.back().end_ == hit->second && parts.back().a1_ == cuts[i]) {
+      parts.back().a1_ = cuts[i + 1];
+    } else {
+      parts.push_back(Part{cuts[i], cuts[i + 1], hit->second});
+    }
+  }
+
+  for (const auto &part : parts) {
+    wedges_++;
+    Rasterize(wedge, part.a0_, part.a1_, part.end_);
+    if (wedge.segment_ == rt_.option_.depth_) {
+      continue;
+    }
+    const auto *mirror = AsMirror(part.end_);
+    if (mirror == nullptr) {
+      HandOver(wedge, part.a0_, part.a1_);
+      continue;
+    }
+    // Directions reflect to 2 alpha - a about a line of direction alpha, and
+    // the apex to its mirror image.
+    const auto b = mirror->begin();
+    const auto w = mirror->end() - b;
+    const auto alpha = std::atan2(w.y, w.x);
+    const auto foot = b + w * (Dot(wedge.apex_ - b, w) / Dot(w, w));
+    pending.push_back(Wedge{foot * 2.0 - wedge.apex_, 2 * alpha - part.a1_, 2 * alpha - part.a0_, mirror,
+                            -wedge.sign_, wedge.offset_ + 2 * wedge.sign_ * alpha, wedge.segment_ + 1});
+  }
+}
+
+void BeamTracer::Rasterize(const Wedge &wedge, const double a0, const double a1, const Shape *end) {
+  StageScope scope(Stage::kSplatting);
+  const auto &image = rt_.image_;
+  const auto scale = image.scale();
+  const auto u0 = Direction(a0);
+  const auto u1 = Direction(a1);
+  const auto narrow = a1 - a0 < M_PI;
+  const auto *end_wall = dynamic_cast<const Wall *>(end);
+  auto end_distance = [&](const Point2d &d, const double t0) {
+    if (end_wall != nullptr) {
+      return DistanceToLine(wedge.apex_, d, *end_wall);
+    }
+    auto ray = Ray(wedge.apex_ + d * t0, d, colour_);
+    ray.origin_ = wedge.start_;
+    auto t = end->Intersect(ray);
+    return t.has_value() ? t0 + t.value() : t0;
+  };
+
+  // The region is bounded by the start line, the two edge directions and the
+  // end surface.
+  auto box = image.view();
+  if (narrow) {
+    box = Rect{std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(),
+               -std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+    auto extend = [&](const Point2d &p) {
+      box = Rect{std::min(box.left_, p.x), std::min(box.top_, p.y), std::max(box.right_, p.x),
+                 std::max(box.bottom_, p.y)};
+    };
+    for (const auto &d : {u0, u1}) {
+      const auto t0 = DistanceToStart(wedge, d);
+      extend(wedge.apex_ + d * t0);
+      extend(wedge.apex_ + d * end_distance(d, t0));
+    }
+    if (end_wall == nullptr) {
+      auto bounds = end->Bounds();
+      if (bounds.has_value()) {
+        extend(Point2d(bounds->left_, bounds->top_));
+        extend(Point2d(bounds->right_, bounds->bottom_));
+      } else {
+        box = image.view();
+      }
+    }
+  }
+  const auto lo = image.ToPixel(Point2d(box.left_, box.top_));
+  const auto hi = image.ToPixel(Point2d(box.right_, box.bottom_));
+  const auto x0 = static_cast<int64_t>(std::max(0.0, std::floor(lo.x + 0.5)));
+  const auto y0 = static_cast<int64_t>(std::max(0.0, std::floor(lo.y + 0.5)));
+  const auto x1 = static_cast<int64_t>(std::min(image.sx_ - 1.0, std::floor(hi.x + 0.5)));
+  const auto y1 = static_cast<int64_t>(std::min(image.sy_ - 1.0, std::floor(hi.y + 0.5)));
+
+  // Rays per radian, per unit area of a quadrature point of a unit pixel.
+  const auto weight = rt_.option_.num_rays_ / kTwoPi / (scale.x * scale.y);
+  const auto apex = image.ToPixel(wedge.apex_);
+  // Rows are distinct pixels, which a non-concurrent image still takes from
+  // several threads at once.
+#pragma omp parallel num_threads(threads_)
+  {
+    StageScope thread_scope(Stage::kSplatting);
+#pragma omp for schedule(dynamic)
+    for (auto y = y0; y <= y1; y++) {
+      for (auto x = x0; x <= x1; x++) {
+        // The integrand grows as 1 / r close to the apex.
+        const int q = std::abs(x - apex.x) < 3 && std::abs(y - apex.y) < 3 ? 16 : 4;
+        double sum = 0;
+        for (int j = 0; j < q; j++) {
+          for (int i = 0; i < q; i++) {
+            const auto p = image.ToWorld(Point2d(x - 0.5 + (i + 0.5) / q, y - 0.5 + (j + 0.5) / q));
+            const auto v = p - wedge.apex_;
+            const auto r2 = Dot(v, v);
+            if (r2 == 0) {
+              continue;
+            }
+            if (narrow ? Cross(u0, v) < 0 || Cross(v, u1) < 0 : Unwrap(Angle(v), a0) > a1) {
+              continue;
+            }
+            const auto r = std::sqrt(r2);
+            const auto d = v / r;
+            const auto t0 = DistanceToStart(wedge, d);
+            if (r <= t0 || r >= end_distance(d, t0)) {
+              continue;
+            }
+            sum += std::max(std::abs(v.x) * scale.x, std::abs(v.y) * scale.y) / r2;
+          }
+        }
+        if (sum > 0) {
+          image.Accumulate(x, y, colour_ * (weight * sum / (q * q)));
+        }
+      }
+    }
+  }
+
+  // Ray::Render steps from the lower end u1 of the major axis by whole
+  // pixels: the pixels of the two ends get what those steps give instead of
+  // the covered length integrated above. Segments between walls on the image
+  // border keep their ends on fixed pixel positions, so this is evaluated
+  // along the end curves rather than averaged.
+  const auto extent = (hi.x - lo.x) + (hi.y - lo.y);
+  const auto directions = static_cast<int64_t>(std::clamp(8 * extent, 16.0, 1e6));
+  const auto step = (a1 - a0) / directions;
+  const auto per_direction = colour_ * (rt_.option_.num_rays_ / kTwoPi * step);
+  auto deposit = [&](const bool x_major, const int32_t u, const int32_t v, const double amount) {
+    const auto x = x_major ? u : v, y = x_major ? v : u;
+    if (amount != 0 && x >= 0 && y >= 0 && x < static_cast<int32_t>(image.sx_) && y < static_cast<int32_t>(image.sy_)) {
+      image.Accumulate(x, y, per_direction * amount);
+    }
+  };
+  for (int64_t i = 0; i < directions; i++) {
+    const auto d = Direction(a0 + (i + 0.5) * step);
+    const auto t0 = DistanceToStart(wedge, d);
+    const auto from = wedge.apex_ + d * t0;
+    const auto a = image.ToPixel(wedge.start_ == nullptr ? from : SpawnPoint(*wedge.start_, from, d));
+    const auto b = image.ToPixel(wedge.apex_ + d * end_distance(d, t0));
+    const auto x_major = std::abs(b.x - a.x) >= std::abs(b.y - a.y);
+    auto u1 = x_major ? a.x : a.y, v1 = x_major ? a.y : a.x;
+    auto u2 = x_major ? b.x : b.y, v2 = x_major ? b.y : b.x;
+    if (u2 < u1) {
+      std::swap(u1, u2);
+      std::swap(v1, v2);
+    }
+    if (!(u2 > u1)) {
+      continue;
+    }
+    const auto inc = (v2 - v1) / (u2 - u1);
+    const auto n1 = FastRound(u1);
+    const auto n2 = FastRound(u2);
+    if (n1 == n2) {
+      // A single step against the covered length.
+      deposit(x_major, n1, FastRound(v1), 1 - (u2 - u1));
+      continue;
+    }
+    deposit(x_major, n1, FastRound(v1), u1 - n1 + 0.5);
+    const auto k = std::floor(u2 - u1);
+    const auto last = u2 - n2 + 0.5;
+    if (FastRound(u1 + k) == n2) {
+      deposit(x_major, n2, FastRound(v1 + k * inc), 1 - last);
+    } else {
+      deposit(x_major, n2, FastRound(v2), -last);
+    }
+  }
+}
+
+void BeamTracer::HandOver(const Wedge &wedge, const double a0, const double a1) {
+  SortEmissions();
+  const auto e0 = wedge.sign_ * a0 + wedge.offset_;
+  const auto e1 = wedge.sign_ * a1 + wedge.offset_;
+  const auto from = Unwrap(std::min(e0, e1), 0);
+  const auto to = from + std::abs(e1 - e0);
+  auto take = [&](const double begin, const double end) {
+    const auto first = std::lower_bound(emissions_.begin(), emissions_.end(), std::make_pair(begin, size_t{0}));
+    const auto last = std::lower_bound(first, emissions_.end(), std::make_pair(end, size_t{0}));
+    if (last != first) {
+      hand_overs_.push_back(HandOverRange{static_cast<size_t>(first - emissions_.begin()),
+                                          static_cast<size_t>(last - emissions_.begin()), wedge.segment_});
+    }
+  };
+  take(from, to);
+  if (to > kTwoPi) {
+    take(0, to - kTwoPi);
+  }
+}
+
+void BeamTracer::SortEmissions() {
+  if (!emissions_.empty()) {
+    return;
+  }
+  emissions_.resize(rt_.option_.num_rays_);
+#pragma omp parallel for num_threads(threads_) schedule(static)
+  for (size_t i = 0; i < emissions_.size(); i++) {
+    emissions_[i] = std::make_pair(Angle(rt_.EmitRay(i).d_), i);
+  }
+  std::sort(emissions_.begin(), emissions_.end());
+}
+
+// Handed over rays only write segments, so they are traced like the deferred
+// render: into per-thread buffers the splatter then hands out by screen tile.
+void BeamTracer::TraceHandOvers() {
+  std::vector<size_t> starts{0};
+  for (const auto &range : hand_overs_) {
+    starts.push_back(starts.back() + range.end_ - range.begin_);
+  }
+  rays_ = starts.back();
+  if (rays_ == 0) {
+    return;
+  }
+  auto splatter = TileSplatter(rt_.image_, rt_.option_.tile_size_, threads_);
+  auto buffers = std::vector<SegmentBuffer>(threads_);
+  for (size_t begin = 0; begin < rays_; begin += rt_.option_.batch_size_) {
+    const auto end = std::min(begin + rt_.option_.batch_size_, rays_);
+#pragma omp parallel for num_threads(threads_) schedule(dynamic, 64)
+    for (size_t k = begin; k < end; k++) {
+      const auto r = std::upper_bound(starts.begin(), starts.end(), k) - starts.begin() - 1;
+      const auto &range = hand_overs_[r];
+      const auto position = range.begin_ + (k - starts[r]);
+      HandOverRay(laser_ ? position : emissions_[position].second, range.segments_, &buffers[ThreadIndex()]);
+    }
+    splatter.Splat(buffers);
+    rt_.image_.Trim();
+  }
+}
+
+// The first segments, already rasterized, are traced again without drawing
+// them: the ray then carries the random numbers of its own path on.
+void BeamTracer::HandOverRay(const size_t index, const size_t segments, SegmentBuffer *buffer) {
+  auto ray = rt_.EmitRay(index);
+  StageScope scope(Stage::kIntersection);
+  for (size_t i = 0; i < segments; i++) {
+    scope.Switch(Stage::kIntersection);
+    auto hit = rt_.scene_->FindFirstHit(ray);
+    if (!hit.has_value()) {
+      return;
+    }
+    auto [t, shape] = hit.value();
+    scope.Switch(Stage::kShading);
+    const auto p = ray(t);
+    const auto n = shape->GetNormal(ray, p);
+    auto next = shape->Interact(ray, p, n);
+    RayTracer::ContinuePath(ray, next, shape, n);
+    ray = next;
+  }
+  rt_.PropagateRay(ray, rt_.option_.depth_ - segments, buffer);
+}
+
+void BeamTracer::TraceLaser() {
+  const auto depth = rt_.option_.depth_;
+  auto ray = rt_.EmitRay(0);
+  StageScope scope(Stage::kIntersection);
+  for (size_t segment = 1; segment <= depth; segment++) {
+    if (segment == depth && rt_.CullLastBounce(ray)) {
+      return;
+    }
+    auto hit = rt_.scene_->FindFirstHit(ray);
+    if (!hit.has_value()) {
+      return;
+    }
+    auto [t, shape] = hit.value();
+    const auto p = ray(t);
+    auto beam = ray;
+    beam.colour_ = ray.colour_ * static_cast<double>(rt_.option_.num_rays_);
+    rt_.EmitSegment(beam, p, nullptr);
+    wedges_++;
+    if (segment == depth) {
+      return;
+    }
+    if (AsMirror(shape) == nullptr) {
+      hand_overs_.push_back(HandOverRange{0, rt_.option_.num_rays_, segment});
+      return;
+    }
+    const auto n = shape->GetNormal(ray, p);
+    auto next = shape->Interact(ray, p, n);
+    RayTracer::ContinuePath(ray, next, shape, n);
+    ray = next;
+  }
+}
+
+}  // namespace RayTracer2D
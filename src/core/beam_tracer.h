@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "core/colour.h"
+#include "core/point.h"
+#include "core/ray_tracer.h"
+#include "core/segment.h"
+#include "core/shape.h"
+#include "shapes/wall.h"
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// Renders the specular part of a scene analytically. Light leaves the source
+// as a wedge of directions, which is split wherever the first surface it hits
+// changes. The region of each part up to that surface is rasterized with the
+// expected value of the rays it stands for, and parts ending on a mirror wall
+// reflect off it as a whole. Parts ending on any other surface hand over to
+// the rays of the render they contain, traced on from that surface, so the
+// image converges to the one of `RayTracer::Render` minus the noise of the
+// mirror paths.
+//
+// The rays of a point light are uniform in angle and deposit one step per
+// pixel along their major axis, that is max(|d.x| sx, |d.y| sy) / r per unit
+// area at distance r from the wedge apex, with (sx, sy) the pixels per world
+// unit. Wedge regions integrate this with a few quadrature points per pixel.
+// The steps of a ray start at the end with the lower major coordinate, so the
+// pixels of both ends get what those steps give rather than the covered
+// length; wedges correct this along their start and end curves. A laser is a
+// wedge of zero width, rasterized as one ray carrying them all.
+class BeamTracer {
+ public:
+  explicit BeamTracer(RayTracer &rt);
+
+  DISALLOW_COPY_AND_MOVE(BeamTracer);
+
+  // Whether the light, scene and options of `rt` allow beams: a point light or
+  // a laser, a scene made of circles and walls only, no media, no path
+  // recording and the double accumulator, as end corrections may be negative.
+  // `RayTracer::Render` traces rays otherwise.
+  static bool Supports(const RayTracer &rt);
+
+  // Trace the whole render on `threads` threads. Wedges are split on the
+  // calling thread, their pixel rows are rasterized in parallel, and the rays
+  // handed over are traced in batches at the end, like `RayTracer::Render`
+  // does for an image without concurrent adds.
+  void Render(const size_t threads);
+
+  // Wedge parts rasterized and rays handed over by `Render`.
+  size_t wedges() const {
+    return wedges_;
+  }
+  size_t rays() const {
+    return rays_;
+  }
+
+ private:
+  // Directions [a0_, a1_] from `apex_`, with a0_ <= a1_ <= a0_ + 2 pi,
+  // starting on the mirror `start_` or at the light when null. Emission
+  // angles at the light are `sign_` * a + `offset_`.
+  struct Wedge {
+    Point2d apex_;
+    double a0_, a1_;
+    const Wall *start_;
+    double sign_, offset_;
+    // Index of the path segment the wedge draws, from 1.
+    size_t segment_;
+  };
+
+  void TraceWedge(const Wedge &wedge, std::vector<Wedge> &pending);
+  void TraceLaser();
+  // Accumulate the part [a0, a1] of `wedge` up to its first hit `end`.
+  void Rasterize(const Wedge &wedge, const double a0, const double a1, const Shape *end);
+  // Queue the rays emitted in the part [a0, a1] of `wedge` to be traced on.
+  void HandOver(const Wedge &wedge, const double a0, const double a1);
+  // Trace every queued ray, `batch_size_` at a time.
+  void TraceHandOvers();
+  // Continue ray `index` of the render after its first `segments` segments.
+  void HandOverRay(const size_t index, const size_t segments, SegmentBuffer *buffer);
+  // Sort the emission angles of the render the first time they are needed.
+  void SortEmissions();
+
+  static double DistanceToStart(const Wedge &wedge, const Point2d &d);
+
+  // Rays [begin_, end_) of `emissions_`, or of the render for a laser, that
+  // continue after their first `segments_` segments.
+  struct HandOverRange {
+    size_t begin_, end_;
+    size_t segments_;
+  };
+
+  RayTracer &rt_;
+  Point2d light_;
+  Colour colour_;
+  bool laser_;
+  size_t threads_{1};
+  // Emission angles in [0, 2 pi) of the rays of the render, sorted, and the
+  // ray indices. Left empty when no wedge hands over, as in scenes of mirror
+  // walls only.
+  std::vector<std::pair<double, size_t>> emissions_;
+  std::vector<HandOverRange> hand_overs_;
+  size_t wedges_{0};
+  size_t rays_{0};
+};
+
+}  // namespace RayTracer2D
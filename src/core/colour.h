@@ -25,6 +25,10 @@ struct Colour {
     B_ *= r;
   }
 
+  // Rec. 709 luminance of the linear colour.
+  double Luminance() const {
+    return 0.2126 * R_ + 0.7152 * G_ + 0.0722 * B_;
+  }
 
   bool ValidateColour() const;
 
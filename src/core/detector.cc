@@ -0,0 +1,70 @@
+#include "core/detector.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+namespace RayTracer2D {
+
+DetectorSet::DetectorSet(const Scene &scene, std::vector<DetectorSpec> specs, const size_t threads)
+    : specs_(std::move(specs)), index_(scene.size(), -1) {
+  size_t size = 0;
+  for (size_t i = 0; i < specs_.size(); i++) {
+    index_[specs_[i].shape_] = static_cast<int32_t>(i);
+    offsets_.push_back(size);
+    size += 3 * specs_[i].position_bins_ * specs_[i].angle_bins_;
+  }
+  histograms_.resize(std::max<size_t>(threads, 1), Histogram{std::vector<double>(size),
+                                                             std::vector<uint64_t>(specs_.size())});
+}
+
+void DetectorSet::Reserve(const size_t threads) {
+  const auto count = std::max<size_t>(threads, static_cast<size_t>(ResolveThreads(0)));
+  if (count > histograms_.size()) {
+    histograms_.resize(count, Histogram{std::vector<double>(histograms_.front().bins_.size()),
+                                        std::vector<uint64_t>(specs_.size())});
+  }
+}
+
+auto DetectorSet::Bins(const size_t detector) const -> std::vector<double> {
+  const auto &spec = specs_[detector];
+  auto bins = std::vector<double>(3 * spec.position_bins_ * spec.angle_bins_);
+  for (const auto &histogram : histograms_) {
+    for (size_t i = 0; i < bins.size(); i++) {
+      bins[i] += histogram.bins_[offsets_[detector] + i];
+    }
+  }
+  return bins;
+}
+
+uint64_t DetectorSet::Hits(const size_t detector) const {
+  uint64_t hits = 0;
+  for (const auto &histogram : histograms_) {
+    hits += histogram.hits_[detector];
+  }
+  return hits;
+}
+
+bool DetectorSet::Write(const std::string &path) const {
+  std::ofstream file(path, std::ios::binary);
+  auto header = DetectorFileHeader{};
+  std::copy(std::begin(kDetectorMagic), std::end(kDetectorMagic), header.magic_);
+  header.version_ = kDetectorVersion;
+  header.count_ = static_cast<uint32_t>(specs_.size());
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  for (size_t i = 0; i < specs_.size(); i++) {
+    const auto &spec = specs_[i];
+    const auto record = DetectorRecord{spec.shape_, spec.position_bins_, spec.angle_bins_, 0, Hits(i)};
+    const auto bins = Bins(i);
+    file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    file.write(reinterpret_cast<const char *>(bins.data()), bins.size() * sizeof(double));
+  }
+  if (!file) {
+    fprintf(stderr, "can not write detectors to %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace RayTracer2D
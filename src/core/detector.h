@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "core/colour.h"
+#include "core/point.h"
+#include "core/ray.h"
+#include "core/scene.h"
+#include "core/shape.h"
+#include "utils/macros.h"
+#include "utils/parallel.h"
+
+namespace RayTracer2D {
+
+// A shape measuring the light that hits it, in `position_bins_` bins along
+// its surface (see `Shape::SurfaceCoordinate`) times `angle_bins_` bins of
+// incidence angle.
+struct DetectorSpec {
+  uint32_t shape_;
+  uint32_t position_bins_;
+  uint32_t angle_bins_;
+};
+
+// Header of a detector file, followed by `count_` detectors. Each one is a
+// `DetectorRecord` followed by position_bins_ x angle_bins_ RGB bins of three
+// doubles, angle bins varying fastest.
+struct DetectorFileHeader {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t count_;
+};
+static_assert(sizeof(DetectorFileHeader) == 16, "DetectorFileHeader is a file format");
+
+struct DetectorRecord {
+  uint32_t shape_;
+  uint32_t position_bins_;
+  uint32_t angle_bins_;
+  uint32_t reserved_;
+  uint64_t hits_;
+};
+static_assert(sizeof(DetectorRecord) == 24, "DetectorRecord is a file format");
+
+constexpr char kDetectorMagic[8] = {'R', 'T', '2', 'D', 'D', 'E', 'T', 'S'};
+constexpr uint32_t kDetectorVersion = 1;
+
+// Histograms of the light arriving at the detector shapes of a scene, filled
+// by `RayTracer` at every hit (see `RayTracer::SetDetectors`) without
+// changing what the shapes do to the light. The incidence angle is measured
+// from the normal on the side the light comes from, counterclockwise
+// positive, in (-pi/2, pi/2) and the bins split that range evenly.
+//
+// Every thread adds to histograms of its own, summed when read.
+class DetectorSet {
+ public:
+  // Histograms are made for `threads` threads, `Reserve` adds more.
+  explicit DetectorSet(const Scene &scene, std::vector<DetectorSpec> specs, const size_t threads);
+
+  DISALLOW_COPY_AND_MOVE(DetectorSet);
+
+  // Record the hit of `ray` on `shape` at `p`, `n` being the normal facing
+  // the ray.
+  void Record(const Ray &ray, const Shape *shape, const Point2d &p, const Point2d &n) {
+    const auto id = shape->id();
+    if (id >= index_.size() || index_[id] < 0) {
+      return;
+    }
+    const auto &spec = specs_[index_[id]];
+    const auto w = -1.0 * ray.d_;
+    const auto angle = std::atan2(Cross(n, w), Dot(n, w));
+    const auto position = Bin(shape->SurfaceCoordinate(p), spec.position_bins_);
+    const auto a = Bin(angle / M_PI + 0.5, spec.angle_bins_);
+    assert(static_cast<size_t>(ThreadIndex()) < histograms_.size());
+    auto &histogram = histograms_[ThreadIndex()];
+    auto *bin = &histogram.bins_[offsets_[index_[id]] + 3 * (position * spec.angle_bins_ + a)];
+    bin[0] += ray.colour_.R_;
+    bin[1] += ray.colour_.G_;
+    bin[2] += ray.colour_.B_;
+    histogram.hits_[index_[id]]++;
+  }
+
+  // Make room for the histograms of `threads` threads, and of as many as
+  // OpenMP may run. Called before every render, never during one.
+  void Reserve(const size_t threads);
+
+  const std::vector<DetectorSpec> &specs() const {
+    return specs_;
+  }
+
+  // RGB bins of detector `detector` summed over the threads, and its hits.
+  auto Bins(const size_t detector) const -> std::vector<double>;
+  uint64_t Hits(const size_t detector) const;
+
+  bool Write(const std::string &path) const;
+
+ private:
+  // Bin of `u` in [0, 1] out of `bins`.
+  static size_t Bin(const double u, const uint32_t bins) {
+    return std::min<size_t>(static_cast<size_t>(std::max(u, 0.0) * bins), bins - 1);
+  }
+
+  struct Histogram {
+    std::vector<double> bins_;
+    std::vector<uint64_t> hits_;
+  };
+
+  std::vector<DetectorSpec> specs_;
+  // Detector of each shape id, -1 for the other shapes.
+  std::vector<int32_t> index_;
+  // First value of each detector in `Histogram::bins_`.
+  std::vector<size_t> offsets_;
+  std::vector<Histogram> histograms_;
+};
+
+}  // namespace RayTracer2D
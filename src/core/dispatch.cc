@@ -0,0 +1,45 @@
+#include "core/dispatch.h"
+#include "light/laser_light.h"
+#include "light/point_light.h"
+#include "material/reflective.h"
+#include "material/refractive.h"
+#include "material/scattering.h"
+#include "shapes/circle.h"
+#include "shapes/wall.h"
+
+namespace RayTracer2D {
+
+auto MakeShapeRef(Shape *shape) -> ShapeRef {
+  if (auto circle = dynamic_cast<Circle *>(shape)) {
+    return circle;
+  }
+  if (auto wall = dynamic_cast<Wall *>(shape)) {
+    return wall;
+  }
+  return shape;
+}
+
+auto MakeMaterialRef(Material *material) -> MaterialRef {
+  if (auto reflective = dynamic_cast<ReflectiveMaterial *>(material)) {
+    return reflective;
+  }
+  if (auto refractive = dynamic_cast<RefractiveMaterial *>(material)) {
+    return refractive;
+  }
+  if (auto scattering = dynamic_cast<ScatteringMaterial *>(material)) {
+    return scattering;
+  }
+  return material;
+}
+
+auto MakeLightRef(Light *light) -> LightRef {
+  if (auto laser = dynamic_cast<LaserLight *>(light)) {
+    return laser;
+  }
+  if (auto point = dynamic_cast<PointLight *>(light)) {
+    return point;
+  }
+  return light;
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <variant>
+
+namespace RayTracer2D {
+
+class Shape;
+class Circle;
+class Wall;
+class Material;
+class ReflectiveMaterial;
+class RefractiveMaterial;
+class ScatteringMaterial;
+class Light;
+class LaserLight;
+class PointLight;
+
+// Built with RT2D_CLOSED_SET, the tracer dispatches over the closed set of
+// built-in shapes, materials and lights below instead of going through the
+// virtual interfaces. The last alternative of each variant is the open
+// extension point: user defined subclasses still work, just without the
+// devirtualized fast path.
+#ifdef RT2D_CLOSED_SET
+constexpr bool kClosedSetDispatch = true;
+#else
+constexpr bool kClosedSetDispatch = false;
+#endif
+
+using ShapeRef = std::variant<Circle *, Wall *, Shape *>;
+using MaterialRef = std::variant<ReflectiveMaterial *, RefractiveMaterial *, ScatteringMaterial *, Material *>;
+using LightRef = std::variant<LaserLight *, PointLight *, Light *>;
+
+// Classify an object into its closed-set alternative. These are called once
+// when the object is added to the scene, never on the hot path.
+auto MakeShapeRef(Shape *shape) -> ShapeRef;
+auto MakeMaterialRef(Material *material) -> MaterialRef;
+auto MakeLightRef(Light *light) -> LightRef;
+
+}  // namespace RayTracer2D
@@ -0,0 +1,35 @@
+#include "core/fixed_accumulator.h"
+
+namespace RayTracer2D {
+
+FixedPointAccumulator::FixedPointAccumulator(size_t sx, size_t sy, int bits, int fraction_bits)
+    : sx_(sx), sy_(sy), fraction_bits_(fraction_bits), scale_(std::ldexp(1.0, fraction_bits)) {
+  // Value-initialized atomics start at zero.
+  if (bits == 32) {
+    cells32_.reset(new std::atomic<uint32_t>[sx * sy * 3]());
+  } else {
+    cells64_.reset(new std::atomic<uint64_t>[sx * sy * 3]());
+  }
+}
+
+void FixedPointAccumulator::ReadRow(size_t y, double *row) const {
+  const auto inv_scale = 1.0 / scale_;
+  const auto begin = y * sx_ * 3;
+  for (size_t i = 0; i < sx_ * 3; i++) {
+    const auto v = cells32_ ? static_cast<double>(cells32_[begin + i].load(std::memory_order_relaxed))
+                            : static_cast<double>(cells64_[begin + i].load(std::memory_order_relaxed));
+    row[i] = v * inv_scale;
+  }
+}
+
+void FixedPointAccumulator::Clear() {
+  for (size_t i = 0; i < sx_ * sy_ * 3; i++) {
+    if (cells32_) {
+      cells32_[i].store(0, std::memory_order_relaxed);
+    } else {
+      cells64_[i].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include "core/colour.h"
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// Dense HDR accumulator storing every channel as an unsigned fixed-point
+// integer with `fraction_bits` bits after the binary point, in 32 or 64 bits.
+//
+// Contributions are rounded to the fixed-point grid once, when added, and
+// then summed with relaxed atomic integer adds: any number of threads can
+// splat into the same frame, and the result is exact and independent of the
+// order of the adds. Negative contributions count as zero, and cells saturate
+// at the largest value instead of wrapping around: the fraction bits should
+// still leave enough headroom for the brightest pixel.
+class FixedPointAccumulator {
+ public:
+  explicit FixedPointAccumulator(size_t sx, size_t sy, int bits, int fraction_bits);
+
+  DISALLOW_COPY_AND_MOVE(FixedPointAccumulator);
+
+  void Add(size_t x, size_t y, const Colour &colour) const {
+    const auto i = (x + y * sx_) * 3;
+    if (cells32_) {
+      AddSaturating(cells32_[i], ToFixed<uint32_t>(colour.R_));
+      AddSaturating(cells32_[i + 1], ToFixed<uint32_t>(colour.G_));
+      AddSaturating(cells32_[i + 2], ToFixed<uint32_t>(colour.B_));
+    } else {
+      AddSaturating(cells64_[i], ToFixed<uint64_t>(colour.R_));
+      AddSaturating(cells64_[i + 1], ToFixed<uint64_t>(colour.G_));
+      AddSaturating(cells64_[i + 2], ToFixed<uint64_t>(colour.B_));
+    }
+  }
+
+  // Convert the 3 * sx cells of row `y` to floating point.
+  void ReadRow(size_t y, double *row) const;
+
+  // Reset every cell to zero. Must not race with `Add`.
+  void Clear();
+
+  int fraction_bits() const {
+    return fraction_bits_;
+  }
+
+  size_t Bytes() const {
+    return sx_ * sy_ * 3 * (cells32_ ? sizeof(uint32_t) : sizeof(uint64_t));
+  }
+
+ private:
+  // Round `v` to the grid, clamped to [0, max] before the cast: converting a
+  // negative, NaN or out of range double to an integer is undefined.
+  template <typename T>
+  T ToFixed(const double v) const {
+    const auto scaled = v * scale_ + 0.5;
+    if (!(scaled > 0)) {
+      return 0;
+    }
+    // 2^bits, exact in a double.
+    if (scaled >= std::ldexp(1.0, std::numeric_limits<T>::digits)) {
+      return std::numeric_limits<T>::max();
+    }
+    return static_cast<T>(scaled);
+  }
+
+  // Add that sticks at the largest value once the sum overflows. The adder
+  // that wrapped the cell stores the maximum: adds racing with it are lost,
+  // but any add landing after it overflows again, so the cell ends up
+  // saturated whatever the order.
+  template <typename T>
+  static void AddSaturating(std::atomic<T> &cell, const T value) {
+    const auto old = cell.fetch_add(value, std::memory_order_relaxed);
+    if (old > std::numeric_limits<T>::max() - value) {
+      cell.store(std::numeric_limits<T>::max(), std::memory_order_relaxed);
+    }
+  }
+
+  size_t sx_, sy_;
+  int fraction_bits_;
+  double scale_;
+  // Exactly one of them is allocated.
+  std::unique_ptr<std::atomic<uint32_t>[]> cells32_;
+  std::unique_ptr<std::atomic<uint64_t>[]> cells64_;
+};
+
+}  // namespace RayTracer2D
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include "core/light.h"
+#include "core/ray.h"
+#include "core/ray_tracer.h"
+#include "core/scene.h"
+#include "core/segment.h"
+
+// Interface of the translation units SceneCodegen generates from a scene
+// description, one scene per executable, see `rt2d_add_scene_executable`.
+namespace RayTracer2D::generated {
+
+// Path of the scene description the unit was generated from.
+extern const char kSceneName[];
+
+// The scene and light of the description, built like `BuildScene` and
+// `BuildLight` do from it at runtime.
+auto BuildScene() -> std::unique_ptr<Scene>;
+auto BuildLight() -> std::unique_ptr<Light>;
+
+// `RayTracer::PathKernel` for a tracer rendering `BuildScene()`: the shape
+// loop is unrolled over constant geometry and materials are called directly.
+void PropagatePath(RayTracer &rt, Ray ray, const size_t depth, SegmentBuffer *segments);
+
+}  // namespace RayTracer2D::generated
@@ -1,17 +1,52 @@
 #include "core/image.h"
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <fstream>
 #include "core/colour.h"
+#include "core/qoi.h"
 
 namespace RayTracer2D {
 
-Image::Image(const Options &option) : sx_(option.sx_), sy_(option.sy_) {
-  data_ = new double[sx_ * sy_ * 3]();
+Image::Image(const Options &option)
+    : data_(nullptr),
+      sx_(option.sx_),
+      sy_(option.sy_),
+      world_(option.world_),
+      view_(option.roi_.value_or(option.world_)),
+      cropped_(option.roi_.has_value()),
+      scale_x_((sx_ - 1) / (view_.right_ - view_.left_)),
+      scale_y_((sy_ - 1) / (view_.bottom_ - view_.top_)) {
+  bounds_ = view_.Grown(0.5 / scale_x_, 0.5 / scale_y_);
+  if (option.detectors_only_) {
+    // Nothing is ever rasterized, see `RayTracer::EmitSegment`.
+  } else if (option.sparse_) {
+    sparse_ = std::make_unique<SparseAccumulator>(sx_, sy_, option.tile_size_, option.memory_budget_mb_ << 20,
+                                                  option.spill_dir_);
+  } else if (option.accumulator_ != AccumulatorFormat::kDouble) {
+    const auto bits = option.accumulator_ == AccumulatorFormat::kFixed32 ? 32 : 64;
+    const auto fraction_bits = option.fixed_fraction_bits_ > 0 ? option.fixed_fraction_bits_ : bits == 32 ? 12 : 32;
+    fixed_ = std::make_unique<FixedPointAccumulator>(sx_, sy_, bits, fraction_bits);
+  } else {
+    data_ = new double[sx_ * sy_ * 3]();
+  }
 }
 
-Image::Image(Image &&other) {
-  data_ = other.data_;
+Image::Image(Image &&other)
+    : data_(other.data_),
+      sparse_(std::move(other.sparse_)),
+      fixed_(std::move(other.fixed_)),
+      tone_mapped_(other.tone_mapped_),
+      background_(other.background_),
+      overlay_(std::move(other.overlay_)),
+      sx_(other.sx_),
+      sy_(other.sy_),
+      world_(other.world_),
+      view_(other.view_),
+      bounds_(other.bounds_),
+      cropped_(other.cropped_),
+      scale_x_(other.scale_x_),
+      scale_y_(other.scale_y_) {
   other.data_ = nullptr;
 }
 
@@ -20,61 +55,181 @@ Image::~Image() {
 }
 
 void Image::AdjustGamma() {
+  if (fixed_) {
+    tone_mapped_ = true;
+    return;
+  }
+  if (sparse_) {
+    sparse_->ForEachTile([](double *data, size_t count) {
+      for (size_t i = 0; i < count; i++) {
+        data[i] = ToneCurve(data[i]);
+      }
+    });
+    background_ = ToneCurve(background_);
+    sparse_->set_fill(background_);
+    return;
+  }
   for (auto i = 0; i < 3 * sx_ * sy_; i++) {
-    data_[i] = log(data_[i] + 1.5);
+    data_[i] = ToneCurve(data_[i]);
+  }
+}
+
+void Image::Clear() {
+  if (fixed_) {
+    fixed_->Clear();
+  } else if (sparse_) {
+    sparse_->ForEachTile([](double *data, size_t count) { std::fill(data, data + count, 0.0); });
+    sparse_->set_fill(0);
+  } else {
+    std::fill(data_, data_ + 3 * sx_ * sy_, 0.0);
+  }
+  tone_mapped_ = false;
+  background_ = 0;
+  overlay_.clear();
+}
+
+void Image::Swap(Image &other) {
+  std::swap(data_, other.data_);
+  std::swap(sparse_, other.sparse_);
+  std::swap(fixed_, other.fixed_);
+  std::swap(tone_mapped_, other.tone_mapped_);
+  std::swap(background_, other.background_);
+  std::swap(overlay_, other.overlay_);
+  std::swap(sx_, other.sx_);
+  std::swap(sy_, other.sy_);
+  std::swap(world_, other.world_);
+  std::swap(view_, other.view_);
+  std::swap(bounds_, other.bounds_);
+  std::swap(cropped_, other.cropped_);
+  std::swap(scale_x_, other.scale_x_);
+  std::swap(scale_y_, other.scale_y_);
+}
+
+void Image::ReadRow(size_t y, double *row) const {
+  if (fixed_) {
+    fixed_->ReadRow(y, row);
+    if (tone_mapped_) {
+      for (size_t i = 0; i < 3 * sx_; i++) {
+        row[i] = ToneCurve(row[i]);
+      }
+    }
+    return;
   }
+  if (!sparse_) {
+    std::copy(data_ + y * sx_ * 3, data_ + (y + 1) * sx_ * 3, row);
+    return;
+  }
+  const auto tile_size = sparse_->tile_size();
+  for (size_t x = 0; x < sx_; x += tile_size) {
+    const auto count = std::min(tile_size, sx_ - x) * 3;
+    if (auto *pixels = sparse_->Peek(x, y)) {
+      std::copy(pixels, pixels + count, row + x * 3);
+    } else {
+      std::fill(row + x * 3, row + x * 3 + count, background_);
+    }
+  }
+}
+
+void Image::Overlay(size_t x, size_t y, unsigned char R, unsigned char G, unsigned char B) {
+  overlay_.push_back({x + y * sx_, {R, G, B}});
 }
 
-void Image::WriteToPPM() {
+auto Image::PrepareQuantization() -> std::pair<double, double> {
   double image_max = -1;
   double image_min = 1e6;
-  for (auto i = 0; i < 3 * sx_ * sy_; i++) {
-    image_max = std::fmax(image_max, data_[i]);
-    image_min = std::fmin(image_min, data_[i]);
+  auto values = std::vector<double>(3 * sx_);
+  for (size_t y = 0; y < sy_; y++) {
+    ReadRow(y, values.data());
+    for (auto v : values) {
+      image_max = std::fmax(image_max, v);
+      image_min = std::fmin(image_min, v);
+    }
   }
   auto image_range = image_max - image_min;
   fprintf(stderr, "%f %f %f\n", image_max, image_min, image_range);
-  auto ppm_image = new unsigned char[3 * sx_ * sy_]();
-  for (auto i = 0; i < 3 * sx_ * sy_; i++) {
-    ppm_image[i] += static_cast<unsigned char>(255.0 * ((data_[i] - image_min) / image_range));
+
+  std::sort(overlay_.begin(), overlay_.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+  return {image_min, image_range};
+}
+
+void Image::QuantizeRow(size_t y, double image_min, double image_range, double *values, unsigned char *row) const {
+  ReadRow(y, values);
+  for (size_t i = 0; i < 3 * sx_; i++) {
+    row[i] = static_cast<unsigned char>(255.0 * ((values[i] - image_min) / image_range));
+  }
+  auto overlay = std::lower_bound(overlay_.cbegin(), overlay_.cend(), y * sx_,
+                                  [](const auto &entry, size_t index) { return entry.first < index; });
+  for (; overlay != overlay_.cend() && overlay->first < (y + 1) * sx_; ++overlay) {
+    std::copy(overlay->second.begin(), overlay->second.end(), row + 3 * (overlay->first - y * sx_));
   }
+}
 
-  for (const auto &map: maps_) {
-    for (auto i = 0; i < 3 * sx_ * sy_; i++) {
-      ppm_image[i] += map[i];
-    }
+bool Image::Write(const std::string &path, size_t threads) {
+  const std::string qoi = ".qoi";
+  if (path.size() >= qoi.size() && path.compare(path.size() - qoi.size(), qoi.size(), qoi) == 0) {
+    return WriteToQOI(path, threads);
   }
+  return WriteToPPM(path);
+}
 
-  std::ofstream ofs("output.ppm", std::ios::binary);
+// The output is produced row by row so that no full-frame 8-bit copy is ever
+// held in memory, which matters for sparse gigapixel renders.
+bool Image::WriteToPPM(const std::string &path) {
+  auto [image_min, image_range] = PrepareQuantization();
+
+  std::ofstream ofs(path, std::ios::binary);
   if (!ofs) {
     std::cerr << "can not create output image file" << std::endl;
-    return;
+    return false;
   }
   ofs << "P6\n";
   ofs << "# Output from Light2D.c\n";
   ofs << sx_ << " " << sy_ << "\n";
   ofs << "255\n";
-  ofs.write(reinterpret_cast<const char *>(ppm_image), sx_ * sy_ * 3 * sizeof(unsigned char));
+
+  auto values = std::vector<double>(3 * sx_);
+  auto row = std::vector<unsigned char>(3 * sx_);
+  for (size_t y = 0; y < sy_; y++) {
+    QuantizeRow(y, image_min, image_range, values.data(), row.data());
+    ofs.write(reinterpret_cast<const char *>(row.data()), row.size());
+  }
+  return static_cast<bool>(ofs);
+}
+
+// Strips are quantized and encoded in parallel, see `WriteQoi`.
+bool Image::WriteToQOI(const std::string &path, size_t threads) {
+  auto [image_min, image_range] = PrepareQuantization();
+
+  std::ofstream ofs(path, std::ios::binary);
+  if (!ofs) {
+    std::cerr << "can not create output image file" << std::endl;
+    return false;
+  }
+  auto read_row = [&, image_min = image_min, image_range = image_range](size_t y, unsigned char *rgb) {
+    thread_local std::vector<double> values;
+    values.resize(3 * sx_);
+    QuantizeRow(y, image_min, image_range, values.data(), rgb);
+  };
+  return WriteQoi(ofs, sx_, sy_, read_row, threads);
 }
 
 void Image::SetPixel(double x, double y, const Colour &colour) {
   assert(colour.ValidateColour());
-  x -= W_LEFT;
-  y -= W_TOP;
-  x = x / (W_RIGHT - W_LEFT);
-  y = y / (W_BOTTOM - W_TOP);
-  x = x * (sx_ - 1);
-  y = y * (sy_ - 1);
-
-  auto xx = static_cast<size_t>(round(x));
-  auto yy = static_cast<size_t>(round(y));
-  for (auto i = xx - 1; i <= xx + 1; i++) {
-    for (auto j = yy - 1; j <= yy + 1; j++) {
-      auto W = exp(-(((x - i) * (x - i)) + ((y - j) * (y - j))) * .5);
-      if (i >= 0 && j >= 0 && i < sx_ && j < sy_) {
-        data_[(i + (j * sx_)) * 3 + 0] += W * colour.R_;
-        data_[(i + (j * sx_)) * 3 + 1] += W * colour.G_;
-        data_[(i + (j * sx_)) * 3 + 2] += W * colour.B_;
+  auto pixel = ToPixel(Point2d(x, y));
+  x = pixel.x;
+  y = pixel.y;
+
+  auto xx = FastRound(x);
+  auto yy = FastRound(y);
+  double wx[3], wy[3];
+  GaussianSplatWeights(x - xx, wx);
+  GaussianSplatWeights(y - yy, wy);
+  for (auto i = 0; i < 3; i++) {
+    for (auto j = 0; j < 3; j++) {
+      auto px = xx - 1 + i;
+      auto py = yy - 1 + j;
+      if (px >= 0 && py >= 0 && px < sx_ && py < sy_) {
+        Accumulate(px, py, colour * (wx[i] * wy[j]));
       }
     }
   }
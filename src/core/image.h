@@ -1,31 +1,183 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <cstdlib>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 #include "core/colour.h"
+#include "core/fixed_accumulator.h"
 #include "core/options.h"
+#include "core/point.h"
+#include "core/rect.h"
+#include "core/sparse_accumulator.h"
+#include "utils/fast_math.h"
 #include "utils/macros.h"
 
 namespace RayTracer2D {
 
+// Read-only window into the linear HDR accumulator: `height_` rows of `width_`
+// RGB pixels, the first one being pixel (x_, y_) of the image. Consecutive rows
+// are `stride_` doubles apart.
+struct ImageView {
+  const double *Row(size_t y) const {
+    return data_ + y * stride_;
+  }
+
+  const double *data_;
+  size_t x_, y_;
+  size_t width_, height_;
+  size_t stride_;
+};
+
 class Image {
  public:
   Image(const Options &option);
   Image(Image &&image);
   ~Image();
 
-  // We disallow copy constructor to prevent double free of the 
+  // We disallow copy constructor to prevent double free of the
   // 'data_' pointer on instance distruction.
   DISALLOW_COPY(Image);
 
+  // Tone curve applied to the accumulated values before quantization.
+  static double ToneCurve(const double v) {
+    return FastLog(v + 1.5);
+  }
+
   void AdjustGamma();
-  void WriteToPPM();
+
+  // Start over from a black image without the overlay, keeping the
+  // accumulator memory (and the allocated tiles of a sparse one).
+  void Clear();
+  // Exchange the contents with `other`, an image made from the same options.
+  void Swap(Image &other);
+
+  // Write the image scaled to 8 bits with the overlay on top, as QOI if `path`
+  // ends in ".qoi" and as binary PPM otherwise. QOI strips are encoded on
+  // `threads` threads, 0 for every core.
+  bool Write(const std::string &path, size_t threads = 0);
+  bool WriteToPPM(const std::string &path = "output.ppm");
+  bool WriteToQOI(const std::string &path, size_t threads = 0);
   void SetPixel(double x, double y, const Colour &colour);
 
- public:
+  // Writable RGB accumulator cell of pixel (x, y), for floating point
+  // accumulators only.
+  double *Pixel(size_t x, size_t y) const {
+    if (sparse_) {
+      return sparse_->Pixel(x, y);
+    }
+    return data_ + (x + y * sx_) * 3;
+  }
+
+  void Accumulate(size_t x, size_t y, const Colour &colour) const {
+    if (fixed_) {
+      fixed_->Add(x, y, colour);
+      return;
+    }
+    auto *pixel = Pixel(x, y);
+    pixel[0] += colour.R_;
+    pixel[1] += colour.G_;
+    pixel[2] += colour.B_;
+  }
+
+  // Draw an opaque pixel on top of the rendered image when writing it out.
+  void Overlay(size_t x, size_t y, unsigned char R, unsigned char G, unsigned char B);
+
+  // Give memory back between rendering passes, while no thread is writing to
+  // the image. Only the sparse accumulator has something to give back.
+  void Trim() {
+    if (sparse_) {
+      sparse_->Trim();
+    }
+  }
+
+  // Whether several threads may call `Accumulate` at the same time.
+  bool IsConcurrent() const {
+    return fixed_ != nullptr;
+  }
+
+  // Map a point in world coordinates to continuous pixel coordinates: the
+  // corners of the view land on the centers of the corner pixels.
+  Point2d ToPixel(const Point2d &p) const {
+    return Point2d((p.x - view_.left_) * scale_x_, (p.y - view_.top_) * scale_y_);
+  }
+  Point2d ToWorld(const Point2d &pixel) const {
+    return Point2d(view_.left_ + pixel.x / scale_x_, view_.top_ + pixel.y / scale_y_);
+  }
+  // Pixels per world unit along x and y.
+  Point2d scale() const {
+    return Point2d(scale_x_, scale_y_);
+  }
+
+  // The world, and the part of it shown in the image (the whole world or the
+  // region of interest).
+  const Rect &world() const {
+    return world_;
+  }
+  const Rect &view() const {
+    return view_;
+  }
+  // Whether the view is a crop of the world, and the region whose points round
+  // to a pixel of the image: the view grown by half a pixel.
+  bool cropped() const {
+    return cropped_;
+  }
+  const Rect &bounds() const {
+    return bounds_;
+  }
+
+  // Copy the 3 * sx_ accumulator values of row `y` into `row`. Must not race
+  // with writers allocating sparse tiles or with `Trim`.
+  void ReadRow(size_t y, double *row) const;
+
+  // Zero-copy access to the accumulator while no render is running: one view
+  // of the whole frame for the dense accumulator, one per allocated tile for
+  // the sparse one. Pixels outside of every view hold `background_`. There is
+  // nothing to view in floating point for the fixed-point accumulator, use
+  // `ReadRow` instead.
+  template <typename F>
+  void ForEachView(F &&f) const {
+    assert(!fixed_);
+    if (!sparse_) {
+      f(ImageView{data_, 0, 0, sx_, sy_, 3 * sx_});
+      return;
+    }
+    const auto t = sparse_->tile_size();
+    sparse_->ForEachTileAt([&](size_t x0, size_t y0, const double *data) {
+      f(ImageView{data, x0, y0, std::min(t, sx_ - x0), std::min(t, sy_ - y0), 3 * t});
+    });
+  }
+
+  // Find the value range mapped to [0, 255] and sort the overlay, returns the
+  // minimum and the range.
+  auto PrepareQuantization() -> std::pair<double, double>;
+  // 8-bit row `y` with the overlay drawn in, using `values` (3 * sx_) as scratch.
+  void QuantizeRow(size_t y, double image_min, double image_range, double *values, unsigned char *row) const;
+
+  // Dense accumulator, null when the sparse or fixed-point one is used, or
+  // when there is no accumulator at all for `detectors_only_`.
   double *data_;
-  std::vector<std::unique_ptr<unsigned char[]>> maps_;
+  std::unique_ptr<SparseAccumulator> sparse_;
+  std::unique_ptr<FixedPointAccumulator> fixed_;
+  // Fixed-point cells are never converted in place, `AdjustGamma` only sets
+  // this and `ReadRow` applies the tone curve on the fly.
+  bool tone_mapped_{false};
+  // Value of the pixels the sparse accumulator never allocated.
+  double background_{0};
+
+  std::vector<std::pair<size_t, std::array<unsigned char, 3>>> overlay_;
   size_t sx_, sy_;
+
+ private:
+  Rect world_, view_, bounds_;
+  bool cropped_;
+  double scale_x_, scale_y_;
 };
 
 }  // namespace RayTracer2D
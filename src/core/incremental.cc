@@ -0,0 +1,66 @@
+#include "core/incremental.h"
+#include <cstdio>
+#include <cstdlib>
+
+namespace RayTracer2D {
+
+IncrementalRenderer::IncrementalRenderer(RayTracer &rt)
+    : rt_(rt), touches_(rt.option_.world_, rt.option_.num_rays_) {
+  if (rt.option_.accumulator_ != AccumulatorFormat::kDouble) {
+    fprintf(stderr, "Incremental rendering needs the double accumulator\n");
+    exit(1);
+  }
+  if (rt.HasPathKernel()) {
+    // The kernel would replay the negated paths through the scene as built.
+    fprintf(stderr, "Incremental rendering does not support a generated path kernel\n");
+    exit(1);
+  }
+}
+
+void IncrementalRenderer::Render() {
+  rt_.SetPathTouches(&touches_);
+  rt_.Render();
+  rt_.SetPathTouches(nullptr);
+}
+
+auto IncrementalRenderer::Update(const std::vector<SceneEdit> &edits) -> size_t {
+  auto &scene = *rt_.scene_;
+  uint64_t shapes = 0, cells = 0;
+  for (const auto &edit : edits) {
+    shapes |= PathTouches::ShapeBit(edit.shape_);
+    if (edit.offset_.x != 0 || edit.offset_.y != 0) {
+      // Paths that did not hit the shape can only run into it at its new place.
+      auto bounds = scene.shape(edit.shape_)->Bounds();
+      cells |= bounds.has_value() ? touches_.RectCells(bounds->Moved(edit.offset_)) : ~uint64_t{0};
+    }
+  }
+  std::vector<size_t> dirty;
+  for (size_t i = 0; i < touches_.size(); i++) {
+    if ((touches_.shapes(i) & shapes) != 0 || (touches_.cells(i) & cells) != 0) {
+      dirty.push_back(i);
+    }
+  }
+
+  for (auto i : dirty) {
+    auto ray = rt_.EmitRay(i);
+    ray.colour_ *= -1.0;
+    rt_.PropagateRay(ray, rt_.option_.depth_);
+  }
+  for (const auto &edit : edits) {
+    if (edit.material_.has_value()) {
+      scene.SetMaterial(edit.shape_, edit.material_.value());
+    }
+    if ((edit.offset_.x != 0 || edit.offset_.y != 0) && !scene.MoveShape(edit.shape_, edit.offset_)) {
+      fprintf(stderr, "Shape %u can not be moved\n", edit.shape_);
+    }
+  }
+  rt_.SetPathTouches(&touches_);
+  for (auto i : dirty) {
+    touches_.Clear(i);
+    rt_.PropagateRay(rt_.EmitRay(i), rt_.option_.depth_);
+  }
+  rt_.SetPathTouches(nullptr);
+  return dirty.size();
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include "core/material_registry.h"
+#include "core/path_touches.h"
+#include "core/point.h"
+#include "core/ray_tracer.h"
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// Change of one shape of a scene: another material and/or a move.
+struct SceneEdit {
+  uint32_t shape_;
+  std::optional<MaterialId> material_;
+  Point2d offset_{0, 0};
+};
+
+// Keeps the image of a tracer up to date through edits of its scene. Every
+// path remembers what it touched (see `PathTouches`), and an edit only
+// retraces the paths that hit an edited shape or, for moves, crossed the new
+// place of the shape. Their old contribution is traced once more with a
+// negated colour, which cancels it up to rounding, before the edit is applied
+// and they are traced anew. Replays are exact since all random numbers of a
+// path are keyed by its index.
+//
+//   auto incremental = IncrementalRenderer(rt);
+//   incremental.Render();
+//   incremental.Update({SceneEdit{ball, std::nullopt, Point2d(0.1, 0)}});
+//
+// Needs the double accumulator, the fixed-point cells do not take negative
+// values, and no generated path kernel, whose geometry is constant.
+class IncrementalRenderer {
+ public:
+  explicit IncrementalRenderer(RayTracer &rt);
+
+  DISALLOW_COPY_AND_MOVE(IncrementalRenderer);
+
+  // Render every path, like `RayTracer::Render`.
+  void Render();
+
+  // Apply `edits` to the scene and retrace, on the calling thread, the paths
+  // they may change. Return the number of retraced paths.
+  auto Update(const std::vector<SceneEdit> &edits) -> size_t;
+
+ private:
+  RayTracer &rt_;
+  PathTouches touches_;
+};
+
+}  // namespace RayTracer2D
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "core/point.h"
 #include "core/ray.h"
+#include "core/sampler.h"
 
 namespace RayTracer2D {
 
@@ -9,7 +11,15 @@ class Light {
   Light() = default;
   virtual ~Light() = default;
 
-  virtual Ray GetLightRay() = 0;
+  // Emit one ray. Random choices use dimensions [0, kEmissionDimensions) of
+  // `sample`.
+  virtual Ray GetLightRay(const SampleStream &sample) = 0;
+
+  // Move the light by `offset` between two renders. Return false if the light
+  // can not be moved.
+  virtual bool Translate(const Point2d &) {
+    return false;
+  }
 };
 
 };  // namespace RayTracer2D
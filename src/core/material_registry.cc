@@ -0,0 +1,17 @@
+#include "core/material_registry.h"
+#include <utility>
+
+namespace RayTracer2D {
+
+auto MaterialRegistry::Add(MaterialPtr material) -> MaterialId {
+  adopted_.push_back(std::move(material));
+  return Register(adopted_.back().get());
+}
+
+auto MaterialRegistry::Register(Material *material) -> MaterialId {
+  materials_.push_back(material);
+  refs_.push_back(MakeMaterialRef(material));
+  return static_cast<MaterialId>(materials_.size() - 1);
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "core/dispatch.h"
+#include "core/material.h"
+#include "utils/arena.h"
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// Compact handle to a material defined in a `MaterialRegistry`.
+using MaterialId = uint32_t;
+
+// Materials are defined once and shared by every shape referencing them. The
+// registry owns them: materials built in place live in its arena, materials
+// handed over as `MaterialPtr` are adopted.
+class MaterialRegistry {
+ public:
+  MaterialRegistry() = default;
+  DISALLOW_COPY_AND_MOVE(MaterialRegistry);
+
+  template <typename T, typename... Args>
+  auto Emplace(Args &&...args) -> MaterialId {
+    return Register(arena_.Create<T>(std::forward<Args>(args)...));
+  }
+
+  auto Add(MaterialPtr material) -> MaterialId;
+
+  Material *Get(const MaterialId id) const {
+    return materials_[id];
+  }
+
+  auto GetRef(const MaterialId id) const -> MaterialRef {
+    return refs_[id];
+  }
+
+  size_t size() const {
+    return materials_.size();
+  }
+
+ private:
+  auto Register(Material *material) -> MaterialId;
+
+  Arena arena_{4 * 1024};
+  std::vector<MaterialPtr> adopted_;
+  std::vector<Material *> materials_;
+  std::vector<MaterialRef> refs_;
+};
+
+}  // namespace RayTracer2D
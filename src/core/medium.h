@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include "core/colour.h"
+#include "core/ray.h"
+#include "utils/random.h"
+
+namespace RayTracer2D {
+
+// Participating medium (fog, smoke, a scattering gel) filling the world or the
+// inside of a closed shape. Rays scatter isotropically at the collisions with
+// its particles, and their colour is multiplied by the albedo.
+class Medium {
+ public:
+  explicit Medium(const Colour &albedo) : albedo_(albedo) {}
+  virtual ~Medium() = default;
+
+  // Parameter t in [t0, t1) of the first real collision of `ray` with the
+  // medium, or nothing if the ray gets through. Free-flight distances are
+  // drawn by delta tracking, with uniform numbers from `random`.
+  virtual auto SampleCollision(const Ray &ray, double t0, double t1, HashStream &random) const
+      -> std::optional<double> = 0;
+
+  const Colour &albedo() const {
+    return albedo_;
+  }
+
+ protected:
+  Colour albedo_;
+};
+
+using MediumPtr = std::unique_ptr<Medium>;
+
+}  // namespace RayTracer2D
@@ -0,0 +1,166 @@
+#include "core/metropolis.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "core/tile_splatter.h"
+#include "utils/hash.h"
+#include "utils/parallel.h"
+
+namespace RayTracer2D {
+
+MetropolisRenderer::MetropolisRenderer(RayTracer &rt) : rt_(rt) {}
+
+bool MetropolisRenderer::Supports(const RayTracer &rt) {
+  return !rt.scene_->HasMedia() && rt.option_.trace_path_.empty();
+}
+
+uint64_t MetropolisRenderer::ChainSeed(const uint64_t index) const {
+  return HashCombine(rt_.option_.seed_, index);
+}
+
+double MetropolisRenderer::Trace(const Sampler &sampler, SegmentBuffer &segments) {
+  segments.clear();
+  rt_.PropagateRay(rt_.EmitRay(SampleStream(&sampler, 0)), rt_.option_.depth_, &segments);
+  const auto &image = rt_.image_;
+  double deposit = 0;
+  for (const auto &segment : segments) {
+    // `Ray::Render` steps by whole pixels along the major axis from the lower
+    // end of the segment: count the steps in the part inside the image.
+    const auto d = segment.end_ - segment.begin_;
+    double t0 = 0, t1 = 1;
+    if (!image.bounds().Clip(segment.begin_, d, t0, t1)) {
+      continue;
+    }
+    const auto a = image.ToPixel(segment.begin_);
+    const auto b = image.ToPixel(segment.end_);
+    const auto x_major = std::abs(b.x - a.x) >= std::abs(b.y - a.y);
+    const auto length = x_major ? std::abs(b.x - a.x) : std::abs(b.y - a.y);
+    const auto forward = x_major ? b.x >= a.x : b.y >= a.y;
+    // The clipped part, as distances from the lower end.
+    const auto from = (forward ? t0 : 1 - t1) * length;
+    const auto to = (forward ? t1 : 1 - t0) * length;
+    const auto steps = std::floor(to) - std::ceil(from) + 1;
+    if (steps > 0) {
+      deposit += segment.colour_.Luminance() * steps;
+    }
+  }
+  return deposit;
+}
+
+// Chains start from bootstrap paths picked in proportion to their deposit,
+// by systematic resampling so that bright paths seed several chains.
+auto MetropolisRenderer::Bootstrap(const size_t threads) -> std::vector<Chain> {
+  const auto &option = rt_.option_;
+  const auto count = std::max<size_t>(option.metropolis_bootstrap_, 1);
+  auto deposits = std::vector<double>(count);
+  auto buffers = std::vector<SegmentBuffer>(threads);
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 64)
+  for (size_t i = 0; i < count; i++) {
+    auto sampler = PrimarySampleSpace(ChainSeed(i), kLargeStepProbability);
+    deposits[i] = Trace(sampler, buffers[ThreadIndex()]);
+  }
+  auto cumulative = std::vector<double>(count);
+  double sum = 0;
+  for (size_t i = 0; i < count; i++) {
+    sum += deposits[i];
+    cumulative[i] = sum;
+  }
+  brightness_ = sum / count;
+  if (sum == 0) {
+    return {};
+  }
+
+  const auto num_chains = std::clamp<size_t>(option.metropolis_chains_, 1, option.num_rays_);
+  auto offset = HashStream(HashCombine(option.seed_, count)).Next();
+  std::vector<Chain> chains;
+  chains.reserve(num_chains);
+  for (size_t c = 0; c < num_chains; c++) {
+    const auto target = (c + offset) / num_chains * sum;
+    const auto i = std::min<size_t>(std::upper_bound(cumulative.begin(), cumulative.end(), target) - cumulative.begin(),
+                                    count - 1);
+    auto chain = Chain{PrimarySampleSpace(ChainSeed(i), kLargeStepProbability),
+                       HashStream(HashCombine(~option.seed_, c)),
+                       {},
+                       {},
+                       0,
+                       option.num_rays_ / num_chains + (c < option.num_rays_ % num_chains),
+                       0};
+    chain.deposit_ = Trace(chain.sampler_, chain.path_);
+    chain.sampler_.Accept();
+    // Chains resampled from the same bootstrap path mutate it with numbers of
+    // their own, seeded past those of the bootstrap paths.
+    chain.sampler_.Reseed(ChainSeed(count + c));
+    chains.push_back(std::move(chain));
+  }
+  return chains;
+}
+
+void MetropolisRenderer::Append(const SegmentBuffer &path, const double weight, SegmentBuffer &out) {
+  if (weight <= 0) {
+    return;
+  }
+  for (const auto &segment : path) {
+    out.push_back(Segment{segment.begin_, segment.end_, segment.colour_ * weight});
+  }
+}
+
+void MetropolisRenderer::Step(Chain &chain, SegmentBuffer &out) {
+  chain.sampler_.StartIteration();
+  const auto deposit = Trace(chain.sampler_, chain.proposal_);
+  const auto accept = std::min(1.0, deposit / chain.deposit_);
+  Append(chain.path_, (1 - accept) * brightness_ / chain.deposit_, out);
+  if (accept > 0) {
+    Append(chain.proposal_, accept * brightness_ / deposit, out);
+  }
+  if (chain.random_.Next() < accept) {
+    chain.sampler_.Accept();
+    std::swap(chain.path_, chain.proposal_);
+    chain.deposit_ = deposit;
+    chain.accepted_++;
+  } else {
+    chain.sampler_.Reject();
+  }
+  chain.remaining_--;
+}
+
+void MetropolisRenderer::Render(const size_t threads) {
+  const auto &option = rt_.option_;
+  auto chains = Bootstrap(threads);
+  if (chains.empty()) {
+    if (option.progress_) {
+      fprintf(stderr, "Metropolis: no bootstrap path reaches the view\n");
+    }
+    return;
+  }
+
+  auto splatter = TileSplatter(rt_.image_, option.tile_size_, threads);
+  auto buffers = std::vector<SegmentBuffer>(threads);
+  const auto per_pass = std::max<size_t>(option.batch_size_ / chains.size(), 1);
+  size_t done = 0;
+  while (chains.front().remaining_ > 0) {
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 1)
+    for (size_t c = 0; c < chains.size(); c++) {
+      auto &chain = chains[c];
+      for (size_t i = 0; i < per_pass && chain.remaining_ > 0; i++) {
+        Step(chain, buffers[ThreadIndex()]);
+      }
+    }
+    splatter.Splat(buffers);
+    rt_.image_.Trim();
+    done += per_pass;
+    if (option.progress_ && option.num_rays_ > 10) {
+      fprintf(stderr, "Progress=%f\n", std::min(1.0, static_cast<double>(done * chains.size()) / option.num_rays_));
+    }
+  }
+
+  iterations_ = option.num_rays_;
+  for (const auto &chain : chains) {
+    accepted_ += chain.accepted_;
+  }
+  if (option.progress_) {
+    fprintf(stderr, "Metropolis: %zu chains, bootstrap brightness %g, %.1f%% accepted\n", chains.size(), brightness_,
+            100 * acceptance());
+  }
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "core/ray_tracer.h"
+#include "core/segment.h"
+#include "sampler/primary_sample_space.h"
+#include "utils/macros.h"
+#include "utils/random.h"
+
+namespace RayTracer2D {
+
+// Primary sample space Metropolis light transport on top of
+// `RayTracer::PropagateRay`. Chains of paths random walk over the random
+// numbers paths are drawn from, spending their time on paths in proportion
+// to what they deposit into the image, so light reaching the view through a
+// narrow aperture or a long chain of mirrors is found once and then explored
+// locally instead of being rediscovered by chance.
+//
+// A bootstrap phase of independent paths measures the mean deposit `b` and
+// seeds the chains with paths picked in proportion to their deposit. Every
+// iteration deposits the current and the proposed path weighted by their
+// acceptance (the expected value of the step) and by `b` over their deposit,
+// so `num_rays_` iterations converge to the image of `num_rays_` rays. The
+// deposit of a path counts the pixel steps of `Ray::Render` exactly, hence
+// every iteration deposits `b` in total.
+class MetropolisRenderer {
+ public:
+  explicit MetropolisRenderer(RayTracer &rt);
+
+  DISALLOW_COPY_AND_MOVE(MetropolisRenderer);
+
+  // Whether the scene and options of `rt` allow it: no media, which draw
+  // numbers outside the primary sample space, and no path recording.
+  static bool Supports(const RayTracer &rt);
+
+  // Run the chains on `threads` threads. The image only depends on the chain
+  // count, not on the thread count.
+  void Render(const size_t threads);
+
+  // Mean deposit of a path measured by the bootstrap, 0 when no bootstrap
+  // path reaches the view, and the fraction of accepted proposals.
+  double brightness() const {
+    return brightness_;
+  }
+  double acceptance() const {
+    return iterations_ == 0 ? 0 : static_cast<double>(accepted_) / static_cast<double>(iterations_);
+  }
+
+  // Probability of proposing fresh random numbers rather than perturbing.
+  static constexpr double kLargeStepProbability = 0.3;
+
+ private:
+  struct Chain {
+    PrimarySampleSpace sampler_;
+    // Acceptance tests, kept apart from the numbers of the paths.
+    HashStream random_;
+    SegmentBuffer path_, proposal_;
+    double deposit_;
+    size_t remaining_;
+    size_t accepted_;
+  };
+
+  // Trace the path drawn from `sampler` into `segments` and return its
+  // deposit: the luminance of the pixel steps it rasterizes.
+  double Trace(const Sampler &sampler, SegmentBuffer &segments);
+  auto Bootstrap(const size_t threads) -> std::vector<Chain>;
+  void Step(Chain &chain, SegmentBuffer &out);
+  static void Append(const SegmentBuffer &path, const double weight, SegmentBuffer &out);
+  uint64_t ChainSeed(const uint64_t index) const;
+
+  RayTracer &rt_;
+  double brightness_{0};
+  uint64_t iterations_{0};
+  uint64_t accepted_{0};
+};
+
+}  // namespace RayTracer2D
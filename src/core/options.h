@@ -1,8 +1,24 @@
 #pragma once
 
 #include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+#include "core/colour.h"
+#include "core/rect.h"
+#include "core/sampler.h"
+#include "utils/macros.h"
+
 namespace RayTracer2D {
 
+enum class AccumulatorFormat {
+  // Three doubles per pixel.
+  kDouble,
+  // Three fixed-point integers per pixel, updated atomically.
+  kFixed32,
+  kFixed64,
+};
+
 struct Options {
   explicit Options(size_t sx, size_t sy, size_t num_rays, size_t depth)
       : sx_(sx), sy_(sy), num_rays_(num_rays), depth_(depth) {}
@@ -10,6 +26,107 @@ struct Options {
   size_t sx_, sy_;
   size_t num_rays_;
   size_t depth_;
+
+  // Region of the world mapped onto the sx_ by sy_ image, or only the region
+  // of interest `roi_` when set. Segments outside the ROI are never
+  // rasterized, and paths stop early once they can no longer reach it.
+  Rect world_{W_LEFT, W_TOP, W_RIGHT, W_BOTTOM};
+  std::optional<Rect> roi_;
+
+  // Number of worker threads, 0 uses every available core.
+  size_t threads_{0};
+
+  // Print the render progress to stderr.
+  bool progress_{true};
+
+  // Pick the thread count, batch and tile sizes with calibration bursts before
+  // rendering, see `Autotune`, and keep the result in `autotune_cache_` (if
+  // not empty) for later runs on the same scene and machine.
+  bool autotune_{false};
+  std::string autotune_cache_;
+
+  // Buffer the traced segments and splat them tile by tile instead of
+  // rasterizing each segment into the image as soon as it is produced.
+  bool deferred_{false};
+  // Edge length in pixels of the square screen tiles used by deferred splatting.
+  size_t tile_size_{64};
+  // Number of rays traced between two deferred splatting passes.
+  size_t batch_size_{16384};
+
+  // Accumulate into lazily allocated tiles instead of one dense frame.
+  bool sparse_{false};
+  // Resident memory allowed for sparse tiles before cold ones are spilled to
+  // a backing file in `spill_dir_`, 0 for no limit.
+  size_t memory_budget_mb_{0};
+  std::string spill_dir_{"/tmp"};
+
+  // Cell format of the dense accumulator. Fixed-point cells hold
+  // `fixed_fraction_bits_` bits after the binary point, 0 picks 12 for 32-bit
+  // cells (sums up to 2^20, brighter pixels saturate) and 32 for 64-bit
+  // cells. Threads splat into
+  // fixed-point frames directly, without deferred splatting.
+  AccumulatorFormat accumulator_{AccumulatorFormat::kDouble};
+  int fixed_fraction_bits_{0};
+
+  // Periodically write a tone-mapped preview to `preview_path_` (if not
+  // empty), every so many rays and/or seconds. Previews are downsampled so
+  // that their longer edge is at most `preview_size_` pixels.
+  std::string preview_path_;
+  size_t preview_every_rays_{0};
+  double preview_every_seconds_{0};
+  size_t preview_size_{1024};
+
+  // Final image, QOI when the name ends in ".qoi", PPM otherwise.
+  std::string output_path_{"output.ppm"};
+
+  // Scene description to render instead of the default scene, see
+  // `SceneDescription`.
+  std::string scene_path_;
+  // Render this many frames of the keyframed scene description into
+  // numbered images instead of one image, see `SequenceRenderer`.
+  size_t frames_{0};
+  // Render one image per albedo in `sweep_albedos_` of the scattering
+  // material named `sweep_material_` in the scene description, numbered
+  // after `output_path_`, see `SweepRenderer`.
+  std::string sweep_material_;
+  std::vector<Colour> sweep_albedos_;
+
+  // Sequence the emission and scattering random numbers are drawn from, and
+  // its seed. Scattering surfaces of the default scene are Lambertian when
+  // `lambertian_` is set, uniform in angle otherwise.
+  SamplerType sampler_{SamplerType::kOwenSobol};
+  uint64_t seed_{0};
+  bool lambertian_{false};
+  // Extinction coefficient, per unit length, of a grey fog filling the
+  // default scene; 0 for clear air.
+  double fog_density_{0};
+
+  // Trace light wedges instead of rays where the scene allows it, see
+  // `BeamTracer`.
+  bool beams_{false};
+
+  // Explore paths with `metropolis_chains_` Metropolis chains seeded from
+  // `metropolis_bootstrap_` independent paths, see `MetropolisRenderer`.
+  bool metropolis_{false};
+  size_t metropolis_chains_{64};
+  size_t metropolis_bootstrap_{65536};
+
+  // Skip the image: no accumulator is allocated and nothing is rasterized,
+  // only the detectors of the scene measure the light, written to
+  // `detector_path_`, see `DetectorSet`.
+  bool detectors_only_{false};
+  std::string detector_path_{"detectors.bin"};
+
+  // Profile the pipeline stages into `profile_path_` (if not empty), in
+  // builds with RT2D_PERF_COUNTERS, see `StageProfiler`.
+  std::string profile_path_;
+
+  // Record every `trace_every_`-th path into the binary trace `trace_path_`
+  // (if not empty), see `PathRecorder`. Past `trace_limit_mb_` (0 for no
+  // limit) only the most recent paths of every thread are kept.
+  std::string trace_path_;
+  size_t trace_every_{1};
+  size_t trace_limit_mb_{0};
 };
 
 }  // namespace RayTracer2D
@@ -0,0 +1,101 @@
+#include "core/path_recorder.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include "utils/parallel.h"
+
+namespace RayTracer2D {
+
+PathRecorder::PathRecorder(const Options &option, size_t threads, size_t ring_records)
+    : every_(std::max<size_t>(option.trace_every_, 1)),
+      budget_records_(option.trace_limit_mb_ == 0 ? std::numeric_limits<uint64_t>::max()
+                                                  : (option.trace_limit_mb_ << 20) / sizeof(PathRecord)),
+      rings_(threads),
+      file_(option.trace_path_, std::ios::binary) {
+  for (auto &ring : rings_) {
+    ring.records_.resize(ring_records);
+  }
+  if (!file_) {
+    fprintf(stderr, "can not create trace file %s\n", option.trace_path_.c_str());
+    exhausted_ = true;
+    return;
+  }
+  TraceHeader header{};
+  memcpy(header.magic_, kTraceMagic, sizeof(kTraceMagic));
+  header.version_ = kTraceVersion;
+  header.record_size_ = sizeof(PathRecord);
+  header.sx_ = static_cast<uint32_t>(option.sx_);
+  header.sy_ = static_cast<uint32_t>(option.sy_);
+  header.depth_ = static_cast<uint32_t>(option.depth_);
+  header.sample_every_ = every_;
+  header.world_ = option.world_;
+  header.view_ = option.roi_.value_or(option.world_);
+  file_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+PathRecorder::~PathRecorder() {
+  for (auto &ring : rings_) {
+    Drain(ring, true);
+  }
+  if (dropped() > 0) {
+    fprintf(stderr, "PathRecorder: trace limit reached, %lu older records were dropped\n",
+            static_cast<unsigned long>(dropped()));
+  }
+}
+
+void PathRecorder::Record(const PathRecord &record) {
+  auto &ring = rings_[ThreadIndex()];
+  const auto capacity = ring.records_.size();
+  if (ring.size_ == capacity && !exhausted_.load(std::memory_order_relaxed)) {
+    Drain(ring, false);
+  }
+  if (ring.size_ < capacity) {
+    ring.records_[(ring.head_ + ring.size_) % capacity] = record;
+    ring.size_++;
+  } else {
+    ring.records_[ring.head_] = record;
+    ring.head_ = (ring.head_ + 1) % capacity;
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// On the final drain the records beyond the budget are written anyway: they
+// are the tail of the run the overwriting mode is there to keep.
+void PathRecorder::Drain(Ring &ring, bool final) {
+  std::lock_guard lock(mutex_);
+  if (!file_) {
+    return;
+  }
+  const auto capacity = ring.records_.size();
+  auto count = ring.size_;
+  if (!final) {
+    count = static_cast<size_t>(std::min<uint64_t>(count, budget_records_ - std::min(written_, budget_records_)));
+  }
+  for (size_t i = 0; i < count;) {
+    const auto begin = (ring.head_ + i) % capacity;
+    const auto n = std::min(count - i, capacity - begin);
+    file_.write(reinterpret_cast<const char *>(&ring.records_[begin]), n * sizeof(PathRecord));
+    i += n;
+  }
+  written_ += count;
+  ring.head_ = (ring.head_ + count) % capacity;
+  ring.size_ -= count;
+  if (written_ >= budget_records_) {
+    exhausted_ = true;
+  }
+}
+
+TraceReader::TraceReader(const std::string &path) : file_(path, std::ios::binary) {
+  if (!file_.read(reinterpret_cast<char *>(&header_), sizeof(header_))) {
+    return;
+  }
+  ok_ = memcmp(header_.magic_, kTraceMagic, sizeof(kTraceMagic)) == 0 && header_.version_ == kTraceVersion &&
+        header_.record_size_ == sizeof(PathRecord);
+}
+
+bool TraceReader::Next(PathRecord &record) {
+  return ok_ && static_cast<bool>(file_.read(reinterpret_cast<char *>(&record), sizeof(record)));
+}
+
+}  // namespace RayTracer2D
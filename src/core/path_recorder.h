@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "core/options.h"
+#include "core/rect.h"
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// One vertex of a recorded path: the emission point (depth 0) or the hit of
+// bounce `depth_`, reached by a ray of colour (r_, g_, b_) after travelling
+// `t_`. Stored as is in trace files.
+struct PathRecord {
+  uint64_t path_;
+  float x_, y_;
+  float t_;
+  float r_, g_, b_;
+  uint32_t shape_;
+  uint32_t material_;
+  uint16_t depth_;
+  uint8_t reserved_[6];
+};
+static_assert(sizeof(PathRecord) == 48, "PathRecord is a file format");
+
+// Header of a trace file, followed by a sequence of `PathRecord`. The records
+// of one path are in order, but may be interleaved with other paths. `view_`
+// is the part of `world_` the traced image showed, the region of interest if
+// there was one.
+struct TraceHeader {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t record_size_;
+  uint32_t sx_, sy_;
+  uint32_t depth_;
+  uint32_t reserved_;
+  uint64_t sample_every_;
+  Rect world_;
+  Rect view_;
+};
+static_assert(sizeof(TraceHeader) == 104, "TraceHeader is a file format");
+
+constexpr char kTraceMagic[8] = {'R', 'T', '2', 'D', 'P', 'A', 'T', 'H'};
+constexpr uint32_t kTraceVersion = 2;
+
+// Records every `trace_every_`-th path of a render into `trace_path_`.
+//
+// Every thread appends to a ring buffer of its own, which is written to the
+// file under a lock when it fills up. Once the file reaches
+// `trace_limit_mb_`, full rings overwrite their oldest records instead, so the
+// trace still ends with the last paths of every thread, flushed on
+// destruction: the end of a long run is usually the interesting part.
+class PathRecorder {
+ public:
+  explicit PathRecorder(const Options &option, size_t threads, size_t ring_records = 4096);
+  ~PathRecorder();
+
+  DISALLOW_COPY_AND_MOVE(PathRecorder);
+
+  bool Sampled(const uint64_t path) const {
+    return path % every_ == 0;
+  }
+
+  // Append a record to the ring of the calling thread (`ThreadIndex`).
+  void Record(const PathRecord &record);
+
+  uint64_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Ring {
+    std::vector<PathRecord> records_;
+    size_t head_{0};
+    size_t size_{0};
+  };
+
+  // Write the ring to the file as far as the budget allows, oldest first.
+  void Drain(Ring &ring, bool final);
+
+  uint64_t every_;
+  uint64_t budget_records_;
+  std::vector<Ring> rings_;
+  std::atomic<bool> exhausted_{false};
+  std::atomic<uint64_t> dropped_{0};
+
+  std::mutex mutex_;
+  std::ofstream file_;
+  uint64_t written_{0};
+};
+
+// Sequential reader of trace files.
+class TraceReader {
+ public:
+  explicit TraceReader(const std::string &path);
+
+  bool ok() const {
+    return ok_;
+  }
+  const TraceHeader &header() const {
+    return header_;
+  }
+
+  bool Next(PathRecord &record);
+
+ private:
+  std::ifstream file_;
+  TraceHeader header_{};
+  bool ok_{false};
+};
+
+}  // namespace RayTracer2D
@@ -0,0 +1,62 @@
+#include "core/path_touches.h"
+#include <algorithm>
+#include <cmath>
+
+namespace RayTracer2D {
+
+static int ClampCell(const double g) {
+  constexpr auto kLast = static_cast<int>(PathTouches::kGrid) - 1;
+  return g <= 0 ? 0 : g >= kLast ? kLast : static_cast<int>(g);
+}
+
+PathTouches::PathTouches(const Rect &world, const size_t paths)
+    : world_(world),
+      scale_x_(kGrid / (world.right_ - world.left_)),
+      scale_y_(kGrid / (world.bottom_ - world.top_)),
+      shapes_(paths, 0),
+      cells_(paths, 0) {}
+
+uint64_t PathTouches::ColumnCells(const int column, double v0, double v1) {
+  if (v0 > v1) {
+    std::swap(v0, v1);
+  }
+  uint64_t cells = 0;
+  for (auto row = ClampCell(v0); row <= ClampCell(v1); row++) {
+    cells |= uint64_t{1} << (row * kGrid + column);
+  }
+  return cells;
+}
+
+// Walk the columns the segment spans; in each, the segment covers the rows
+// between its ordinates at the column borders. The border columns extend to
+// infinity so that parts outside of the world are clamped onto them.
+auto PathTouches::SegmentCells(const Point2d &a, const Point2d &b) const -> uint64_t {
+  auto u0 = GridX(a.x), v0 = GridY(a.y);
+  auto u1 = GridX(b.x), v1 = GridY(b.y);
+  if (u0 > u1) {
+    std::swap(u0, u1);
+    std::swap(v0, v1);
+  }
+  if (!(u1 - u0 > 1e-12)) {
+    return ColumnCells(ClampCell(u0), v0, v1);
+  }
+  const auto slope = (v1 - v0) / (u1 - u0);
+  const auto last = static_cast<int>(kGrid) - 1;
+  uint64_t cells = 0;
+  for (auto column = ClampCell(u0); column <= ClampCell(u1); column++) {
+    const auto lo = column == 0 ? u0 : std::max(u0, static_cast<double>(column));
+    const auto hi = column == last ? u1 : std::min(u1, static_cast<double>(column + 1));
+    cells |= ColumnCells(column, v0 + (lo - u0) * slope, v0 + (hi - u0) * slope);
+  }
+  return cells;
+}
+
+auto PathTouches::RectCells(const Rect &rect) const -> uint64_t {
+  uint64_t cells = 0;
+  for (auto column = ClampCell(GridX(rect.left_)); column <= ClampCell(GridX(rect.right_)); column++) {
+    cells |= ColumnCells(column, GridY(rect.top_), GridY(rect.bottom_));
+  }
+  return cells;
+}
+
+}  // namespace RayTracer2D
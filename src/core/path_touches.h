@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "core/point.h"
+#include "core/rect.h"
+
+namespace RayTracer2D {
+
+// What each path of a render touched: the shapes it hit, as a mask of shape
+// ids modulo 64, and the cells of a `kGrid` x `kGrid` grid over the world its
+// segments crossed, clamped to the border cells outside of it. Both masks are
+// conservative, so an edit of the scene can only change paths whose masks
+// intersect it, see `IncrementalRenderer`. Takes 16 bytes per path.
+class PathTouches {
+ public:
+  static constexpr size_t kGrid = 8;
+
+  explicit PathTouches(const Rect &world, const size_t paths);
+
+  size_t size() const {
+    return shapes_.size();
+  }
+
+  void Clear(const size_t path) {
+    shapes_[path] = 0;
+    cells_[path] = 0;
+  }
+
+  // Paths are traced by one thread each, so marking needs no atomics.
+  void MarkShape(const size_t path, const uint32_t shape) {
+    shapes_[path] |= ShapeBit(shape);
+  }
+  void MarkSegment(const size_t path, const Point2d &a, const Point2d &b) {
+    cells_[path] |= SegmentCells(a, b);
+  }
+
+  uint64_t shapes(const size_t path) const {
+    return shapes_[path];
+  }
+  uint64_t cells(const size_t path) const {
+    return cells_[path];
+  }
+
+  static uint64_t ShapeBit(const uint32_t shape) {
+    return uint64_t{1} << (shape % 64);
+  }
+  auto SegmentCells(const Point2d &a, const Point2d &b) const -> uint64_t;
+  auto RectCells(const Rect &rect) const -> uint64_t;
+
+ private:
+  // Grid coordinates of a world position.
+  double GridX(const double x) const {
+    return (x - world_.left_) * scale_x_;
+  }
+  double GridY(const double y) const {
+    return (y - world_.top_) * scale_y_;
+  }
+  // Cells of column `column` from row `v0` to row `v1`, in grid units.
+  static uint64_t ColumnCells(const int column, double v0, double v1);
+
+  Rect world_;
+  double scale_x_, scale_y_;
+  std::vector<uint64_t> shapes_;
+  std::vector<uint64_t> cells_;
+};
+
+}  // namespace RayTracer2D
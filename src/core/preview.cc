@@ -0,0 +1,139 @@
+#include "core/preview.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+namespace RayTracer2D {
+
+PreviewWriter::PreviewWriter(const Image &image, const Options &option)
+    : image_(image),
+      path_(option.preview_path_),
+      every_rays_(option.preview_every_rays_),
+      every_seconds_(option.preview_every_seconds_),
+      factor_(std::max<size_t>(1, (std::max(image.sx_, image.sy_) + option.preview_size_ - 1) / option.preview_size_)),
+      width_((image.sx_ + factor_ - 1) / factor_),
+      height_((image.sy_ + factor_ - 1) / factor_),
+      pixels_(width_ * height_ * 3),
+      last_time_(std::chrono::steady_clock::now()),
+      thread_(&PreviewWriter::Run, this) {}
+
+PreviewWriter::~PreviewWriter() {
+  {
+    std::unique_lock lock(mutex_);
+    cv_.wait(lock, [&] { return state_ == State::kIdle; });
+    state_ = State::kStopping;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+void PreviewWriter::MaybeSnapshot(const size_t rays_done) {
+  auto now = std::chrono::steady_clock::now();
+  auto due = (every_rays_ > 0 && rays_done - last_rays_ >= every_rays_) ||
+             (every_seconds_ > 0 && std::chrono::duration<double>(now - last_time_).count() >= every_seconds_);
+  if (!due) {
+    return;
+  }
+  {
+    // Never wait for a slow disk: skip this snapshot if the last one is still
+    // being written.
+    std::lock_guard lock(mutex_);
+    if (state_ != State::kIdle) {
+      return;
+    }
+    state_ = State::kReading;
+  }
+  last_rays_ = rays_done;
+  last_time_ = now;
+  cv_.notify_all();
+}
+
+void PreviewWriter::WaitForSnapshot() {
+  std::unique_lock lock(mutex_);
+  cv_.wait(lock, [&] { return state_ != State::kReading; });
+}
+
+void PreviewWriter::Run() {
+  while (true) {
+    {
+      std::unique_lock lock(mutex_);
+      cv_.wait(lock, [&] { return state_ == State::kReading || state_ == State::kStopping; });
+      if (state_ == State::kStopping) {
+        return;
+      }
+    }
+    Quantize();
+    {
+      std::lock_guard lock(mutex_);
+      state_ = State::kWriting;
+    }
+    cv_.notify_all();
+
+    Write();
+    {
+      std::lock_guard lock(mutex_);
+      state_ = State::kIdle;
+    }
+    cv_.notify_all();
+  }
+}
+
+// Two read-only passes over the accumulator: the value range first, then the
+// downsampled 8-bit image. The tone curve is monotonic, so the range of the
+// curve is the curve of the range.
+void PreviewWriter::Quantize() {
+  const auto sx = image_.sx_;
+  auto row = std::vector<double>(3 * sx);
+  auto sums = std::vector<double>(3 * width_);
+
+  double image_min = INFINITY;
+  double image_max = -INFINITY;
+  for (size_t y = 0; y < image_.sy_; y++) {
+    image_.ReadRow(y, row.data());
+    for (auto v : row) {
+      image_min = std::min(image_min, v);
+      image_max = std::max(image_max, v);
+    }
+  }
+  const auto low = Image::ToneCurve(image_min);
+  const auto range = std::max(Image::ToneCurve(image_max) - low, 1e-12);
+
+  for (size_t py = 0; py < height_; py++) {
+    std::fill(sums.begin(), sums.end(), 0.0);
+    const auto y_end = std::min((py + 1) * factor_, image_.sy_);
+    for (auto y = py * factor_; y < y_end; y++) {
+      image_.ReadRow(y, row.data());
+      for (size_t x = 0; x < sx; x++) {
+        for (size_t c = 0; c < 3; c++) {
+          sums[(x / factor_) * 3 + c] += row[x * 3 + c];
+        }
+      }
+    }
+    for (size_t px = 0; px < width_; px++) {
+      const auto x_count = std::min((px + 1) * factor_, sx) - px * factor_;
+      const auto count = static_cast<double>(x_count * (y_end - py * factor_));
+      for (size_t c = 0; c < 3; c++) {
+        auto v = (Image::ToneCurve(sums[px * 3 + c] / count) - low) / range;
+        pixels_[(py * width_ + px) * 3 + c] = static_cast<unsigned char>(255.0 * std::clamp(v, 0.0, 1.0));
+      }
+    }
+  }
+}
+
+// Write next to the target and rename, so a viewer never sees half a file.
+void PreviewWriter::Write() const {
+  auto tmp_path = path_ + ".tmp";
+  {
+    std::ofstream ofs(tmp_path, std::ios::binary);
+    if (!ofs) {
+      fprintf(stderr, "can not create preview file %s\n", tmp_path.c_str());
+      return;
+    }
+    ofs << "P6\n" << width_ << " " << height_ << "\n255\n";
+    ofs.write(reinterpret_cast<const char *>(pixels_.data()), pixels_.size());
+  }
+  std::rename(tmp_path.c_str(), path_.c_str());
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "core/image.h"
+#include "core/options.h"
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// Writes tone-mapped previews of an image that is still being rendered.
+//
+// The render loop calls `MaybeSnapshot` at points where the accumulator is
+// consistent and then keeps tracing. A background thread reads the
+// accumulator and quantizes it into a small 8-bit buffer while the rays are
+// traced, and writes the file after that. The loop must call `WaitForSnapshot`
+// before it modifies the accumulator again. That call only blocks if the read
+// has not finished yet.
+class PreviewWriter {
+ public:
+  explicit PreviewWriter(const Image &image, const Options &option);
+  ~PreviewWriter();
+
+  DISALLOW_COPY_AND_MOVE(PreviewWriter);
+
+  // Start a snapshot if one is due and the previous preview is written out.
+  void MaybeSnapshot(const size_t rays_done);
+  void WaitForSnapshot();
+
+ private:
+  enum class State { kIdle, kReading, kWriting, kStopping };
+
+  void Run();
+  void Quantize();
+  void Write() const;
+
+  const Image &image_;
+  std::string path_;
+  size_t every_rays_;
+  double every_seconds_;
+
+  // Previews are box-downsampled by an integer factor to fit `preview_size_`.
+  size_t factor_;
+  size_t width_, height_;
+  std::vector<unsigned char> pixels_;
+
+  size_t last_rays_{0};
+  std::chrono::steady_clock::time_point last_time_;
+
+  State state_{State::kIdle};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+};
+
+}  // namespace RayTracer2D
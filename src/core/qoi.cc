@@ -0,0 +1,114 @@
+#include "core/qoi.h"
+#include <algorithm>
+#include <cstdint>
+#include "utils/parallel.h"
+
+namespace RayTracer2D {
+
+static constexpr unsigned char kOpIndex = 0x00;
+static constexpr unsigned char kOpDiff = 0x40;
+static constexpr unsigned char kOpLuma = 0x80;
+static constexpr unsigned char kOpRun = 0xc0;
+static constexpr unsigned char kOpRgb = 0xfe;
+static constexpr int kMaxRun = 62;
+
+// Pixels are opaque, the alpha term of the hash is the constant 255 * 11.
+static int Hash(const unsigned char *px) {
+  return (px[0] * 3 + px[1] * 5 + px[2] * 7 + 255 * 11) % 64;
+}
+
+void EncodeQoiStrip(const unsigned char *rgb, size_t count, std::vector<unsigned char> &out) {
+  // RGBA slots: the alpha of written slots is 255, so no pixel matches an
+  // unwritten (all zero) one.
+  unsigned char index[64][4] = {};
+  const unsigned char *prev = nullptr;
+  int run = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    const auto *px = rgb + 3 * i;
+    if (prev != nullptr && std::equal(px, px + 3, prev)) {
+      if (++run == kMaxRun) {
+        out.push_back(kOpRun | (run - 1));
+        run = 0;
+      }
+      continue;
+    }
+    if (run > 0) {
+      out.push_back(kOpRun | (run - 1));
+      run = 0;
+    }
+
+    auto *slot = index[Hash(px)];
+    if (prev == nullptr) {
+      out.insert(out.end(), {kOpRgb, px[0], px[1], px[2]});
+    } else if (std::equal(px, px + 3, slot) && slot[3] == 255) {
+      out.push_back(kOpIndex | Hash(px));
+    } else {
+      const auto dr = static_cast<int8_t>(px[0] - prev[0]);
+      const auto dg = static_cast<int8_t>(px[1] - prev[1]);
+      const auto db = static_cast<int8_t>(px[2] - prev[2]);
+      const auto dr_dg = dr - dg;
+      const auto db_dg = db - dg;
+      if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+        out.push_back(kOpDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+      } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+        out.push_back(kOpLuma | (dg + 32));
+        out.push_back((dr_dg + 8) << 4 | (db_dg + 8));
+      } else {
+        out.insert(out.end(), {kOpRgb, px[0], px[1], px[2]});
+      }
+    }
+    std::copy(px, px + 3, slot);
+    slot[3] = 255;
+    prev = px;
+  }
+  if (run > 0) {
+    out.push_back(kOpRun | (run - 1));
+  }
+}
+
+static void PutBigEndian(std::ostream &os, uint32_t v) {
+  const char bytes[] = {static_cast<char>(v >> 24), static_cast<char>(v >> 16), static_cast<char>(v >> 8),
+                        static_cast<char>(v)};
+  os.write(bytes, sizeof(bytes));
+}
+
+bool WriteQoi(std::ostream &os, size_t width, size_t height, const RowReader &read_row, size_t threads,
+              size_t strip_rows) {
+  os.write("qoif", 4);
+  PutBigEndian(os, static_cast<uint32_t>(width));
+  PutBigEndian(os, static_cast<uint32_t>(height));
+  // 3 channels, sRGB with linear alpha.
+  os.put(3);
+  os.put(0);
+
+  // Strips are encoded a group at a time, one strip per thread, and written
+  // out in order before the next group starts.
+  const auto workers = static_cast<size_t>(ResolveThreads(threads));
+  const auto num_strips = (height + strip_rows - 1) / strip_rows;
+  auto pixels = std::vector<std::vector<unsigned char>>(workers);
+  auto chunks = std::vector<std::vector<unsigned char>>(workers);
+  for (size_t group = 0; group < num_strips; group += workers) {
+    const auto group_size = std::min(workers, num_strips - group);
+#pragma omp parallel for num_threads(workers) schedule(static, 1)
+    for (size_t s = 0; s < group_size; s++) {
+      const auto y0 = (group + s) * strip_rows;
+      const auto rows = std::min(strip_rows, height - y0);
+      pixels[s].resize(rows * width * 3);
+      for (size_t y = 0; y < rows; y++) {
+        read_row(y0 + y, pixels[s].data() + y * width * 3);
+      }
+      chunks[s].clear();
+      EncodeQoiStrip(pixels[s].data(), rows * width, chunks[s]);
+    }
+    for (size_t s = 0; s < group_size; s++) {
+      os.write(reinterpret_cast<const char *>(chunks[s].data()), chunks[s].size());
+    }
+  }
+
+  const char end_marker[] = {0, 0, 0, 0, 0, 0, 0, 1};
+  os.write(end_marker, sizeof(end_marker));
+  return static_cast<bool>(os);
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+namespace RayTracer2D {
+
+// Fills the 3 * width bytes of 8-bit RGB of row `y`. Called concurrently for
+// different rows.
+using RowReader = std::function<void(size_t y, unsigned char *rgb)>;
+
+// Append the QOI chunks of `count` RGB pixels to `out`, as a strip that can be
+// concatenated after any other: its first pixel is always a QOI_OP_RGB chunk
+// and a pending run is flushed at its end, so it depends on neither the
+// previous pixel nor a run of the strip before it. Index chunks are safe too,
+// the encoder only refers to index slots written within the strip.
+void EncodeQoiStrip(const unsigned char *rgb, size_t count, std::vector<unsigned char> &out);
+
+// Write a QOI image (https://qoiformat.org/qoi-specification.pdf), encoding
+// strips of `strip_rows` rows on `threads` threads (0 for every core). At most
+// one strip per thread is held in memory at a time.
+bool WriteQoi(std::ostream &os, size_t width, size_t height, const RowReader &read_row, size_t threads,
+              size_t strip_rows = 32);
+
+}  // namespace RayTracer2D
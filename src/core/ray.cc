@@ -1,6 +1,11 @@
 #include "core/ray.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
 #include "core/colour.h"
 #include "utils/constants.h"
+#include "utils/fast_math.h"
 
 namespace RayTracer2D {
 
@@ -10,73 +15,52 @@ Point2d Ray::operator()(const double t) const {
   return p_ + d_ * t;
 }
 
+// Walk the segment along its major axis, one pixel per step, like
+// `TileSplatter` does: step k sits at (u1 + k, v1 + k * inc) in (major, minor)
+// pixel coordinates. Steps are clipped to the image first, so segments of a
+// zoomed-in view cost no more than the pixels they cover.
 void Ray::Render(const Image &image, const Point2d &p) const {
-  double x1, y1, x2, y2, xt, yt;
-  int xx, yy;
-  double dx, dy;
-  double inc;
-
-  if (p_.x < W_LEFT - kEpsilon || p_.x > W_RIGHT + kEpsilon || p_.y < W_TOP - kEpsilon || p_.y > W_BOTTOM + kEpsilon ||
-      p.x < W_LEFT - kEpsilon || p.x > W_RIGHT + kEpsilon || p.y < W_TOP - kEpsilon || p.y > W_BOTTOM + kEpsilon) {
+  const auto &world = image.world().Grown(kEpsilon, kEpsilon);
+  if (!world.Contains(p_) || !world.Contains(p)) {
     std::cerr << "Ray::Render() - at least one endpoint is outside the image bounds, somewhere there's an error...\n";
     std::cerr << "p1=(" << p_.x << "," << p_.y << ")\n";
     std::cerr << "p2=(" << p.x << "," << p.y << ")\n";
   }
 
-  x1 = p_.x - W_LEFT;
-  y1 = p_.y - W_TOP;
-  x2 = p.x - W_LEFT;
-  y2 = p.y - W_TOP;
-
-  x1 = x1 / (W_RIGHT - W_LEFT);
-  y1 = y1 / (W_BOTTOM - W_TOP);
-  x2 = x2 / (W_RIGHT - W_LEFT);
-  y2 = y2 / (W_BOTTOM - W_TOP);
-
-  x1 = x1 * (image.sx_ - 1);
-  y1 = y1 * (image.sy_ - 1);
-  x2 = x2 * (image.sx_ - 1);
-  y2 = y2 * (image.sy_ - 1);
-
-  dx = x2 - x1;
-  dy = y2 - y1;
-
-  if (std::abs(dx) >= std::abs(dy)) {
-    if (x2 < x1) {
-      std::swap(x1, x2);
-      std::swap(y1, y2);
-    }
-
-    yt = y1;
-    inc = (y2 - y1) / std::abs(x2 - x1);
-    for (double xt = x1; xt <= x2; xt += 1) {
-      xx = static_cast<int>(std::round(xt));
-      yy = static_cast<int>(std::round(yt));
-      if (xx >= 0 && xx < image.sx_ && yy >= 0 && yy < image.sy_) {
-        image.data_[(xx + (yy * image.sx_)) * 3 + 0] += colour_.R_;
-        image.data_[(xx + (yy * image.sx_)) * 3 + 1] += colour_.G_;
-        image.data_[(xx + (yy * image.sx_)) * 3 + 2] += colour_.B_;
-      }
-      yt += inc;
-    }
-  } else {
-    if (y2 < y1) {
-      std::swap(x1, x2);
-      std::swap(y1, y2);
-    }
+  const auto a = image.ToPixel(p_);
+  const auto b = image.ToPixel(p);
+  const auto x_major = std::abs(b.x - a.x) >= std::abs(b.y - a.y);
+  auto u1 = x_major ? a.x : a.y;
+  auto v1 = x_major ? a.y : a.x;
+  auto u2 = x_major ? b.x : b.y;
+  auto v2 = x_major ? b.y : b.x;
+  if (u2 < u1) {
+    std::swap(u1, u2);
+    std::swap(v1, v2);
+  }
+  const double size_u = x_major ? image.sx_ : image.sy_;
+  const double size_v = x_major ? image.sy_ : image.sx_;
+  const auto inc = u2 > u1 ? (v2 - v1) / (u2 - u1) : 0;
 
-    xt = x1;
-    inc = (x2 - x1) / std::abs(y2 - y1);
-    for (double yt = y1; yt <= y2; yt += 1) {
-      xx = static_cast<int>(std::round(xt));
-      yy = static_cast<int>(std::round(yt));
-      if (xx >= 0 && xx < image.sx_ && yy >= 0 && yy < image.sy_) {
-        image.data_[(xx + (yy * image.sx_)) * 3 + 0] += colour_.R_;
-        image.data_[(xx + (yy * image.sx_)) * 3 + 1] += colour_.G_;
-        image.data_[(xx + (yy * image.sx_)) * 3 + 2] += colour_.B_;
-      }
-      xt += inc;
+  // Conservative by one step on each side, the exact test is per pixel.
+  auto k0 = std::max(0.0, std::ceil(-0.5 - u1) - 1);
+  auto k1 = std::min(std::floor(u2 - u1), std::ceil(size_u - 0.5 - u1));
+  if (inc != 0) {
+    auto ka = (-0.5 - v1) / inc;
+    auto kb = (size_v - 0.5 - v1) / inc;
+    k0 = std::max(k0, std::floor(std::min(ka, kb)) - 1);
+    k1 = std::min(k1, std::ceil(std::max(ka, kb)) + 1);
+  }
+  if (!(k0 <= k1)) {
+    return;
+  }
+  for (auto k = static_cast<int64_t>(k0); k <= static_cast<int64_t>(k1); k++) {
+    auto u = FastRound(u1 + k);
+    auto v = FastRound(v1 + k * inc);
+    if (u < 0 || u >= size_u || v < 0 || v >= size_v) {
+      continue;
     }
+    image.Accumulate(x_major ? u : v, x_major ? v : u, colour_);
   }
 }
 
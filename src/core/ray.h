@@ -4,9 +4,12 @@
 #include "core/colour.h"
 #include "core/image.h"
 #include "core/point.h"
+#include "core/sampler.h"
 
 namespace RayTracer2D {
 
+class Shape;
+
 class Ray {
  public:
   explicit Ray(const Point2d &p, const Point2d &d, const Colour &colour);
@@ -20,6 +23,12 @@ class Ray {
 
   void Render(const Image &image, const Point2d &p) const;
 
+  // Random number `k` (< kDimensionsPerBounce) for the interaction at the end
+  // of this ray.
+  double Sample(const uint32_t k) const {
+    return sample_.Get(kEmissionDimensions + bounce_ * kDimensionsPerBounce + k);
+  }
+
  public:
   // Position and direction vector of the ray.
   Point2d p_;
@@ -37,6 +46,15 @@ class Ray {
   // convenient substitute for wavelength) values in [0 1] go from deep red to
   // purple.
   double H;
+
+  // Where the random numbers of this path come from, and how many bounces
+  // precede this ray.
+  SampleStream sample_;
+  uint32_t bounce_{0};
+
+  // Shape this ray leaves from, if any. Its intersection tests ignore the
+  // point the ray starts on.
+  const Shape *origin_{nullptr};
 };
 
 }  // namespace RayTracer2D
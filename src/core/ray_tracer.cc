@@ -1,173 +1,377 @@
 #include "core/ray_tracer.h"
+#include <algorithm>
 #include <cstdio>
 #include <memory>
+#include <type_traits>
+#include <variant>
+#include "core/beam_tracer.h"
 #include "core/colour.h"
+#include "core/metropolis.h"
 #include "core/point.h"
+#include "core/preview.h"
+#include "core/stage_profiler.h"
+#include "core/tile_splatter.h"
 #include "light/laser_light.h"
+#include "light/point_light.h"
 #include "material/reflective.h"
+#include "material/refractive.h"
 #include "material/scattering.h"
+#include "medium/homogeneous_medium.h"
+#include "shapes/circle.h"
+#include "shapes/wall.h"
 #include "utils/constants.h"
+#include "utils/fast_math.h"
+#include "utils/hash.h"
+#include "utils/parallel.h"
+#include "utils/random.h"
 
 namespace RayTracer2D {
 
-static auto parse_args(int argc, char *argv[]) -> Options;
+RayTracer::RayTracer(const Options &option)
+    : RayTracer(option, MakeDefaultScene(option),
+                std::make_unique<LaserLight>(Point2d(0, 0), Point2d(1, 0.8).Normalize(), Colour(1, 1, 1))) {}
+
+RayTracer::RayTracer(const Options &option, std::unique_ptr<Scene> scene, std::unique_ptr<Light> light)
+    : option_(option),
+      scene_(std::move(scene)),
+      image_(option),
+      sampler_(MakeSampler(option.sampler_, option.seed_)),
+      light_(std::move(light)),
+      light_ref_(MakeLightRef(light_.get())) {}
+
+auto RayTracer::MakeDefaultScene(const Options &option) -> std::unique_ptr<Scene> {
+  auto scene = std::make_unique<Scene>();
+  auto scattering = scene->AddMaterial<ScatteringMaterial>(option.lambertian_ ? ScatterDistribution::kCosine
+                                                                              : ScatterDistribution::kUniform);
+  auto reflective = scene->AddMaterial<ReflectiveMaterial>();
+  scene->AddCircle(Point2d(1.5, -1.5), 0.55, scattering);
+  scene->AddCircle(Point2d(0.5, -0.5), 0.25, reflective);
+  scene->AddWall(kTopLeft, kTopRight, scattering);
+  scene->AddWall(kTopRight, kBottomRight, scattering);
+  scene->AddWall(kBottomRight, kBottomLeft, scattering);
+  scene->AddWall(kBottomLeft, kTopLeft, scattering);
+  if (option.fog_density_ > 0) {
+    scene->AddMedium(std::make_unique<HomogeneousMedium>(option.fog_density_, Colour(0.95, 0.95, 0.95)));
+  }
+  return scene;
+}
 
-void Main(int argc, char *argv[]) {
-  auto option = parse_args(argc, argv);
-  auto rt = RayTracer(option);
-  for (auto i = 0; i < option.num_rays_; i++) {
-    if (option.num_rays_ > 10) {
-      if (i % (option.num_rays_ / 10) == 0) {
-        fprintf(stderr, "Progress=%f\n", (double)i / (double)(option.num_rays_));
-      }
+void RayTracer::Render() {
+  Render(option_.threads_);
+}
+
+auto RayTracer::SelectPath(const size_t threads) const -> RenderPath {
+  if (option_.beams_ && detectors_ == nullptr && BeamTracer::Supports(*this)) {
+    return RenderPath::kBeams;
+  }
+  if (option_.metropolis_ && detectors_ == nullptr && MetropolisRenderer::Supports(*this)) {
+    return RenderPath::kMetropolis;
+  }
+  if (option_.detectors_only_) {
+    // Nothing is written to the image, threads can share it.
+    return RenderPath::kShared;
+  }
+  if (option_.deferred_ || !option_.preview_path_.empty()) {
+    // Previews read the accumulator while rays are traced, which is only safe
+    // when tracing does not write to it.
+    return RenderPath::kDeferred;
+  }
+  if (ResolveThreads(threads) == 1) {
+    return RenderPath::kDirect;
+  }
+  return image_.IsConcurrent() ? RenderPath::kShared : RenderPath::kDeferred;
+}
+
+void RayTracer::Render(const size_t threads) {
+  const auto resolved = ResolveThreads(threads);
+  const auto path = SelectPath(resolved);
+  if (path == RenderPath::kBeams) {
+    RenderBeams(resolved);
+    return;
+  }
+  if (path == RenderPath::kMetropolis) {
+    MetropolisRenderer(*this).Render(resolved);
+    return;
+  }
+  if (!option_.trace_path_.empty()) {
+    recorder_ = std::make_unique<PathRecorder>(option_, resolved);
+  }
+  if (detectors_ != nullptr) {
+    detectors_->Reserve(resolved);
+  }
+  if (path == RenderPath::kDirect) {
+    RenderDirect();
+  } else if (path == RenderPath::kShared) {
+    RenderShared(resolved);
+  } else {
+    RenderDeferred(resolved);
+  }
+  recorder_.reset();
+}
+
+void RayTracer::RenderBeams(const size_t threads) {
+  auto beams = BeamTracer(*this);
+  beams.Render(threads);
+  if (option_.progress_) {
+    fprintf(stderr, "Beam tracing: %zu wedges, %zu rays handed over\n", beams.wedges(), beams.rays());
+  }
+}
+
+void RayTracer::ReportProgress(const size_t done) const {
+  if (option_.progress_ && option_.num_rays_ > 10) {
+    fprintf(stderr, "Progress=%f\n", (double)done / (double)(option_.num_rays_));
+  }
+}
+
+void RayTracer::RenderDirect() {
+  for (auto i = 0; i < option_.num_rays_; i++) {
+    if (option_.progress_ && option_.num_rays_ > 10 && i % (option_.num_rays_ / 10) == 0) {
+      ReportProgress(i);
     }
 #ifdef Debug
     fprintf(stderr, "Propagating ray %d of %d\n", i, num_rays);
     fprintf(stderr, "Ray is at (%f,%f), direction (%f, %f)\n", ray.p.px, ray.p.py, ray.d.px, ray.d.py);
 #endif
-    auto ray = rt.light_->GetLightRay();
-    rt.PropagateRay(ray, option.depth_);
+    auto ray = EmitRay(i);
+    PropagateRay(ray, option_.depth_);
+    if ((i + 1) % option_.batch_size_ == 0) {
+      image_.Trim();
+    }
   }
+}
 
-  rt.image_.AdjustGamma();
-  for (const auto &shape : rt.scene_) {
-    shape->Render(rt.image_);
+// Every thread rasterizes its rays straight into the image, which must accept
+// concurrent adds.
+void RayTracer::RenderShared(const size_t threads) {
+  const auto report_every = std::max<size_t>(option_.num_rays_ / 10, 1);
+  for (size_t begin = 0; begin < option_.num_rays_; begin += option_.batch_size_) {
+    const auto end = std::min(begin + option_.batch_size_, option_.num_rays_);
+    if (begin / report_every != end / report_every || begin == 0) {
+      ReportProgress(begin);
+    }
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 64)
+    for (size_t i = begin; i < end; i++) {
+      PropagateRay(EmitRay(i), option_.depth_);
+    }
   }
-  rt.image_.WriteToPPM();
 }
 
-RayTracer::RayTracer(const Options &option)
-    : image_(option),
-      light_(std::make_unique<LaserLight>(Point2d(0, 0), Point2d(1, 0.8).Normalize(), Colour(1, 1, 1))) {
-  scene_.AddCircle(Point2d(1.5, -1.5), 0.55, std::make_unique<ScatteringMaterial>());
-  scene_.AddCircle(Point2d(0.5, -0.5), 0.25, std::make_unique<ReflectiveMaterial>());
-  scene_.AddWall(kTopLeft, kTopRight, std::make_unique<ScatteringMaterial>());
-  scene_.AddWall(kTopRight, kBottomRight, std::make_unique<ScatteringMaterial>());
-  scene_.AddWall(kBottomRight, kBottomLeft, std::make_unique<ScatteringMaterial>());
-  scene_.AddWall(kBottomLeft, kTopLeft, std::make_unique<ScatteringMaterial>());
-}
-
-auto parse_args(int argc, char *argv[]) -> Options {
-  if (argc < 5) {
-    fprintf(stderr, "USAGE: light2D  sx   sy   num_samples   max_depth\n");
-    fprintf(stderr, "  sx, sy - image resolution in pixels (in [256 4096])\n");
-    fprintf(stderr, "  num_samples - Number of light rays to propagate  (in [1 10,000,000])\n");
-    fprintf(stderr, "  max_depth - Maximum recursion depth (in [1 25])\n");
-    exit(1);
-  }
-  auto sx = atoi(argv[1]);
-  auto sy = atoi(argv[2]);
-  auto num_rays = atoi(argv[3]);
-  auto max_depth = atoi(argv[4]);
-  if (sx < 256 || sy < 256 || sx > 4096 || sy > 4096 || num_rays < 1 || num_rays > 10000000 || max_depth < 1 ||
-      max_depth > 25) {
-    fprintf(stderr, "USAGE: light2D  sx   sy   num_samples   max_depth\n");
-    fprintf(stderr, "  sx, sy - image resolution in pixels (in [256 4096])\n");
-    fprintf(stderr, "  num_samples - Number of light rays to propagate  (in [1 10,000,000])\n");
-    fprintf(stderr, "  max_depth - Maximum recursion depth (in [1 25])\n");
-    exit(1);
-  }
-  fprintf(stderr, "Working with:\n");
-  fprintf(stderr, "Image size (%d, %d)\n", sx, sy);
-  fprintf(stderr, "Number of samples: %d\n", num_rays);
-  fprintf(stderr, "Max. recursion depth: %d\n", max_depth);
-
-  return Options(sx, sy, num_rays, max_depth);
-}
-
-void RayTracer::PropagateRay(Ray ray, const size_t depth) {
-  for (auto i = 0; i < depth; i++) {
-    auto result = scene_.FindFirstHit(ray);
+// Rays are traced in batches. While tracing, every thread only appends to its
+// own segment buffer; the image is touched exclusively by the splatter, which
+// hands each screen tile to a single thread.
+void RayTracer::RenderDeferred(const size_t threads) {
+  auto splatter = TileSplatter(image_, option_.tile_size_, threads);
+  auto buffers = std::vector<SegmentBuffer>(threads);
+  const auto report_every = std::max<size_t>(option_.num_rays_ / 10, 1);
+  auto preview = option_.preview_path_.empty() ? nullptr : std::make_unique<PreviewWriter>(image_, option_);
+
+  for (size_t begin = 0; begin < option_.num_rays_; begin += option_.batch_size_) {
+    const auto end = std::min(begin + option_.batch_size_, option_.num_rays_);
+    if (begin / report_every != end / report_every || begin == 0) {
+      ReportProgress(begin);
+    }
+    if (preview) {
+      preview->MaybeSnapshot(begin);
+    }
+
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 64)
+    for (size_t i = begin; i < end; i++) {
+      PropagateRay(EmitRay(i), option_.depth_, &buffers[ThreadIndex()]);
+    }
+    if (preview) {
+      preview->WaitForSnapshot();
+    }
+    splatter.Splat(buffers);
+    image_.Trim();
+  }
+}
+
+Ray RayTracer::EmitRay(const size_t index) {
+  return EmitRay(SampleStream(sampler_.get(), index));
+}
+
+Ray RayTracer::EmitRay(const SampleStream &sample) {
+  StageScope scope(Stage::kEmission);
+  auto ray = kClosedSetDispatch ? std::visit([&](auto *light) { return light->GetLightRay(sample); }, light_ref_)
+                                : light_->GetLightRay(sample);
+  ray.sample_ = sample;
+  return ray;
+}
+
+void RayTracer::PropagateRay(Ray ray, const size_t depth, SegmentBuffer *segments) {
+  if (kernel_ != nullptr && recorder_ == nullptr && touches_ == nullptr && detectors_ == nullptr &&
+      !scene_->HasMedia()) {
+    kernel_(*this, ray, depth, segments);
+  } else if constexpr (kClosedSetDispatch) {
+    PropagateRayClosed(ray, depth, segments);
+  } else {
+    PropagateRayDynamic(ray, depth, segments);
+  }
+}
+
+// The origin of the outgoing ray moves off the surface, to the side it leaves
+// towards, by an offset that grows with the magnitude of the coordinates.
+void RayTracer::ContinuePath(const Ray &incoming, Ray &outgoing, const Shape *shape, const Point2d &n) {
+  outgoing.sample_ = incoming.sample_;
+  outgoing.bounce_ = incoming.bounce_ + 1;
+  outgoing.origin_ = shape;
+  const auto scale = std::max({1.0, std::abs(outgoing.p_.x), std::abs(outgoing.p_.y)});
+  const auto offset = Dot(outgoing.d_, n) >= 0 ? kSpawnOffset * scale : -kSpawnOffset * scale;
+  outgoing.p_ = outgoing.p_ + n * offset;
+}
+
+// Rasterize the segment from the ray origin to `p` now, or defer it. Segments
+// missing a cropped view are dropped right away, all of them without image.
+void RayTracer::EmitSegment(const Ray &ray, const Point2d &p, SegmentBuffer *segments) const {
+  if (touches_ != nullptr) {
+    touches_->MarkSegment(ray.sample_.index_, ray.p_, p);
+  }
+  if (option_.detectors_only_) {
+    return;
+  }
+  if (image_.cropped() && !image_.bounds().Overlaps(ray.p_, p)) {
+    return;
+  }
+  if (segments != nullptr) {
+    segments->push_back(Segment{ray.p_, p, ray.colour_});
+  } else {
+    StageScope scope(Stage::kSplatting);
+    ray.Render(image_, p);
+  }
+}
+
+void RayTracer::RecordVertex(const Ray &ray, const Point2d &p, const double t, const Shape *shape,
+                             const uint32_t depth) {
+  if (touches_ != nullptr && shape != nullptr) {
+    touches_->MarkShape(ray.sample_.index_, shape->id());
+  }
+  if (recorder_ == nullptr || !recorder_->Sampled(ray.sample_.index_)) {
+    return;
+  }
+  auto record = PathRecord{};
+  record.path_ = ray.sample_.index_;
+  record.x_ = static_cast<float>(p.x);
+  record.y_ = static_cast<float>(p.y);
+  record.t_ = static_cast<float>(t);
+  record.r_ = static_cast<float>(ray.colour_.R_);
+  record.g_ = static_cast<float>(ray.colour_.G_);
+  record.b_ = static_cast<float>(ray.colour_.B_);
+  record.shape_ = shape == nullptr ? kNoId : shape->id();
+  record.material_ = shape == nullptr ? kNoId : shape->material_id();
+  record.depth_ = static_cast<uint16_t>(depth);
+  recorder_->Record(record);
+}
+
+// Media need an unbounded number of random numbers per bounce, drawn from a
+// stream keyed by the path and the bounce so renders stay reproducible.
+bool RayTracer::ScatterInMedia(Ray &ray, const double t_hit, SegmentBuffer *segments) {
+  auto random = HashStream(HashCombine(HashCombine(option_.seed_, ray.sample_.index_), ray.bounce_));
+  auto collision = scene_->SampleMedia(ray, t_hit, random);
+  if (!collision.has_value()) {
+    return false;
+  }
+  auto [t, medium] = collision.value();
+  auto p = ray(t);
+  RecordVertex(ray, p, t, nullptr, ray.bounce_ + 1);
+  EmitSegment(ray, p, segments);
+
+  double s, c;
+  FastSinCos(2 * M_PI * random.Next(), &s, &c);
+  auto next = ray;
+  next.p_ = p;
+  next.d_ = Point2d(c, s);
+  next.colour_ = ray.colour_ * medium->albedo();
+  next.bounce_ = ray.bounce_ + 1;
+  next.origin_ = nullptr;
+  ray = next;
+  return true;
+}
+
+// The scope of the path switches between intersection and shading, the
+// splatting of direct segments nests within the shading.
+void RayTracer::PropagateRayDynamic(Ray ray, const size_t depth, SegmentBuffer *segments) {
+  RecordVertex(ray, ray.p_, 0, nullptr, 0);
+  StageScope scope(Stage::kIntersection);
+  for (size_t i = 0; i < depth; i++) {
+    if (i + 1 == depth && CullLastBounce(ray)) {
+      break;
+    }
+    scope.Switch(Stage::kIntersection);
+    auto result = scene_->FindFirstHit(ray);
     if (!result.has_value()) {
-      exit(1);
-      return;
+      CountEscape();
+      break;
     }
     auto [t_hit, hitted_shape] = result.value();
+    scope.Switch(Stage::kShading);
+    if (scene_->HasMedia() && ScatterInMedia(ray, t_hit, segments)) {
+      continue;
+    }
+    CountHit(t_hit);
     auto p = ray(t_hit);
     auto n = hitted_shape->GetNormal(ray, p);
-    ray.Render(image_, p);
-    ray = hitted_shape->Interact(ray, p, n);
+    RecordVertex(ray, p, t_hit, hitted_shape, ray.bounce_ + 1);
+    Detect(ray, hitted_shape, p, n);
+    EmitSegment(ray, p, segments);
+    auto next = hitted_shape->Interact(ray, p, n);
+    ContinuePath(ray, next, hitted_shape, n);
+    ray = next;
   }
 }
 
-void RayTracer::RenderRay(const Ray &ray, const Point2d &p) {
-  double x1, y1, x2, y2, xt, yt;
-  int xx, yy;
-  double dx, dy;
-  double inc;
-
-  if (ray.p_.x < W_LEFT - kEpsilon || ray.p_.x > W_RIGHT + kEpsilon || ray.p_.y < W_TOP - kEpsilon ||
-      ray.p_.y > W_BOTTOM + kEpsilon || p.x < W_LEFT - kEpsilon || p.x > W_RIGHT + kEpsilon ||
-      ray.p_.y < W_TOP - kEpsilon || p.y > W_BOTTOM + kEpsilon) {
-    fprintf(stderr, "RenderRay() - at least one endpoint is outside the image bounds, somewhere there's an error...\n");
-    fprintf(stderr, "p1=(%f,%f)\n", ray.p_.x, ray.p_.y);
-    fprintf(stderr, "p2=(%f,%f)\n", p.x, p.y);
-  }
-
-  x1 = ray.p_.x - W_LEFT;
-  y1 = ray.p_.y - W_TOP;
-  x2 = p.x - W_LEFT;
-  y2 = p.y - W_TOP;
-
-  x1 = x1 / (W_RIGHT - W_LEFT);
-  y1 = y1 / (W_BOTTOM - W_TOP);
-  x2 = x2 / (W_RIGHT - W_LEFT);
-  y2 = y2 / (W_BOTTOM - W_TOP);
-
-  x1 = x1 * (image_.sx_ - 1);
-  y1 = y1 * (image_.sy_ - 1);
-  x2 = x2 * (image_.sx_ - 1);
-  y2 = y2 * (image_.sy_ - 1);
-
-  dx = x2 - x1;
-  dy = y2 - y1;
-
-  if (abs(dx) >= abs(dy)) {
-    if (x2 < x1) {
-      xt = x1;
-      yt = y1;
-      x1 = x2;
-      y1 = y2;
-      x2 = xt;
-      y2 = yt;
-    }
-
-    yt = y1;
-    inc = (y2 - y1) / abs(x2 - x1);
-    for (double xt = x1; xt <= x2; xt += 1) {
-      xx = (int)round(xt);
-      yy = (int)round(yt);
-      if (xx >= 0 && xx < image_.sx_ && yy >= 0 && yy < image_.sy_) {
-        image_.data_[(xx + (yy * image_.sx_)) * 3 + 0] += ray.colour_.R_;
-        image_.data_[(xx + (yy * image_.sx_)) * 3 + 1] += ray.colour_.G_;
-        image_.data_[(xx + (yy * image_.sx_)) * 3 + 2] += ray.colour_.B_;
-      }
-      yt += inc;
+// One bounce, instantiated for every (shape, material) combination of the
+// closed set so that normal computation and shading are direct calls.
+template <typename ShapeT, typename MaterialT>
+static Ray Bounce(ShapeT *shape, MaterialT *material, const RayTracer &rt, const Ray &ray, const double t_hit,
+                  SegmentBuffer *segments) {
+  auto p = ray(t_hit);
+  auto n = shape->GetNormal(ray, p);
+  rt.Detect(ray, shape, p, n);
+  rt.EmitSegment(ray, p, segments);
+  auto next = [&] {
+    if constexpr (std::is_same_v<ShapeT, Shape>) {
+      // Open extension: the shape may override how it hands off to its material.
+      return shape->Interact(ray, p, n);
+    } else {
+      return material->Interact(ray, p, n);
     }
+  }();
+  RayTracer::ContinuePath(ray, next, shape, n);
+  return next;
+}
 
-  } else {
-    if (y2 < y1) {
-      xt = x1;
-      yt = y1;
-      x1 = x2;
-      y1 = y2;
-      x2 = xt;
-      y2 = yt;
-    }
-
-    xt = x1;
-    inc = (x2 - x1) / abs(y2 - y1);
-    for (double yt = y1; yt <= y2; yt += 1) {
-      xx = (int)round(xt);
-      yy = (int)round(yt);
-      if (xx >= 0 && xx < image_.sx_ && yy >= 0 && yy < image_.sy_) {
-        image_.data_[(xx + (yy * image_.sx_)) * 3 + 0] += ray.colour_.R_;
-        image_.data_[(xx + (yy * image_.sx_)) * 3 + 1] += ray.colour_.G_;
-        image_.data_[(xx + (yy * image_.sx_)) * 3 + 2] += ray.colour_.B_;
-      }
-      xt += inc;
+void RayTracer::PropagateRayClosed(Ray ray, const size_t depth, SegmentBuffer *segments) {
+  RecordVertex(ray, ray.p_, 0, nullptr, 0);
+  StageScope scope(Stage::kIntersection);
+  for (size_t i = 0; i < depth; i++) {
+    if (i + 1 == depth && CullLastBounce(ray)) {
+      break;
+    }
+    scope.Switch(Stage::kIntersection);
+    auto result = scene_->FindFirstHitClosed(ray);
+    if (!result.has_value()) {
+      CountEscape();
+      break;
     }
+    const auto &hit = result.value();
+    scope.Switch(Stage::kShading);
+    if (scene_->HasMedia() && ScatterInMedia(ray, hit.t_, segments)) {
+      continue;
+    }
+    CountHit(hit.t_);
+    if (recorder_ != nullptr || touches_ != nullptr) {
+      RecordVertex(ray, ray(hit.t_), hit.t_, std::visit([](auto *shape) -> const Shape * { return shape; }, hit.shape_),
+                   ray.bounce_ + 1);
+    }
+    auto next = std::visit(
+        [&](auto *shape, auto *material) { return Bounce(shape, material, *this, ray, hit.t_, segments); },
+        hit.shape_, hit.material_);
+    ray = next;
   }
 }
 
+void RayTracer::RenderRay(const Ray &ray, const Point2d &p) {
+  ray.Render(image_, p);
+}
+
 }  // namespace RayTracer2D
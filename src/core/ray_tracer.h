@@ -1,27 +1,171 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include "core/detector.h"
+#include "core/dispatch.h"
 #include "core/image.h"
 #include "core/options.h"
+#include "core/path_recorder.h"
+#include "core/path_touches.h"
 #include "core/point.h"
 #include "core/ray.h"
+#include "core/sampler.h"
 #include "core/scene.h"
+#include "core/segment.h"
 #include "core/light.h"
+#include "utils/constants.h"
+#include "utils/macros.h"
 
 namespace RayTracer2D {
 
-void Main(int argc, char *argv[]);
+// How `RayTracer::Render` traces: wedges with a `BeamTracer`, chains with a
+// `MetropolisRenderer`, or rays rasterized serially, straight into a shared
+// image, or into segment buffers splatted tile by tile.
+enum class RenderPath { kBeams, kMetropolis, kDirect, kShared, kDeferred };
 
+// Renders a scene lit by one light source into an HDR image.
+//
+//   auto scene = std::make_unique<Scene>();
+//   auto white = scene->AddMaterial<ScatteringMaterial>();
+//   scene->AddWall(kTopLeft, kTopRight, white);
+//   ...
+//   auto rt = RayTracer(option, std::move(scene), std::make_unique<PointLight>(Point2d(0, 0), Colour(1, 1, 1)));
+//   rt.Render(threads);
+//   rt.image_.ForEachView([](const ImageView &view) { ... });
+//
+// The scene must enclose the light so that every ray hits a shape.
 class RayTracer {
  public:
+  // The built-in demo scene, lit by a laser.
   RayTracer(const Options &option);
-  void PropagateRay(Ray ray, const size_t depth);
+  explicit RayTracer(const Options &option, std::unique_ptr<Scene> scene, std::unique_ptr<Light> light);
+
+  DISALLOW_COPY_AND_MOVE(RayTracer);
+
+  static auto MakeDefaultScene(const Options &option) -> std::unique_ptr<Scene>;
+
+  // Trace `num_rays_` rays into the image, light wedges with `beams_` or
+  // Metropolis chains with `metropolis_`, or only into the detectors with
+  // `detectors_only_`, on `threads` threads (0 for every core). The first form
+  // runs on the `threads_` of the options.
+  // Only one thread stays on the serial direct path. Unless deferred splatting
+  // is requested, more threads rasterize straight into images that accept
+  // concurrent adds (fixed-point accumulators), and splat deferred otherwise.
+  void Render();
+  void Render(const size_t threads);
+  // The path `Render(threads)` takes with the current options and image.
+  auto SelectPath(const size_t threads) const -> RenderPath;
+
+  // Emit the `index`-th ray of the render from the light source and propagate
+  // it, using the dispatch mode selected at build time. Segments are
+  // rasterized into the image right away, or appended to `segments` when one
+  // is given.
+  Ray EmitRay(const size_t index);
+  // Emit the ray of a path drawn from `sample`.
+  Ray EmitRay(const SampleStream &sample);
+  void PropagateRay(Ray ray, const size_t depth, SegmentBuffer *segments = nullptr);
+
+  // Both propagation strategies are always compiled so they can be compared
+  // against each other in a single binary.
+  void PropagateRayDynamic(Ray ray, const size_t depth, SegmentBuffer *segments = nullptr);
+  void PropagateRayClosed(Ray ray, const size_t depth, SegmentBuffer *segments = nullptr);
+
   void RenderRay(const Ray &ray, const Point2d &p);
 
+  // Replace the generic propagation by a kernel specialized for this scene,
+  // see `rt2d_add_scene_executable`. Paths recorded for tracing and scenes
+  // with media still take the generic loop.
+  using PathKernel = void (*)(RayTracer &rt, Ray ray, const size_t depth, SegmentBuffer *segments);
+  void SetPathKernel(const PathKernel kernel) {
+    kernel_ = kernel;
+  }
+  bool HasPathKernel() const {
+    return kernel_ != nullptr;
+  }
+
+  // Mark the shapes and cells every traced path touches into `touches`,
+  // indexed by path, or stop with null.
+  void SetPathTouches(PathTouches *touches) {
+    touches_ = touches;
+  }
+
+  // Fill the histograms of `detectors` with the hits of every traced path,
+  // or stop with null. Beams and Metropolis chains only render images, and
+  // are not used meanwhile.
+  void SetDetectors(DetectorSet *detectors) {
+    detectors_ = detectors;
+  }
+
+  // Steps of a bounce, shared by the propagation loops and the kernels.
+  // Rasterize the segment from the ray origin to `p` now, or defer it.
+  void EmitSegment(const Ray &ray, const Point2d &p, SegmentBuffer *segments) const;
+  // The ray leaving an interaction with `shape` continues the path of the
+  // incoming one.
+  static void ContinuePath(const Ray &incoming, Ray &outgoing, const Shape *shape, const Point2d &n);
+  // Whether the last segment of a path, which only ever runs along the ray,
+  // would miss a cropped view: then there is no need to intersect it at all.
+  // Recorded paths and paths feeding detectors are always traced in full.
+  bool CullLastBounce(const Ray &ray) const {
+    return image_.cropped() && recorder_ == nullptr && detectors_ == nullptr &&
+           !image_.bounds().Reaches(ray.p_, ray.d_);
+  }
+  void Detect(const Ray &ray, const Shape *shape, const Point2d &p, const Point2d &n) const {
+    if (detectors_ != nullptr) {
+      detectors_->Record(ray, shape, p, n);
+    }
+  }
+  void CountHit(const double t) {
+    if (t < kNearZeroHit) {
+      near_zero_hits_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Hits closer than `kNearZeroHit` to their ray origin since construction:
+  // bounces wasted on the surface the ray was spawned from.
+  uint64_t near_zero_hits() const {
+    return near_zero_hits_.load(std::memory_order_relaxed);
+  }
+  void CountEscape() {
+    escaped_rays_.fetch_add(1, std::memory_order_relaxed);
+  }
+  // Paths ended early since construction because their ray hit nothing, as
+  // in scenes that are not closed.
+  uint64_t escaped_rays() const {
+    return escaped_rays_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void RenderBeams(const size_t threads);
+  void RenderDirect();
+  void RenderShared(const size_t threads);
+  void RenderDeferred(const size_t threads);
+  void ReportProgress(const size_t done) const;
+  // Record a vertex of the path of `ray` if the path is sampled for tracing:
+  // its origin for the emission (depth 0), else the hit `p` at `t`, on `shape`
+  // or in a medium when null. Hit shapes are also marked as touched.
+  void RecordVertex(const Ray &ray, const Point2d &p, const double t, const Shape *shape, const uint32_t depth);
+  // Replace `ray` by the ray it scatters into if it collides with a medium
+  // before `t_hit`, after emitting the segment up to the collision.
+  bool ScatterInMedia(Ray &ray, const double t_hit, SegmentBuffer *segments);
+
  public:
-  Scene scene_;
+  Options option_;
+  std::unique_ptr<Scene> scene_;
   Image image_;
+  std::unique_ptr<Sampler> sampler_;
   std::unique_ptr<Light> light_;
+  LightRef light_ref_;
+
+ private:
+  // Set for the duration of a render when `trace_path_` is given.
+  std::unique_ptr<PathRecorder> recorder_;
+  PathKernel kernel_{nullptr};
+  PathTouches *touches_{nullptr};
+  DetectorSet *detectors_{nullptr};
+  std::atomic<uint64_t> near_zero_hits_{0};
+  std::atomic<uint64_t> escaped_rays_{0};
 };
 
 }  // namespace RayTracer2D
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include "core/point.h"
+
+namespace RayTracer2D {
+
+// Axis-aligned region of the world, [left_, right_] x [top_, bottom_].
+struct Rect {
+  double left_, top_, right_, bottom_;
+
+  bool Contains(const Point2d &p) const {
+    return p.x >= left_ && p.x <= right_ && p.y >= top_ && p.y <= bottom_;
+  }
+
+  auto Grown(const double dx, const double dy) const -> Rect {
+    return Rect{left_ - dx, top_ - dy, right_ + dx, bottom_ + dy};
+  }
+
+  auto Moved(const Point2d &offset) const -> Rect {
+    return Rect{left_ + offset.x, top_ + offset.y, right_ + offset.x, bottom_ + offset.y};
+  }
+
+  // Whether some point p + t d with t in [t0, t1] is in the rectangle.
+  bool Clips(const Point2d &p, const Point2d &d, double t0, double t1) const {
+    return Clip(p, d, t0, t1);
+  }
+
+  // Narrow [t0, t1] to the part of p + t d inside the rectangle, false if
+  // there is none.
+  bool Clip(const Point2d &p, const Point2d &d, double &t0, double &t1) const {
+    return ClipAxis(p.x, d.x, left_, right_, t0, t1) && ClipAxis(p.y, d.y, top_, bottom_, t0, t1) && t0 <= t1;
+  }
+
+  bool Overlaps(const Point2d &a, const Point2d &b) const {
+    return Clips(a, b - a, 0, 1);
+  }
+
+  // Whether the half-line from `p` along `d` enters the rectangle.
+  bool Reaches(const Point2d &p, const Point2d &d) const {
+    return Clips(p, d, 0, std::numeric_limits<double>::infinity());
+  }
+
+ private:
+  static bool ClipAxis(const double p, const double d, const double lo, const double hi, double &t0, double &t1) {
+    if (d == 0) {
+      return p >= lo && p <= hi;
+    }
+    auto a = (lo - p) / d;
+    auto b = (hi - p) / d;
+    t0 = std::max(t0, std::min(a, b));
+    t1 = std::min(t1, std::max(a, b));
+    return true;
+  }
+};
+
+}  // namespace RayTracer2D
@@ -0,0 +1,19 @@
+#include "core/sampler.h"
+#include "sampler/random_sampler.h"
+#include "sampler/sobol_sampler.h"
+
+namespace RayTracer2D {
+
+auto MakeSampler(SamplerType type, uint64_t seed) -> std::unique_ptr<Sampler> {
+  switch (type) {
+    case SamplerType::kSobol:
+      return std::make_unique<SobolSampler>(seed, false);
+    case SamplerType::kOwenSobol:
+      return std::make_unique<SobolSampler>(seed, true);
+    case SamplerType::kRandom:
+    default:
+      return std::make_unique<RandomSampler>(seed);
+  }
+}
+
+}  // namespace RayTracer2D
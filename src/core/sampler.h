@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include "utils/random.h"
+
+namespace RayTracer2D {
+
+enum class SamplerType {
+  // Independent uniform numbers, i.e. plain Monte Carlo.
+  kRandom,
+  // Sobol (0,2)-sequence padded over pairs of dimensions, random digit scrambled.
+  kSobol,
+  // Same as kSobol with Owen (nested uniform) scrambling.
+  kOwenSobol,
+};
+
+// Deterministic source of sample points. `Get(index, dimension)` is the
+// `dimension`-th coordinate of the `index`-th point of a sequence in [0, 1).
+// Implementations are stateless, so one sampler is shared by every thread.
+class Sampler {
+ public:
+  virtual ~Sampler() = default;
+
+  virtual double Get(const uint64_t index, const uint32_t dimension) const = 0;
+};
+
+auto MakeSampler(SamplerType type, uint64_t seed) -> std::unique_ptr<Sampler>;
+
+// The random numbers of one light path: point `index_` of `sampler_`. A
+// default constructed stream has no sampler and draws from the thread-local
+// engine instead.
+class SampleStream {
+ public:
+  SampleStream() = default;
+  explicit SampleStream(const Sampler *sampler, uint64_t index) : sampler_(sampler), index_(index) {}
+
+  double Get(const uint32_t dimension) const {
+    if (sampler_ == nullptr) {
+      return std::uniform_real_distribution<double>(0, 1)(ThreadLocalGenerator());
+    }
+    return sampler_->Get(index_, dimension);
+  }
+
+  const Sampler *sampler_{nullptr};
+  uint64_t index_{0};
+};
+
+// Dimensions 0..kEmissionDimensions-1 of a path are used by the light source,
+// then every bounce owns the next kDimensionsPerBounce dimensions.
+constexpr uint32_t kEmissionDimensions = 2;
+constexpr uint32_t kDimensionsPerBounce = 2;
+
+}  // namespace RayTracer2D
@@ -1,19 +1,129 @@
 #include "core/scene.h"
+#include <algorithm>
 #include <limits>
 #include <memory>
 #include <optional>
+#include <type_traits>
 #include <utility>
 #include "shapes/circle.h"
 #include "shapes/wall.h"
 
 namespace RayTracer2D {
 
-void Scene::AddWall(const Point2d &begin, const Point2d &end, MaterialPtr material) {
-  shapes_.push_back(std::make_unique<Wall>(begin, end, std::move(material)));
+auto Scene::AddWall(const Point2d &begin, const Point2d &end, const MaterialId material) -> uint32_t {
+  auto wall = arena_.Create<Wall>(begin, end, materials_.Get(material));
+  wall->material_id_ = material;
+  walls_.push_back({wall, materials_.GetRef(material)});
+  return Register(wall);
 }
 
-void Scene::AddCircle(const Point2d &center, const double r, MaterialPtr material) {
-  shapes_.push_back(std::make_unique<Circle>(center, r, std::move(material)));
+auto Scene::AddCircle(const Point2d &center, const double r, const MaterialId material) -> uint32_t {
+  auto circle = arena_.Create<Circle>(center, r, materials_.Get(material));
+  circle->material_id_ = material;
+  circles_.push_back({circle, materials_.GetRef(material)});
+  return Register(circle);
+}
+
+auto Scene::AddWall(const Point2d &begin, const Point2d &end, MaterialPtr material) -> uint32_t {
+  return AddWall(begin, end, AddMaterial(std::move(material)));
+}
+
+auto Scene::AddCircle(const Point2d &center, const double r, MaterialPtr material) -> uint32_t {
+  return AddCircle(center, r, AddMaterial(std::move(material)));
+}
+
+auto Scene::AddPrototype() -> Prototype * {
+  prototypes_.push_back(std::make_unique<Prototype>(materials_));
+  return prototypes_.back().get();
+}
+
+// Instances take the open extension path of the closed-set tables.
+auto Scene::AddInstance(const Prototype *prototype, const Affine2d &transform) -> uint32_t {
+  auto instance = arena_.Create<Instance>(*prototype, transform);
+  others_.push_back({instance, MakeMaterialRef(nullptr)});
+  return Register(instance);
+}
+
+auto Scene::AddShape(ShapePtr shape) -> uint32_t {
+  AddClosedEntry(shape.get());
+  auto id = Register(shape.get());
+  adopted_.push_back(std::move(shape));
+  return id;
+}
+
+auto Scene::Register(Shape *shape) -> uint32_t {
+  shape->id_ = static_cast<uint32_t>(shapes_.size());
+  shapes_.push_back(shape);
+  return shape->id_;
+}
+
+void Scene::SetMaterial(const uint32_t shape, const MaterialId material) {
+  auto *s = shapes_[shape];
+  s->material_ = materials_.Get(material);
+  s->material_id_ = material;
+  auto update = [&](auto &table) {
+    for (auto &entry : table) {
+      if (entry.shape_ == s) {
+        entry.material_ = materials_.GetRef(material);
+      }
+    }
+  };
+  update(circles_);
+  update(walls_);
+  update(others_);
+}
+
+bool Scene::MoveShape(const uint32_t shape, const Point2d &offset) {
+  return shapes_[shape]->Translate(offset);
+}
+
+void Scene::AddMedium(MediumPtr medium) {
+  media_.push_back({std::move(medium), nullptr});
+}
+
+void Scene::AddMedium(MediumPtr medium, const uint32_t shape) {
+  media_.push_back({std::move(medium), shapes_[shape]});
+}
+
+// Each medium is tracked on its own and the earliest collision wins, which
+// samples the sum of their extinction coefficients.
+auto Scene::SampleMedia(const Ray &ray, const double t_max, HashStream &random) const
+    -> std::optional<std::pair<double, const Medium *>> {
+  std::optional<std::pair<double, const Medium *>> first;
+  for (const auto &entry : media_) {
+    auto t0 = 0.0, t1 = first.has_value() ? first->first : t_max;
+    if (entry.bound_ != nullptr) {
+      auto span = entry.bound_->Span(ray);
+      if (!span.has_value()) {
+        continue;
+      }
+      t0 = std::max(t0, span->first);
+      t1 = std::min(t1, span->second);
+    }
+    if (t0 >= t1) {
+      continue;
+    }
+    if (auto t = entry.medium_->SampleCollision(ray, t0, t1, random)) {
+      first = std::make_pair(t.value(), entry.medium_.get());
+    }
+  }
+  return first;
+}
+
+void Scene::AddClosedEntry(Shape *shape) {
+  auto material = MakeMaterialRef(shape->material());
+  std::visit(
+      [&](auto *s) {
+        using T = std::remove_pointer_t<decltype(s)>;
+        if constexpr (std::is_same_v<T, Circle>) {
+          circles_.push_back({s, material});
+        } else if constexpr (std::is_same_v<T, Wall>) {
+          walls_.push_back({s, material});
+        } else {
+          others_.push_back({s, material});
+        }
+      },
+      MakeShapeRef(shape));
 }
 
 auto Scene::FindFirstHit(const Ray &ray) const -> std::optional<std::pair<double, Shape *>> {
@@ -24,7 +134,7 @@ auto Scene::FindFirstHit(const Ray &ray) const -> std::optional<std::pair<double
     if (result.has_value()) {
       if (result.value() < t_min) {
         t_min = result.value();
-        hitted_shape = shape.get();
+        hitted_shape = shape;
       }
     }
   }
@@ -36,4 +146,24 @@ auto Scene::FindFirstHit(const Ray &ray) const -> std::optional<std::pair<double
   }
 }
 
+// Scan one monomorphic table. `Entry::shape_` has a final static type for the
+// built-in shapes, so `Intersect` is a direct call the compiler may inline.
+template <typename Entry>
+static void IntersectTable(const std::vector<Entry> &table, const Ray &ray, std::optional<ClosedHit> &hit) {
+  for (const auto &entry : table) {
+    auto result = entry.shape_->Intersect(ray);
+    if (result.has_value() && (!hit.has_value() || result.value() < hit->t_)) {
+      hit = ClosedHit{result.value(), entry.shape_, entry.material_};
+    }
+  }
+}
+
+auto Scene::FindFirstHitClosed(const Ray &ray) const -> std::optional<ClosedHit> {
+  std::optional<ClosedHit> hit;
+  IntersectTable(circles_, ray, hit);
+  IntersectTable(walls_, ray, hit);
+  IntersectTable(others_, ray, hit);
+  return hit;
+}
+
 };  // namespace RayTracer2D
@@ -3,13 +3,28 @@
 #include <memory>
 #include <optional>
 #include <vector>
+#include "core/dispatch.h"
 #include "core/material.h"
+#include "core/material_registry.h"
+#include "core/medium.h"
 #include "core/point.h"
 #include "core/shape.h"
+#include "core/transform.h"
+#include "shapes/instance.h"
+#include "utils/arena.h"
 #include "utils/macros.h"
 
 namespace RayTracer2D {
 
+// Result of the closed-set intersection query. The shape and its material are
+// already resolved to their concrete types, so shading can be dispatched
+// without going through the virtual interfaces.
+struct ClosedHit {
+  double t_;
+  ShapeRef shape_;
+  MaterialRef material_;
+};
+
 class Scene {
  public:
   Scene() = default;
@@ -18,9 +33,68 @@ class Scene {
   // the misuse of this data class.
   DISALLOW_COPY_AND_MOVE(Scene);
 
-  void AddWall(const Point2d &begin, const Point2d &end, MaterialPtr material);
-  void AddCircle(const Point2d &center, const double r, MaterialPtr material);
+  // Define a material once; shapes then reference it by id.
+  template <typename T, typename... Args>
+  auto AddMaterial(Args &&...args) -> MaterialId {
+    return materials_.Emplace<T>(std::forward<Args>(args)...);
+  }
+  auto AddMaterial(MaterialPtr material) -> MaterialId {
+    return materials_.Add(std::move(material));
+  }
+
+  // Shapes are numbered in insertion order, the adders return the id.
+  auto AddWall(const Point2d &begin, const Point2d &end, const MaterialId material) -> uint32_t;
+  auto AddCircle(const Point2d &center, const double r, const MaterialId material) -> uint32_t;
+
+  // Shorthands registering a material used by this shape only.
+  auto AddWall(const Point2d &begin, const Point2d &end, MaterialPtr material) -> uint32_t;
+  auto AddCircle(const Point2d &center, const double r, MaterialPtr material) -> uint32_t;
+
+  // Repeated groups: build a prototype once, with materials of this scene,
+  // then place it any number of times. Each placement is a single shape, an
+  // `Instance`, and returns its id.
+  auto AddPrototype() -> Prototype *;
+  auto AddInstance(const Prototype *prototype, const Affine2d &transform) -> uint32_t;
+
+  // Edits between two renders: give shape `shape` another material of the
+  // scene, or move it by `offset` (false if the shape can not move).
+  void SetMaterial(const uint32_t shape, const MaterialId material);
+  bool MoveShape(const uint32_t shape, const Point2d &offset);
+
+  // Add a user defined shape. It is intersected through the virtual interface
+  // even in closed-set builds.
+  auto AddShape(ShapePtr shape) -> uint32_t;
+
+  // Fill the world, or the inside of the closed shape `shape`, with a
+  // participating medium. Overlapping media add up.
+  void AddMedium(MediumPtr medium);
+  void AddMedium(MediumPtr medium, const uint32_t shape);
+
+  bool HasMedia() const {
+    return !media_.empty();
+  }
+
+  // First real collision of `ray` with a medium before `t_max`, if any.
+  auto SampleMedia(const Ray &ray, const double t_max, HashStream &random) const
+      -> std::optional<std::pair<double, const Medium *>>;
+
+  size_t size() const {
+    return shapes_.size();
+  }
+
+  Shape *shape(const uint32_t id) const {
+    return shapes_[id];
+  }
+
+  Material *material(const MaterialId id) const {
+    return materials_.Get(id);
+  }
+  size_t num_materials() const {
+    return materials_.size();
+  }
+
   auto FindFirstHit(const Ray &ray) const -> std::optional<std::pair<double, Shape *>>;
+  auto FindFirstHitClosed(const Ray &ray) const -> std::optional<ClosedHit>;
 
   auto begin() {
     return shapes_.begin();
@@ -44,7 +118,37 @@ class Scene {
   }
 
  private:
-  std::vector<std::unique_ptr<Shape>> shapes_;
+  template <typename T>
+  struct ClosedEntry {
+    T *shape_;
+    MaterialRef material_;
+  };
+
+  void AddClosedEntry(Shape *shape);
+  // Append to `shapes_`, the index in there is the shape id.
+  auto Register(Shape *shape) -> uint32_t;
+
+  MaterialRegistry materials_;
+
+  // Built-in shapes are allocated back to back in `arena_`; user defined
+  // shapes are adopted into `adopted_`. `shapes_` lists both in insertion order.
+  Arena arena_;
+  std::vector<ShapePtr> adopted_;
+  std::vector<Shape *> shapes_;
+  std::vector<std::unique_ptr<Prototype>> prototypes_;
+
+  // Tag-indexed tables over the same shapes as `shapes_`, one per closed-set
+  // alternative, so the intersection loops are monomorphic.
+  std::vector<ClosedEntry<Circle>> circles_;
+  std::vector<ClosedEntry<Wall>> walls_;
+  std::vector<ClosedEntry<Shape>> others_;
+
+  // Media and the shape bounding each of them, null for the world.
+  struct MediumEntry {
+    MediumPtr medium_;
+    const Shape *bound_;
+  };
+  std::vector<MediumEntry> media_;
 };
 
 };  // namespace RayTracer2D
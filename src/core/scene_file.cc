@@ -0,0 +1,212 @@
+#include "core/scene_file.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "light/laser_light.h"
+#include "light/point_light.h"
+#include "light/ray_file_light.h"
+#include "material/reflective.h"
+#include "material/refractive.h"
+
+namespace RayTracer2D {
+
+bool ParseSceneDescription(std::istream &is, const std::string &name, SceneDescription &description) {
+  description = SceneDescription{};
+  bool has_light = false;
+  auto find_material = [&](const std::string &material, uint32_t &id) {
+    for (id = 0; id < description.materials_.size(); id++) {
+      if (description.materials_[id].name_ == material) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  std::string line;
+  for (size_t number = 1; std::getline(is, line); number++) {
+    auto error = [&](const char *message) {
+      fprintf(stderr, "%s:%zu: %s\n", name.c_str(), number, message);
+      return false;
+    };
+    line = line.substr(0, line.find('#'));
+    std::istringstream ls(line);
+    std::string keyword;
+    if (!(ls >> keyword)) {
+      continue;
+    }
+
+    if (keyword == "material") {
+      auto spec = SceneDescription::MaterialSpec{"", SceneDescription::MaterialKind::kScattering,
+                                                 ScatterDistribution::kUniform, 1, Colour(1, 1, 1)};
+      std::string kind;
+      uint32_t existing;
+      if (!(ls >> spec.name_ >> kind)) {
+        return error("expected: material NAME KIND");
+      }
+      if (find_material(spec.name_, existing)) {
+        return error("material defined twice");
+      }
+      if (kind == "scattering") {
+        std::string distribution = "uniform";
+        ls >> distribution;
+        if (distribution != "uniform" && distribution != "cosine") {
+          return error("scattering distribution must be uniform or cosine");
+        }
+        spec.distribution_ = distribution == "cosine" ? ScatterDistribution::kCosine : ScatterDistribution::kUniform;
+        auto &albedo = spec.albedo_;
+        if (ls >> albedo.R_) {
+          if (!(ls >> albedo.G_ >> albedo.B_) || !albedo.ValidateColour()) {
+            return error("expected: material NAME scattering DISTRIBUTION R G B");
+          }
+        }
+      } else if (kind == "reflective") {
+        spec.kind_ = SceneDescription::MaterialKind::kReflective;
+      } else if (kind == "refractive") {
+        spec.kind_ = SceneDescription::MaterialKind::kRefractive;
+        if (!(ls >> spec.index_)) {
+          return error("expected: material NAME refractive INDEX");
+        }
+      } else {
+        return error("unknown material kind");
+      }
+      description.materials_.push_back(spec);
+    } else if (keyword == "circle" || keyword == "wall") {
+      auto spec = SceneDescription::ShapeSpec{};
+      std::string material;
+      if (keyword == "circle") {
+        spec.kind_ = SceneDescription::ShapeKind::kCircle;
+        if (!(ls >> spec.x0_ >> spec.y0_ >> spec.r_ >> material) || spec.r_ <= 0) {
+          return error("expected: circle CX CY R MATERIAL");
+        }
+      } else {
+        spec.kind_ = SceneDescription::ShapeKind::kWall;
+        if (!(ls >> spec.x0_ >> spec.y0_ >> spec.x1_ >> spec.y1_ >> material)) {
+          return error("expected: wall X1 Y1 X2 Y2 MATERIAL");
+        }
+      }
+      if (!find_material(material, spec.material_)) {
+        return error("unknown material");
+      }
+      description.shapes_.push_back(spec);
+    } else if (keyword == "light") {
+      auto &light = description.light_;
+      std::string kind;
+      ls >> kind;
+      light.laser_ = kind == "laser";
+      if (kind == "point") {
+        ls >> light.x_ >> light.y_ >> light.r_ >> light.g_ >> light.b_;
+      } else if (kind == "laser") {
+        ls >> light.x_ >> light.y_ >> light.dx_ >> light.dy_ >> light.r_ >> light.g_ >> light.b_;
+      } else if (kind == "rayfile") {
+        std::string mode = "random";
+        if (!(ls >> light.ray_file_)) {
+          return error("expected: light rayfile PATH [random|sequential]");
+        }
+        ls >> mode;
+        if (mode != "random" && mode != "sequential") {
+          return error("ray file sampling must be random or sequential");
+        }
+        light.sequential_ = mode == "sequential";
+        ls.clear();
+      } else {
+        return error("light must be point, laser or rayfile");
+      }
+      if (!ls || has_light) {
+        return error(has_light ? "only one light is supported" : "malformed light");
+      }
+      has_light = true;
+    } else if (keyword == "key") {
+      auto spec = SceneDescription::KeySpec{0, false, 0, 0, 0};
+      std::string target;
+      if (!(ls >> spec.time_ >> target >> spec.dx_ >> spec.dy_) || spec.time_ < 0 || spec.time_ > 1) {
+        return error("expected: key TIME SHAPE|light DX DY, TIME in [0, 1]");
+      }
+      spec.light_ = target == "light";
+      if (!spec.light_) {
+        char *end = nullptr;
+        const auto id = strtoul(target.c_str(), &end, 10);
+        if (target.empty() || *end != '\0' || id >= description.shapes_.size()) {
+          return error("key of an unknown shape");
+        }
+        spec.shape_ = static_cast<uint32_t>(id);
+      }
+      description.keys_.push_back(spec);
+    } else if (keyword == "detector") {
+      auto spec = DetectorSpec{};
+      if (!(ls >> spec.shape_ >> spec.position_bins_ >> spec.angle_bins_) || spec.position_bins_ == 0 ||
+          spec.angle_bins_ == 0) {
+        return error("expected: detector SHAPE POSITION_BINS ANGLE_BINS");
+      }
+      if (spec.shape_ >= description.shapes_.size()) {
+        return error("detector of an unknown shape");
+      }
+      for (const auto &detector : description.detectors_) {
+        if (detector.shape_ == spec.shape_) {
+          return error("shape has two detectors");
+        }
+      }
+      description.detectors_.push_back(spec);
+    } else {
+      return error("unknown keyword");
+    }
+    std::string rest;
+    if (ls >> rest) {
+      return error("trailing characters");
+    }
+  }
+  if (!has_light) {
+    fprintf(stderr, "%s: no light\n", name.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool LoadSceneDescription(const std::string &path, SceneDescription &description) {
+  std::ifstream file(path);
+  if (!file) {
+    fprintf(stderr, "can not open scene %s\n", path.c_str());
+    return false;
+  }
+  return ParseSceneDescription(file, path, description);
+}
+
+auto BuildScene(const SceneDescription &description) -> std::unique_ptr<Scene> {
+  auto scene = std::make_unique<Scene>();
+  for (const auto &material : description.materials_) {
+    switch (material.kind_) {
+      case SceneDescription::MaterialKind::kScattering:
+        scene->AddMaterial<ScatteringMaterial>(material.distribution_, material.albedo_);
+        break;
+      case SceneDescription::MaterialKind::kReflective:
+        scene->AddMaterial<ReflectiveMaterial>();
+        break;
+      case SceneDescription::MaterialKind::kRefractive:
+        scene->AddMaterial<RefractiveMaterial>(material.index_);
+        break;
+    }
+  }
+  for (const auto &shape : description.shapes_) {
+    if (shape.kind_ == SceneDescription::ShapeKind::kCircle) {
+      scene->AddCircle(Point2d(shape.x0_, shape.y0_), shape.r_, shape.material_);
+    } else {
+      scene->AddWall(Point2d(shape.x0_, shape.y0_), Point2d(shape.x1_, shape.y1_), shape.material_);
+    }
+  }
+  return scene;
+}
+
+auto BuildLight(const SceneDescription &description) -> std::unique_ptr<Light> {
+  const auto &light = description.light_;
+  if (!light.ray_file_.empty()) {
+    return RayFileLight::Open(light.ray_file_,
+                              light.sequential_ ? RayFileLight::Mode::kSequential : RayFileLight::Mode::kRandom);
+  }
+  const auto colour = Colour(light.r_, light.g_, light.b_);
+  if (light.laser_) {
+    return std::make_unique<LaserLight>(Point2d(light.x_, light.y_), Point2d(light.dx_, light.dy_).Normalize(), colour);
+  }
+  return std::make_unique<PointLight>(Point2d(light.x_, light.y_), colour);
+}
+
+}  // namespace RayTracer2D
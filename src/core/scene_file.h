@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "core/colour.h"
+#include "core/detector.h"
+#include "core/light.h"
+#include "core/scene.h"
+#include "material/scattering.h"
+
+namespace RayTracer2D {
+
+// Text description of a scene and its light, one item per line; '#' starts a
+// comment. Materials are referenced by name, shapes get ids in file order.
+//
+//   material NAME scattering [uniform|cosine [R G B]]
+//   material NAME reflective
+//   material NAME refractive INDEX
+//   circle CX CY R MATERIAL
+//   wall X1 Y1 X2 Y2 MATERIAL
+//   light point X Y R G B
+//   light laser X Y DX DY R G B
+//   light rayfile PATH [random|sequential]
+//   key TIME SHAPE|light DX DY
+//   detector SHAPE POSITION_BINS ANGLE_BINS
+//
+// Keys animate a shape (by id, defined above) or the light: at TIME, in [0, 1]
+// over a sequence, it is offset by (DX, DY) from where it is defined. Offsets
+// are interpolated linearly between keys, see `SequenceRenderer`. Detectors
+// measure the light hitting a shape (by id), see `DetectorSet`.
+//
+// The runtime loader and SceneCodegen both read this format, so a scene
+// renders the same through `BuildScene` and through its generated kernel.
+struct SceneDescription {
+  enum class MaterialKind { kScattering, kReflective, kRefractive };
+  struct MaterialSpec {
+    std::string name_;
+    MaterialKind kind_;
+    ScatterDistribution distribution_;
+    double index_;
+    // Of scattering materials, white unless given.
+    Colour albedo_;
+  };
+
+  enum class ShapeKind { kCircle, kWall };
+  // Circles use (x0_, y0_) as center and r_ as radius, walls run from
+  // (x0_, y0_) to (x1_, y1_).
+  struct ShapeSpec {
+    ShapeKind kind_;
+    double x0_, y0_, x1_, y1_, r_;
+    uint32_t material_;
+  };
+
+  // A light with a `ray_file_` emits measured rays, see `RayFileLight`.
+  struct LightSpec {
+    bool laser_{false};
+    std::string ray_file_;
+    bool sequential_{false};
+    double x_{0}, y_{0}, dx_{1}, dy_{0};
+    double r_{1}, g_{1}, b_{1};
+  };
+
+  struct KeySpec {
+    double time_;
+    bool light_;
+    uint32_t shape_;
+    double dx_, dy_;
+  };
+
+  std::vector<MaterialSpec> materials_;
+  std::vector<ShapeSpec> shapes_;
+  LightSpec light_;
+  std::vector<KeySpec> keys_;
+  std::vector<DetectorSpec> detectors_;
+};
+
+// Parse a description, reporting errors as "name:line: message" on stderr.
+bool ParseSceneDescription(std::istream &is, const std::string &name, SceneDescription &description);
+bool LoadSceneDescription(const std::string &path, SceneDescription &description);
+
+auto BuildScene(const SceneDescription &description) -> std::unique_ptr<Scene>;
+// Null after reporting on stderr if the ray file of the light can not be used.
+auto BuildLight(const SceneDescription &description) -> std::unique_ptr<Light>;
+
+}  // namespace RayTracer2D
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+#include "core/colour.h"
+#include "core/point.h"
+
+namespace RayTracer2D {
+
+// A piece of light path between two consecutive interactions, in world
+// coordinates, waiting to be rasterized.
+struct Segment {
+  Point2d begin_;
+  Point2d end_;
+  Colour colour_;
+};
+
+using SegmentBuffer = std::vector<Segment>;
+
+}  // namespace RayTracer2D
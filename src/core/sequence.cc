@@ -0,0 +1,197 @@
+#include "core/sequence.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include "core/stage_profiler.h"
+
+namespace RayTracer2D {
+
+Point2d Track::At(const double time) const {
+  if (keys_.empty()) {
+    return Point2d(0, 0);
+  }
+  if (time <= keys_.front().time_) {
+    return keys_.front().offset_;
+  }
+  for (size_t i = 1; i < keys_.size(); i++) {
+    const auto &a = keys_[i - 1];
+    const auto &b = keys_[i];
+    if (time < b.time_) {
+      const auto s = (time - a.time_) / (b.time_ - a.time_);
+      return a.offset_ + (b.offset_ - a.offset_) * s;
+    }
+  }
+  return keys_.back().offset_;
+}
+
+auto MakeTracks(const SceneDescription &description) -> std::vector<Track> {
+  std::vector<Track> tracks;
+  for (const auto &key : description.keys_) {
+    auto shape = key.light_ ? std::nullopt : std::optional<uint32_t>(key.shape_);
+    auto track = std::find_if(tracks.begin(), tracks.end(), [&](const Track &t) { return t.shape_ == shape; });
+    if (track == tracks.end()) {
+      tracks.push_back(Track{shape, {}});
+      track = tracks.end() - 1;
+    }
+    track->keys_.push_back(Track::Keyframe{key.time_, Point2d(key.dx_, key.dy_)});
+  }
+  // Keys at the same time keep their file order, the last one wins.
+  for (auto &track : tracks) {
+    std::stable_sort(track.keys_.begin(), track.keys_.end(),
+                     [](const Track::Keyframe &a, const Track::Keyframe &b) { return a.time_ < b.time_; });
+  }
+  return tracks;
+}
+
+SequenceRenderer::SequenceRenderer(RayTracer &rt, std::vector<Track> tracks)
+    : rt_(rt),
+      tracks_(std::move(tracks)),
+      offsets_(tracks_.size(), Point2d(0, 0)),
+      spare_(rt.option_),
+      thread_(&SequenceRenderer::Run, this) {}
+
+SequenceRenderer::~SequenceRenderer() {
+  {
+    std::unique_lock lock(mutex_);
+    cv_.wait(lock, [&] { return state_ == State::kIdle; });
+    state_ = State::kStopping;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+// The pattern comes from the command line: it is parsed here rather than
+// handed to printf as a format string.
+auto SequenceRenderer::FramePath(const std::string &pattern, const size_t frame) -> std::string {
+  const auto percent = pattern.find('%');
+  if (percent != std::string::npos) {
+    auto end = percent + 1;
+    size_t width = 0;
+    if (end < pattern.size() && pattern[end] == '0') {
+      end++;
+      while (end < pattern.size() && pattern[end] >= '0' && pattern[end] <= '9' && width < 100) {
+        width = width * 10 + static_cast<size_t>(pattern[end++] - '0');
+      }
+      if (width == 0 || width > 20) {
+        return "";
+      }
+    }
+    if (end == pattern.size() || pattern[end] != 'd' || pattern.find('%', end) != std::string::npos) {
+      return "";
+    }
+    auto number = std::to_string(frame);
+    if (number.size() < width) {
+      number.insert(0, width - number.size(), '0');
+    }
+    return pattern.substr(0, percent) + number + pattern.substr(end + 1);
+  }
+  char buffer[32];
+  const auto slash = pattern.rfind('/');
+  auto dot = pattern.rfind('.');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    dot = pattern.size();
+  }
+  snprintf(buffer, sizeof(buffer), "_%04zu", frame);
+  return pattern.substr(0, dot) + buffer + pattern.substr(dot);
+}
+
+bool SequenceRenderer::SetTime(const double time) {
+  for (size_t i = 0; i < tracks_.size(); i++) {
+    const auto &track = tracks_[i];
+    const auto offset = track.At(time);
+    if (offset == offsets_[i]) {
+      continue;
+    }
+    const auto delta = offset - offsets_[i];
+    if (track.shape_ ? !rt_.scene_->MoveShape(*track.shape_, delta) : !rt_.light_->Translate(delta)) {
+      if (track.shape_) {
+        fprintf(stderr, "Shape %u can not be animated\n", *track.shape_);
+      } else {
+        fprintf(stderr, "The light can not be animated\n");
+      }
+      return false;
+    }
+    offsets_[i] = offset;
+  }
+  return true;
+}
+
+bool SequenceRenderer::WaitForWriter() {
+  std::unique_lock lock(mutex_);
+  cv_.wait(lock, [&] { return state_ == State::kIdle; });
+  return written_;
+}
+
+void SequenceRenderer::WaitForOutlines() {
+  std::unique_lock lock(mutex_);
+  cv_.wait(lock, [&] { return state_ != State::kOutlining; });
+}
+
+bool SequenceRenderer::Render(const size_t frames, const std::string &pattern) {
+  const auto &option = rt_.option_;
+  if (FramePath(pattern, 0).empty()) {
+    fprintf(stderr, "Invalid frame pattern %s: it may only number frames with one %%d or %%0Nd\n", pattern.c_str());
+    return false;
+  }
+  for (size_t frame = 0; frame < frames; frame++) {
+    const auto time = frames > 1 ? static_cast<double>(frame) / static_cast<double>(frames - 1) : 0.0;
+    if (!SetTime(time)) {
+      WaitForWriter();
+      return false;
+    }
+    if (option.progress_) {
+      fprintf(stderr, "Frame %zu/%zu (t=%g)\n", frame + 1, frames, time);
+    }
+    rt_.Render();
+
+    if (!WaitForWriter()) {
+      return false;
+    }
+    rt_.image_.Swap(spare_);
+    {
+      std::lock_guard lock(mutex_);
+      path_ = FramePath(pattern, frame);
+      state_ = State::kOutlining;
+    }
+    cv_.notify_all();
+    WaitForOutlines();
+  }
+  return WaitForWriter();
+}
+
+void SequenceRenderer::Run() {
+  while (true) {
+    {
+      std::unique_lock lock(mutex_);
+      cv_.wait(lock, [&] { return state_ == State::kOutlining || state_ == State::kStopping; });
+      if (state_ == State::kStopping) {
+        return;
+      }
+    }
+    // Encode on this thread only, the next frame has the cores.
+    bool written;
+    {
+      StageScope scope(Stage::kOutput);
+      spare_.AdjustGamma();
+      for (const auto &shape : *rt_.scene_) {
+        shape->Render(spare_);
+      }
+      {
+        std::lock_guard lock(mutex_);
+        state_ = State::kWriting;
+      }
+      cv_.notify_all();
+      written = spare_.Write(path_, 1);
+    }
+    spare_.Clear();
+    {
+      std::lock_guard lock(mutex_);
+      written_ = written_ && written;
+      state_ = State::kIdle;
+    }
+    cv_.notify_all();
+  }
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "core/image.h"
+#include "core/point.h"
+#include "core/ray_tracer.h"
+#include "core/scene_file.h"
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// Offset of one shape, or of the light when `shape_` is empty, over a
+// sequence: linear between keys sorted by time, constant before the first
+// and after the last one.
+struct Track {
+  struct Keyframe {
+    double time_;
+    Point2d offset_;
+  };
+
+  Point2d At(const double time) const;
+
+  std::optional<uint32_t> shape_;
+  std::vector<Keyframe> keys_;
+};
+
+// One track per animated shape, and one for the light, from the keys of
+// `description`.
+auto MakeTracks(const SceneDescription &description) -> std::vector<Track>;
+
+// Renders an animated scene into numbered images. Between two frames the
+// shapes and the light are moved in place (`Scene::MoveShape`,
+// `Light::Translate`), the scene is never rebuilt. Once a frame is traced,
+// the two images are swapped and a background thread tone maps the frame and
+// draws the shape outlines on it, like a still image gets them; the shapes
+// only move on after that. The thread then writes the frame while the next
+// one is traced, and clears it for reuse, so the accumulator memory is
+// allocated once for the whole sequence.
+//
+//   auto sequence = SequenceRenderer(rt, MakeTracks(description));
+//   sequence.Render(120, "frame_%03d.qoi");
+class SequenceRenderer {
+ public:
+  explicit SequenceRenderer(RayTracer &rt, std::vector<Track> tracks);
+  ~SequenceRenderer();
+
+  DISALLOW_COPY_AND_MOVE(SequenceRenderer);
+
+  // Render `frames` frames, at times spread evenly over [0, 1], into the
+  // files named by `pattern`, see `FramePath`. Return false if a track can
+  // not move its shape or a frame can not be written.
+  bool Render(const size_t frames, const std::string &pattern);
+
+  // `pattern` with the frame number in place of its "%d" or "%0Nd" (zero
+  // padded to N digits, N <= 20), else with "_NNNN" inserted before its
+  // extension. Empty if `pattern` has any other '%' sequence.
+  static auto FramePath(const std::string &pattern, const size_t frame) -> std::string;
+
+ private:
+  enum class State { kIdle, kOutlining, kWriting, kStopping };
+
+  // Move the animated objects to where they are at `time`.
+  bool SetTime(const double time);
+  void Run();
+  // Wait for the frame being written, return false if writing it failed.
+  bool WaitForWriter();
+  // Wait until the writer no longer needs the shapes where they are.
+  void WaitForOutlines();
+
+  RayTracer &rt_;
+  std::vector<Track> tracks_;
+  // Offset applied so far to the object of each track.
+  std::vector<Point2d> offsets_;
+
+  // The frame being written, owned by the writer thread until it is idle.
+  Image spare_;
+  std::string path_;
+  bool written_{true};
+
+  State state_{State::kIdle};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+};
+
+}  // namespace RayTracer2D
@@ -1,15 +1,21 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <utility>
 
 #include "core/image.h"
 #include "core/material.h"
 #include "core/ray.h"
+#include "core/rect.h"
 #include "point.h"
 
 namespace RayTracer2D {
 
+// Id of a shape or material that is not part of a scene.
+constexpr uint32_t kNoId = UINT32_MAX;
+
 class Shape {
  public:
   Shape() = default;
@@ -29,8 +35,52 @@ class Shape {
   // Render the object on canvas (for debug purpose).
   virtual void Render(Image &image) const = 0;
 
+  // Parameter interval along `ray` inside the shape, for closed shapes that
+  // can bound a medium. Open shapes enclose nothing.
+  virtual auto Span(const Ray &) const -> std::optional<std::pair<double, double>> {
+    return std::nullopt;
+  }
+
+  // Bounding box of the shape, unknown by default.
+  virtual auto Bounds() const -> std::optional<Rect> {
+    return std::nullopt;
+  }
+
+  // Move the shape by `offset` between two renders, see `Scene::MoveShape`.
+  // Return false if the shape can not be moved.
+  virtual bool Translate(const Point2d &) {
+    return false;
+  }
+
+  // Position of the point `p` of the surface along it, in [0, 1), for
+  // detectors. Shapes without a parametrization put every point at 0.
+  virtual double SurfaceCoordinate(const Point2d &) const {
+    return 0;
+  }
+
+  Material *material() const {
+    return material_;
+  }
+
+  // Position of the shape in its scene and id of its material in the scene's
+  // registry, assigned by `Scene`.
+  uint32_t id() const {
+    return id_;
+  }
+  uint32_t material_id() const {
+    return material_id_;
+  }
+
  protected:
-  MaterialPtr material_;
+  friend class Scene;
+
+  // Shapes in a scene reference a material owned by the scene's registry.
+  // Standalone shapes built from a `MaterialPtr` keep it in `owned_material_`.
+  Material *material_{nullptr};
+  MaterialPtr owned_material_;
+
+  uint32_t id_{kNoId};
+  uint32_t material_id_{kNoId};
 };
 
 using ShapePtr = std::unique_ptr<Shape>;
@@ -0,0 +1,128 @@
+#include "core/sparse_accumulator.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace RayTracer2D {
+
+SparseAccumulator::SparseAccumulator(size_t sx, size_t sy, size_t tile_size, size_t budget_bytes,
+                                     const std::string &spill_dir)
+    : tile_size_(tile_size),
+      tiles_x_((sx + tile_size - 1) / tile_size),
+      tiles_y_((sy + tile_size - 1) / tile_size),
+      tile_elements_(tile_size * tile_size * 3),
+      tiles_(new Tile[tiles_x_ * tiles_y_]),
+      budget_bytes_(budget_bytes) {
+  if (budget_bytes_ > 0) {
+    OpenBackingFile(spill_dir);
+  }
+}
+
+SparseAccumulator::~SparseAccumulator() {
+  for (size_t i = 0; i < tiles_x_ * tiles_y_; i++) {
+    delete[] tiles_[i].data_.load();
+  }
+  if (spill_map_ != nullptr) {
+    munmap(spill_map_, spill_bytes_);
+  }
+}
+
+// The backing file is unlinked right away: it is sized for the whole image
+// but stays sparse on disk, only the slots of spilled tiles take up space.
+void SparseAccumulator::OpenBackingFile(const std::string &spill_dir) {
+  auto path = spill_dir + "/raytracer2d-spill-XXXXXX";
+  auto fd = mkstemp(path.data());
+  if (fd < 0) {
+    fprintf(stderr, "SparseAccumulator: can not create backing file in %s, memory budget ignored\n",
+            spill_dir.c_str());
+    budget_bytes_ = 0;
+    return;
+  }
+  unlink(path.c_str());
+
+  spill_bytes_ = tiles_x_ * tiles_y_ * tile_elements_ * sizeof(double);
+  void *map = MAP_FAILED;
+  if (ftruncate(fd, static_cast<off_t>(spill_bytes_)) == 0) {
+    map = mmap(nullptr, spill_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "SparseAccumulator: can not map %zu bytes backing file, memory budget ignored\n", spill_bytes_);
+    budget_bytes_ = 0;
+    spill_bytes_ = 0;
+    return;
+  }
+  spill_map_ = static_cast<double *>(map);
+}
+
+auto SparseAccumulator::Materialize(size_t index) -> double * {
+  auto &tile = tiles_[index];
+  auto *fresh = new double[tile_elements_];
+  if (tile.spilled_) {
+    memcpy(fresh, spill_map_ + index * tile_elements_, tile_elements_ * sizeof(double));
+  } else {
+    std::fill(fresh, fresh + tile_elements_, fill_);
+  }
+
+  // Another thread may have materialized the same tile in the meantime; both
+  // copies hold the same content, keep whichever was published first.
+  double *expected = nullptr;
+  if (tile.data_.compare_exchange_strong(expected, fresh, std::memory_order_acq_rel)) {
+    resident_.fetch_add(tile_elements_ * sizeof(double), std::memory_order_relaxed);
+    return fresh;
+  }
+  delete[] fresh;
+  return expected;
+}
+
+auto SparseAccumulator::TileData(size_t index) const -> double * {
+  const auto &tile = tiles_[index];
+  if (auto *data = tile.data_.load(std::memory_order_acquire)) {
+    return data;
+  }
+  if (tile.spilled_) {
+    return spill_map_ + index * tile_elements_;
+  }
+  return nullptr;
+}
+
+auto SparseAccumulator::Peek(size_t x, size_t y) const -> const double * {
+  auto *data = TileData((y / tile_size_) * tiles_x_ + x / tile_size_);
+  if (data == nullptr) {
+    return nullptr;
+  }
+  return data + ((y % tile_size_) * tile_size_ + x % tile_size_) * 3;
+}
+
+void SparseAccumulator::Trim() {
+  const auto tile_bytes = tile_elements_ * sizeof(double);
+  if (budget_bytes_ > 0 && ResidentBytes() > budget_bytes_) {
+    std::vector<size_t> resident;
+    for (size_t i = 0; i < tiles_x_ * tiles_y_; i++) {
+      if (tiles_[i].data_.load(std::memory_order_relaxed) != nullptr) {
+        resident.push_back(i);
+      }
+    }
+    std::sort(resident.begin(), resident.end(),
+              [&](size_t a, size_t b) { return tiles_[a].epoch_.load() < tiles_[b].epoch_.load(); });
+
+    for (auto i : resident) {
+      if (ResidentBytes() <= budget_bytes_) {
+        break;
+      }
+      auto &tile = tiles_[i];
+      auto *data = tile.data_.exchange(nullptr);
+      memcpy(spill_map_ + i * tile_elements_, data, tile_bytes);
+      delete[] data;
+      tile.spilled_ = true;
+      resident_.fetch_sub(tile_bytes, std::memory_order_relaxed);
+    }
+  }
+  epoch_++;
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// HDR accumulator made of fixed-size square tiles that are only allocated when
+// a pixel inside them is first written. Pixels of a tile that was never
+// touched read as the fill value, zero unless set otherwise.
+//
+// When a memory budget is given, `Trim` moves the least recently touched
+// tiles out of memory into an mmap'd backing file; they are transparently
+// brought back on their next write.
+class SparseAccumulator {
+ public:
+  explicit SparseAccumulator(size_t sx, size_t sy, size_t tile_size, size_t budget_bytes,
+                             const std::string &spill_dir);
+  ~SparseAccumulator();
+
+  DISALLOW_COPY_AND_MOVE(SparseAccumulator);
+
+  // Writable RGB cell of pixel (x, y), allocating or reloading its tile on
+  // first touch. Safe to call from several threads at once.
+  double *Pixel(size_t x, size_t y) {
+    const auto index = (y / tile_size_) * tiles_x_ + x / tile_size_;
+    auto &tile = tiles_[index];
+    auto *data = tile.data_.load(std::memory_order_acquire);
+    if (data == nullptr) {
+      data = Materialize(index);
+    }
+    tile.epoch_.store(epoch_, std::memory_order_relaxed);
+    return data + ((y % tile_size_) * tile_size_ + x % tile_size_) * 3;
+  }
+
+  // Read-only RGB cell of pixel (x, y), or nullptr if its tile was never
+  // touched. Must not race with `Trim`.
+  auto Peek(size_t x, size_t y) const -> const double *;
+
+  // Spill the least recently touched tiles to the backing file until the
+  // resident tiles fit in the budget. Must only be called while no other
+  // thread accesses the accumulator.
+  void Trim();
+
+  // Call `f(data, count)` on the `count` doubles of every touched tile, be it
+  // resident or spilled. Must only be called while no other thread accesses
+  // the accumulator.
+  template <typename F>
+  void ForEachTile(F &&f) {
+    for (size_t i = 0; i < tiles_x_ * tiles_y_; i++) {
+      if (auto *data = TileData(i)) {
+        f(data, tile_elements_);
+      }
+    }
+  }
+
+  // Visit every allocated tile as f(x0, y0, data), (x0, y0) being the pixel at
+  // its top left corner.
+  template <typename F>
+  void ForEachTileAt(F &&f) const {
+    for (size_t i = 0; i < tiles_x_ * tiles_y_; i++) {
+      if (const double *data = TileData(i)) {
+        f((i % tiles_x_) * tile_size_, (i / tiles_x_) * tile_size_, data);
+      }
+    }
+  }
+
+  size_t tile_size() const {
+    return tile_size_;
+  }
+
+  // Value every channel of tiles allocated from now on starts at, like the
+  // tone-mapped background once `Image::AdjustGamma` ran.
+  void set_fill(double fill) {
+    fill_ = fill;
+  }
+
+  size_t ResidentBytes() const {
+    return resident_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Tile {
+    std::atomic<double *> data_{nullptr};
+    std::atomic<uint32_t> epoch_{0};
+    bool spilled_{false};
+  };
+
+  auto Materialize(size_t index) -> double *;
+  auto TileData(size_t index) const -> double *;
+  void OpenBackingFile(const std::string &spill_dir);
+
+  size_t tile_size_;
+  size_t tiles_x_, tiles_y_;
+  size_t tile_elements_;
+  std::unique_ptr<Tile[]> tiles_;
+  double fill_{0};
+
+  size_t budget_bytes_;
+  std::atomic<size_t> resident_{0};
+  uint32_t epoch_{1};
+
+  // Backing file holding one slot per tile, mapped for the accumulator lifetime.
+  double *spill_map_{nullptr};
+  size_t spill_bytes_{0};
+};
+
+}  // namespace RayTracer2D
@@ -0,0 +1,396 @@
+#include "core/stage_profiler.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define RT2D_RDPMC
+#endif
+#endif
+
+namespace RayTracer2D {
+
+namespace {
+
+constexpr const char *kStageNames[kNumStages] = {"emission", "intersection", "shading", "splatting", "output"};
+
+enum Counter { kCycles, kInstructions, kCacheMisses, kBranchMisses, kNumCounters };
+constexpr const char *kCounterNames[kNumCounters] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+
+// Time in ns and the counters, either a reading or an accumulated delta.
+struct Sample {
+  uint64_t ns_{0};
+  uint64_t counts_[kNumCounters]{};
+};
+
+struct Totals {
+  uint64_t calls_{0};
+  Sample sample_;
+};
+
+// Deepest nesting of stages on one thread, deeper scopes are ignored.
+constexpr size_t kMaxDepth = 8;
+
+}  // namespace
+
+struct StageProfiler::ThreadCounters {
+  ~ThreadCounters() {
+#ifdef __linux__
+    for (size_t c = 0; c < kNumCounters; c++) {
+      if (pages_[c] != nullptr) {
+        munmap(const_cast<perf_event_mmap_page *>(pages_[c]), page_bytes_);
+      }
+      if (fds_[c] >= 0) {
+        close(fds_[c]);
+      }
+    }
+#endif
+  }
+
+  void Open();
+  Sample Read() const;
+#ifdef __linux__
+  void MapPages();
+  bool ReadUserSpace(Sample &sample) const;
+#endif
+
+  // Descriptor of every counter, -1 when it could not be opened. The first
+  // opened one leads the group, `slots_` gives positions in a group read.
+  int fds_[kNumCounters]{-1, -1, -1, -1};
+  int slots_[kNumCounters]{-1, -1, -1, -1};
+  int leader_{-1};
+  size_t opened_{0};
+#ifdef __linux__
+  // Mapped control page of every opened counter, read with `rdpmc` if all of
+  // them allow it.
+  const volatile perf_event_mmap_page *pages_[kNumCounters]{};
+  size_t page_bytes_{0};
+  bool rdpmc_{false};
+#endif
+
+  Stage stack_[kMaxDepth];
+  size_t depth_{0};
+  // Depth beyond `kMaxDepth`, left without attribution.
+  size_t overflow_{0};
+  Sample last_;
+  Totals totals_[kNumStages];
+};
+
+static std::atomic<bool> active{false};
+static std::atomic<bool> warned{false};
+static std::mutex mutex;
+static std::vector<std::unique_ptr<StageProfiler::ThreadCounters>> threads;
+static thread_local StageProfiler::ThreadCounters *current = nullptr;
+
+void StageProfiler::ThreadCounters::Open() {
+#ifdef __linux__
+  constexpr uint64_t kConfigs[kNumCounters] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                               PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+  int error = 0;
+  for (size_t c = 0; c < kNumCounters; c++) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = kConfigs[c];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // This thread, on any CPU.
+    const auto fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+    if (fd < 0) {
+      error = errno;
+      continue;
+    }
+    fds_[c] = fd;
+    slots_[c] = static_cast<int>(opened_++);
+    if (leader_ < 0) {
+      leader_ = fd;
+    }
+  }
+  MapPages();
+  if (opened_ < kNumCounters && !warned.exchange(true)) {
+    fprintf(stderr, "perf_event_open: %s, %s\n", strerror(error),
+            opened_ == 0 ? "only reporting time" : "some counters are unavailable");
+  }
+#else
+  if (!warned.exchange(true)) {
+    fprintf(stderr, "Hardware counters need Linux, only reporting time\n");
+  }
+#endif
+}
+
+#ifdef __linux__
+// User space reads need the page of every counter, so either all of them are
+// mapped or none.
+void StageProfiler::ThreadCounters::MapPages() {
+#ifdef RT2D_RDPMC
+  if (opened_ == 0) {
+    return;
+  }
+  page_bytes_ = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  bool usable = true;
+  for (size_t c = 0; c < kNumCounters && usable; c++) {
+    if (fds_[c] < 0) {
+      continue;
+    }
+    auto *map = mmap(nullptr, page_bytes_, PROT_READ, MAP_SHARED, fds_[c], 0);
+    if (map == MAP_FAILED) {
+      usable = false;
+      break;
+    }
+    pages_[c] = static_cast<const volatile perf_event_mmap_page *>(map);
+    usable = pages_[c]->cap_user_rdpmc != 0;
+  }
+  rdpmc_ = usable;
+  if (!usable) {
+    for (auto &page : pages_) {
+      if (page != nullptr) {
+        munmap(const_cast<perf_event_mmap_page *>(page), page_bytes_);
+        page = nullptr;
+      }
+    }
+  }
+#endif
+}
+
+// Read every counter with `rdpmc` as the perf_event_open man page describes:
+// the kernel bumps `lock` whenever it updates the page. Fails while the group
+// is not on the PMU (index 0), the caller then falls back to `read`.
+bool StageProfiler::ThreadCounters::ReadUserSpace(Sample &sample) const {
+#ifdef RT2D_RDPMC
+  if (!rdpmc_) {
+    return false;
+  }
+  for (size_t c = 0; c < kNumCounters; c++) {
+    const auto *page = pages_[c];
+    if (page == nullptr) {
+      continue;
+    }
+    uint32_t sequence;
+    uint64_t count;
+    do {
+      sequence = page->lock;
+      std::atomic_signal_fence(std::memory_order_seq_cst);
+      const auto index = page->index;
+      if (index == 0) {
+        return false;
+      }
+      const auto width = page->pmc_width;
+      auto pmc = static_cast<int64_t>(__rdpmc(static_cast<int>(index - 1)));
+      pmc = static_cast<int64_t>(static_cast<uint64_t>(pmc) << (64 - width)) >> (64 - width);
+      count = static_cast<uint64_t>(page->offset + pmc);
+      std::atomic_signal_fence(std::memory_order_seq_cst);
+    } while (page->lock != sequence);
+    sample.counts_[c] = count;
+  }
+  return true;
+#else
+  (void)sample;
+  return false;
+#endif
+}
+#endif
+
+// Counts are scaled up when the kernel multiplexed the group with others and
+// `read` had to be used.
+Sample StageProfiler::ThreadCounters::Read() const {
+  auto sample = Sample{};
+  sample.ns_ = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+#ifdef __linux__
+  if (leader_ < 0 || ReadUserSpace(sample)) {
+    return sample;
+  }
+  // nr, time enabled, time running, then one value per counter.
+  uint64_t buffer[3 + kNumCounters];
+  const auto bytes = read(leader_, buffer, sizeof(buffer));
+  if (bytes < static_cast<ssize_t>((3 + opened_) * sizeof(uint64_t))) {
+    return sample;
+  }
+  const auto scale = buffer[2] > 0 ? static_cast<double>(buffer[1]) / static_cast<double>(buffer[2]) : 1.0;
+  for (size_t c = 0; c < kNumCounters; c++) {
+    if (slots_[c] >= 0) {
+      sample.counts_[c] = static_cast<uint64_t>(static_cast<double>(buffer[3 + slots_[c]]) * scale);
+    }
+  }
+#endif
+  return sample;
+}
+
+static void Attribute(Totals &totals, const Sample &from, const Sample &to) {
+  totals.sample_.ns_ += to.ns_ - from.ns_;
+  for (size_t c = 0; c < kNumCounters; c++) {
+    // Scaled readings of a multiplexed group may step back a little.
+    if (to.counts_[c] > from.counts_[c]) {
+      totals.sample_.counts_[c] += to.counts_[c] - from.counts_[c];
+    }
+  }
+}
+
+void StageProfiler::Enable() {
+  active.store(true, std::memory_order_release);
+}
+
+void StageProfiler::Disable() {
+  active.store(false, std::memory_order_release);
+}
+
+void StageProfiler::Reset() {
+  std::lock_guard lock(mutex);
+  for (auto &thread : threads) {
+    for (auto &totals : thread->totals_) {
+      totals = Totals{};
+    }
+  }
+}
+
+bool StageProfiler::enabled() {
+  return kStageProfiling && active.load(std::memory_order_relaxed);
+}
+
+auto StageProfiler::Enter(const Stage stage) -> ThreadCounters * {
+  if (!enabled()) {
+    return nullptr;
+  }
+  auto *counters = current;
+  if (counters == nullptr) {
+    auto owned = std::make_unique<ThreadCounters>();
+    owned->Open();
+    counters = owned.get();
+    std::lock_guard lock(mutex);
+    threads.push_back(std::move(owned));
+    current = counters;
+  }
+  if (counters->depth_ == kMaxDepth) {
+    counters->overflow_++;
+    return counters;
+  }
+  const auto now = counters->Read();
+  if (counters->depth_ > 0) {
+    Attribute(counters->totals_[static_cast<size_t>(counters->stack_[counters->depth_ - 1])], counters->last_, now);
+  }
+  counters->stack_[counters->depth_++] = stage;
+  counters->totals_[static_cast<size_t>(stage)].calls_++;
+  counters->last_ = now;
+  return counters;
+}
+
+void StageProfiler::Switch(ThreadCounters *counters, const Stage stage) {
+  // An ignored scope stays ignored.
+  if (counters->overflow_ > 0) {
+    return;
+  }
+  auto &top = counters->stack_[counters->depth_ - 1];
+  if (top == stage) {
+    return;
+  }
+  const auto now = counters->Read();
+  Attribute(counters->totals_[static_cast<size_t>(top)], counters->last_, now);
+  top = stage;
+  counters->totals_[static_cast<size_t>(stage)].calls_++;
+  counters->last_ = now;
+}
+
+void StageProfiler::Leave(ThreadCounters *counters) {
+  if (counters->overflow_ > 0) {
+    counters->overflow_--;
+    return;
+  }
+  const auto now = counters->Read();
+  Attribute(counters->totals_[static_cast<size_t>(counters->stack_[--counters->depth_])], counters->last_, now);
+  counters->last_ = now;
+}
+
+// Totals of every stage over all threads, and which counters any thread had.
+static void Sum(Totals (&sum)[kNumStages], bool (&available)[kNumCounters]) {
+  std::lock_guard lock(mutex);
+  for (const auto &thread : threads) {
+    for (size_t c = 0; c < kNumCounters; c++) {
+      available[c] = available[c] || thread->fds_[c] >= 0;
+    }
+    for (size_t s = 0; s < kNumStages; s++) {
+      sum[s].calls_ += thread->totals_[s].calls_;
+      Attribute(sum[s], Sample{}, thread->totals_[s].sample_);
+    }
+  }
+}
+
+void StageProfiler::Print(FILE *out) {
+  Totals sum[kNumStages];
+  bool available[kNumCounters] = {};
+  Sum(sum, available);
+  fprintf(out, "%-13s %12s %10s %16s %16s %6s %14s %14s\n", "Stage", "calls", "thread-s", "cycles", "instructions",
+          "IPC", "cache-misses", "branch-misses");
+  for (size_t s = 0; s < kNumStages; s++) {
+    const auto &totals = sum[s];
+    const auto *counts = totals.sample_.counts_;
+    fprintf(out, "%-13s %12lu %10.3f", kStageNames[s], static_cast<unsigned long>(totals.calls_),
+            totals.sample_.ns_ * 1e-9);
+    for (auto c : {kCycles, kInstructions}) {
+      if (available[c]) {
+        fprintf(out, " %16lu", static_cast<unsigned long>(counts[c]));
+      } else {
+        fprintf(out, " %16s", "-");
+      }
+    }
+    if (available[kCycles] && available[kInstructions] && counts[kCycles] > 0) {
+      fprintf(out, " %6.2f", static_cast<double>(counts[kInstructions]) / counts[kCycles]);
+    } else {
+      fprintf(out, " %6s", "-");
+    }
+    for (auto c : {kCacheMisses, kBranchMisses}) {
+      if (available[c]) {
+        fprintf(out, " %14lu", static_cast<unsigned long>(counts[c]));
+      } else {
+        fprintf(out, " %14s", "-");
+      }
+    }
+    fprintf(out, "\n");
+  }
+}
+
+bool StageProfiler::WriteJson(const std::string &path) {
+  Totals sum[kNumStages];
+  bool available[kNumCounters] = {};
+  Sum(sum, available);
+  auto *file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    fprintf(stderr, "can not write profile %s\n", path.c_str());
+    return false;
+  }
+  size_t num_threads;
+  {
+    std::lock_guard lock(mutex);
+    num_threads = threads.size();
+  }
+  fprintf(file, "{\n  \"threads\": %zu,\n  \"stages\": [\n", num_threads);
+  for (size_t s = 0; s < kNumStages; s++) {
+    const auto &totals = sum[s];
+    fprintf(file, "    {\"stage\": \"%s\", \"calls\": %lu, \"seconds\": %.9f", kStageNames[s],
+            static_cast<unsigned long>(totals.calls_), totals.sample_.ns_ * 1e-9);
+    // Unavailable counters are null rather than 0.
+    for (size_t c = 0; c < kNumCounters; c++) {
+      if (available[c]) {
+        fprintf(file, ", \"%s\": %lu", kCounterNames[c], static_cast<unsigned long>(totals.sample_.counts_[c]));
+      } else {
+        fprintf(file, ", \"%s\": null", kCounterNames[c]);
+      }
+    }
+    fprintf(file, "}%s\n", s + 1 < kNumStages ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+  return fclose(file) == 0;
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// Hardware counters per pipeline stage are only compiled in with
+// RT2D_PERF_COUNTERS: without it every `StageScope` is an empty object.
+#ifdef RT2D_PERF_COUNTERS
+constexpr bool kStageProfiling = true;
+#else
+constexpr bool kStageProfiling = false;
+#endif
+
+enum class Stage : uint32_t { kEmission, kIntersection, kShading, kSplatting, kOutput };
+constexpr size_t kNumStages = 5;
+
+// Attributes CPU cycles, instructions, last level cache misses and branch
+// mispredictions, counted by Linux `perf_event_open` in user space, and
+// thread time to the stages of the pipeline.
+//
+// Every thread opens its own counter group the first time it enters a stage,
+// and the report sums all threads. Attribution is exclusive: a stage entered
+// within another one, like splatting within shading, pauses the outer one.
+// Paths switch one scope between intersection and shading at every bounce,
+// so a bounce costs two readings. Where the kernel lets user space read the
+// counters (`cap_user_rdpmc`, x86 only) a reading is a few `rdpmc`
+// instructions, otherwise it is a `read` system call, which stays out of the
+// user space counts but weighs on the time. Where the counters can not be
+// opened (no PMU, perf_event_paranoid, seccomp) only time is reported.
+class StageProfiler {
+ public:
+  // Start or stop attributing. Scopes entered before `Enable` do not count,
+  // scopes entered before `Disable` still do.
+  static void Enable();
+  static void Disable();
+  static bool enabled();
+  // Forget the totals so far. No thread may be in a stage.
+  static void Reset();
+
+  // Per thread bookkeeping, opaque outside of the profiler.
+  struct ThreadCounters;
+  static auto Enter(const Stage stage) -> ThreadCounters *;
+  static void Switch(ThreadCounters *counters, const Stage stage);
+  static void Leave(ThreadCounters *counters);
+
+  // Print a table of the totals to `out` and write them as JSON to `path`.
+  // The profiler must be idle: no thread in a stage.
+  static void Print(FILE *out);
+  static bool WriteJson(const std::string &path);
+};
+
+// Attributes its lifetime on the current thread to `stage`.
+class StageScope {
+ public:
+  explicit StageScope(const Stage stage) {
+    if constexpr (kStageProfiling) {
+      counters_ = StageProfiler::Enter(stage);
+    }
+  }
+  ~StageScope() {
+    if constexpr (kStageProfiling) {
+      if (counters_ != nullptr) {
+        StageProfiler::Leave(counters_);
+      }
+    }
+  }
+
+  // Attribute the rest of the lifetime to `stage`, with a single reading.
+  // Switching to the current stage does nothing. Only the innermost scope of
+  // the thread may switch.
+  void Switch(const Stage stage) {
+    if constexpr (kStageProfiling) {
+      if (counters_ != nullptr) {
+        StageProfiler::Switch(counters_, stage);
+      }
+    }
+  }
+
+  DISALLOW_COPY_AND_MOVE(StageScope);
+
+ private:
+  StageProfiler::ThreadCounters *counters_{nullptr};
+};
+
+}  // namespace RayTracer2D
@@ -0,0 +1,113 @@
+#include "core/sweep.h"
+#include <algorithm>
+#include <cstdio>
+#include "core/stage_profiler.h"
+#include "core/tile_splatter.h"
+#include "utils/parallel.h"
+
+namespace RayTracer2D {
+
+SweepRenderer::SweepRenderer(RayTracer &rt, const MaterialId material, const std::vector<Colour> &albedos)
+    : rt_(rt),
+      material_id_(material),
+      material_(material < rt.scene_->num_materials()
+                    ? dynamic_cast<ScatteringMaterial *>(rt.scene_->material(material))
+                    : nullptr),
+      depth_(std::max<size_t>(rt.option_.depth_, 1)),
+      albedos_(albedos) {
+  if (material_ == nullptr) {
+    return;
+  }
+  images_.reserve(albedos_.size());
+  for (size_t v = 0; v < albedos_.size(); v++) {
+    images_.emplace_back(rt.option_);
+  }
+  // Weight of variant v after k bounces, albedo_v^k.
+  weights_.resize(depth_ * albedos_.size(), Colour(1, 1, 1));
+  for (size_t k = 1; k < depth_; k++) {
+    for (size_t v = 0; v < albedos_.size(); v++) {
+      weights_[k * albedos_.size() + v] = weights_[(k - 1) * albedos_.size() + v] * albedos_[v];
+    }
+  }
+}
+
+bool SweepRenderer::Supports(const RayTracer &rt, const MaterialId material) {
+  return material < rt.scene_->num_materials() &&
+         dynamic_cast<ScatteringMaterial *>(rt.scene_->material(material)) != nullptr && !rt.scene_->HasMedia() &&
+         rt.option_.trace_path_.empty() && !rt.option_.detectors_only_;
+}
+
+// `RayTracer::PropagateRayDynamic` without media, path recording and
+// detectors, counting the bounces off the material.
+void SweepRenderer::Trace(Ray ray, SegmentBuffer *buffers, const size_t stride) {
+  StageScope scope(Stage::kIntersection);
+  size_t k = 0;
+  for (size_t i = 0; i < depth_; i++) {
+    if (i + 1 == depth_ && rt_.CullLastBounce(ray)) {
+      break;
+    }
+    scope.Switch(Stage::kIntersection);
+    auto result = rt_.scene_->FindFirstHit(ray);
+    if (!result.has_value()) {
+      rt_.CountEscape();
+      break;
+    }
+    auto [t_hit, shape] = result.value();
+    scope.Switch(Stage::kShading);
+    rt_.CountHit(t_hit);
+    auto p = ray(t_hit);
+    auto n = shape->GetNormal(ray, p);
+    rt_.EmitSegment(ray, p, &buffers[k * stride]);
+    auto next = shape->Interact(ray, p, n);
+    RayTracer::ContinuePath(ray, next, shape, n);
+    ray = next;
+    if (shape->material_id() == material_id_) {
+      k++;
+    }
+  }
+}
+
+bool SweepRenderer::Render(const size_t threads) {
+  const auto &option = rt_.option_;
+  if (material_ == nullptr) {
+    fprintf(stderr, "Can not sweep material %u: it is not a scattering material\n", material_id_);
+    return false;
+  }
+  if (images_.empty()) {
+    return true;
+  }
+  const auto albedo = material_->albedo();
+  material_->set_albedo(Colour(1, 1, 1));
+
+  // Buffer k * threads + t holds the segments of thread t after k bounces.
+  // A tile owns its pixels in every variant, so the tile that rasterizes a
+  // segment adds it to all of them, weighted by albedo^k.
+  const auto num_variants = images_.size();
+  auto splatter = TileSplatter(images_.front(), option.tile_size_, threads);
+  auto buffers = std::vector<SegmentBuffer>(depth_ * threads);
+  auto deposit = [&](const size_t b, const size_t x, const size_t y, const Colour &colour) {
+    const auto *weights = &weights_[b / threads * num_variants];
+    for (size_t v = 0; v < num_variants; v++) {
+      images_[v].Accumulate(x, y, colour * weights[v]);
+    }
+  };
+  const auto report_every = std::max<size_t>(option.num_rays_ / 10, 1);
+  for (size_t begin = 0; begin < option.num_rays_; begin += option.batch_size_) {
+    const auto end = std::min(begin + option.batch_size_, option.num_rays_);
+    if (option.progress_ && option.num_rays_ > 10 && (begin / report_every != end / report_every || begin == 0)) {
+      fprintf(stderr, "Progress=%f\n", static_cast<double>(begin) / option.num_rays_);
+    }
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 64)
+    for (size_t i = begin; i < end; i++) {
+      Trace(rt_.EmitRay(i), &buffers[ThreadIndex()], threads);
+    }
+    splatter.Splat(buffers, deposit);
+    for (auto &image : images_) {
+      image.Trim();
+    }
+  }
+  material_->set_albedo(albedo);
+  return true;
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "core/colour.h"
+#include "core/image.h"
+#include "core/material_registry.h"
+#include "core/ray.h"
+#include "core/ray_tracer.h"
+#include "core/segment.h"
+#include "material/scattering.h"
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// Renders one image per albedo of a scattering material in a single pass.
+// The albedo only weighs rays, it never steers them, so all variants are lit
+// by the very same paths: differences between them carry no sampling noise.
+//
+// Paths are traced once with the material white. A segment preceded by k
+// bounces off the material is rasterized once, and every pixel it covers
+// goes into every variant weighted by the variant's albedo to the power k.
+// A sweep thus costs one render, plus a few multiply-adds per variant and
+// pixel step, and one accumulator per variant.
+//
+// Like `MetropolisRenderer` this needs a scene without media, and paths are
+// neither recorded nor measured by detectors. Shapes inside prototypes are
+// not counted as bounces off the material and see it white.
+class SweepRenderer {
+ public:
+  explicit SweepRenderer(RayTracer &rt, const MaterialId material, const std::vector<Colour> &albedos);
+
+  DISALLOW_COPY_AND_MOVE(SweepRenderer);
+
+  // Whether `material` of the scene of `rt` is a scattering material and the
+  // scene and options of `rt` allow a sweep.
+  static bool Supports(const RayTracer &rt, const MaterialId material);
+
+  // Trace `num_rays_` rays on `threads` threads into every variant. The
+  // material keeps its own albedo afterwards. Return false, after reporting
+  // it, if the material is not a scattering material.
+  bool Render(const size_t threads);
+
+  size_t size() const {
+    return images_.size();
+  }
+  Image &image(const size_t variant) {
+    return images_[variant];
+  }
+
+ private:
+  // Propagate `ray`, appending every segment preceded by k bounces off the
+  // material to `buffers[k * stride]`, k < `depth_`.
+  void Trace(Ray ray, SegmentBuffer *buffers, const size_t stride);
+
+  RayTracer &rt_;
+  MaterialId material_id_;
+  // Null if the material is not a scattering material.
+  ScatteringMaterial *material_;
+  size_t depth_;
+  std::vector<Colour> albedos_;
+  std::vector<Image> images_;
+  // Albedo of variant v to the power k at k * size() + v.
+  std::vector<Colour> weights_;
+};
+
+}  // namespace RayTracer2D
@@ -0,0 +1,129 @@
+#include "core/tile_splatter.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "utils/fast_math.h"
+
+namespace RayTracer2D {
+
+TileSplatter::TileSplatter(Image &image, size_t tile_size, size_t threads)
+    : image_(image),
+      tile_size_(tile_size),
+      tiles_x_((image.sx_ + tile_size - 1) / tile_size),
+      tiles_y_((image.sy_ + tile_size - 1) / tile_size),
+      threads_(std::max<size_t>(threads, 1)) {
+  assert(tile_size_ > 0);
+}
+
+auto TileSplatter::MakeLine(const Segment &segment) const -> std::optional<Line> {
+  auto a = image_.ToPixel(segment.begin_);
+  auto b = image_.ToPixel(segment.end_);
+
+  auto x_major = std::abs(b.x - a.x) >= std::abs(b.y - a.y);
+  auto u1 = x_major ? a.x : a.y;
+  auto v1 = x_major ? a.y : a.x;
+  auto u2 = x_major ? b.x : b.y;
+  auto v2 = x_major ? b.y : b.x;
+  if (u2 < u1) {
+    std::swap(u1, u2);
+    std::swap(v1, v2);
+  }
+  const double size_u = x_major ? image_.sx_ : image_.sy_;
+  const double size_v = x_major ? image_.sy_ : image_.sx_;
+  auto line = Line{u1, v1, u2 > u1 ? (v2 - v1) / (u2 - u1) : 0, 0, 0, x_major, segment.colour_};
+
+  // Clip the step range to the image. The bounds are conservative by one step
+  // on each side, the exact test is done per pixel when rasterizing.
+  auto k0 = std::max(0.0, std::ceil(-0.5 - u1) - 1);
+  auto k1 = std::min(std::floor(u2 - u1), std::ceil(size_u - 0.5 - u1));
+  if (line.inc_ != 0) {
+    auto ka = (-0.5 - v1) / line.inc_;
+    auto kb = (size_v - 0.5 - v1) / line.inc_;
+    k0 = std::max(k0, std::floor(std::min(ka, kb)) - 1);
+    k1 = std::min(k1, std::ceil(std::max(ka, kb)) + 1);
+  } else if (v1 < -0.5 || v1 >= size_v - 0.5) {
+    return std::nullopt;
+  }
+  if (!(k0 <= k1)) {
+    return std::nullopt;
+  }
+  line.k0_ = static_cast<int64_t>(k0);
+  line.k1_ = static_cast<int64_t>(k1);
+  return line;
+}
+
+template <typename F>
+void TileSplatter::ForEachTile(const Line &line, F &&f) const {
+  const auto t = static_cast<int64_t>(tile_size_);
+  const auto size_u = static_cast<int64_t>(line.x_major_ ? image_.sx_ : image_.sy_);
+  const auto size_v = static_cast<int64_t>(line.x_major_ ? image_.sy_ : image_.sx_);
+  const auto tiles_u = (size_u + t - 1) / t;
+
+  auto first = std::clamp(static_cast<int64_t>(FastRound(line.u1_ + line.k0_)), int64_t{0}, size_u - 1);
+  auto last = std::clamp(static_cast<int64_t>(FastRound(line.u1_ + line.k1_)), int64_t{0}, size_u - 1);
+  for (auto tu = first / t; tu <= std::min(last / t, tiles_u - 1); tu++) {
+    // Steps landing in this column (or row) of tiles, widened by one step.
+    auto ka = std::max(line.k0_, static_cast<int64_t>(std::ceil(tu * t - 0.5 - line.u1_)) - 1);
+    auto kb = std::min(line.k1_, static_cast<int64_t>(std::ceil((tu + 1) * t - 0.5 - line.u1_)));
+    if (ka > kb) {
+      continue;
+    }
+    auto va = static_cast<int64_t>(FastRound(line.v1_ + ka * line.inc_));
+    auto vb = static_cast<int64_t>(FastRound(line.v1_ + kb * line.inc_));
+    auto lo = std::max(std::min(va, vb), int64_t{0});
+    auto hi = std::min(std::max(va, vb), size_v - 1);
+    for (auto tv = lo / t; lo <= hi && tv <= hi / t; tv++) {
+      f(static_cast<size_t>(line.x_major_ ? tv * tiles_x_ + tu : tu * tiles_x_ + tv));
+    }
+  }
+}
+
+// Bins are filled by a counting sort: every buffer counts its lines per tile,
+// a prefix sum turns the counts into offsets, then every buffer writes the
+// indices of its lines into its own slots. No bin is ever reallocated.
+void TileSplatter::BinBuffers(std::vector<SegmentBuffer> &buffers) {
+  const auto num_buffers = buffers.size();
+  const auto num_tiles = tiles_x_ * tiles_y_;
+  lines_.resize(num_buffers);
+  offsets_.assign(num_tiles * num_buffers + 1, 0);
+
+#pragma omp parallel num_threads(threads_)
+  {
+    StageScope scope(Stage::kSplatting);
+#pragma omp for schedule(dynamic)
+    for (size_t b = 0; b < num_buffers; b++) {
+      auto &lines = lines_[b];
+      lines.clear();
+      for (const auto &segment : buffers[b]) {
+        if (auto line = MakeLine(segment)) {
+          lines.push_back(line.value());
+        }
+      }
+      buffers[b].clear();
+      for (const auto &line : lines) {
+        ForEachTile(line, [&](const size_t tile) { offsets_[tile * num_buffers + b + 1]++; });
+      }
+    }
+
+#pragma omp single
+    {
+      for (size_t i = 1; i < offsets_.size(); i++) {
+        offsets_[i] += offsets_[i - 1];
+      }
+      entries_.resize(offsets_.back());
+      cursors_.assign(offsets_.begin(), offsets_.end() - 1);
+    }
+
+#pragma omp for schedule(dynamic)
+    for (size_t b = 0; b < num_buffers; b++) {
+      const auto &lines = lines_[b];
+      for (size_t i = 0; i < lines.size(); i++) {
+        ForEachTile(lines[i], [&](const size_t tile) {
+          entries_[cursors_[tile * num_buffers + b]++] = static_cast<uint32_t>(i);
+        });
+      }
+    }
+  }
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include "core/colour.h"
+#include "core/image.h"
+#include "core/segment.h"
+#include "core/stage_profiler.h"
+#include "utils/fast_math.h"
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// Deferred segment rasterizer. Buffered segments are converted to clipped
+// pixel space lines, binned by the screen tiles they cross, and every tile
+// then rasterizes its own lines while its part of the image is hot in cache.
+// A tile is only ever written by the thread rasterizing it, so no atomics or
+// per-thread image copies are needed.
+//
+// The lines are walked exactly like `Ray::Render` walks them, so both paths
+// produce the same pixels.
+class TileSplatter {
+ public:
+  // Binning and rasterization run on `threads` threads.
+  explicit TileSplatter(Image &image, size_t tile_size, size_t threads);
+  DISALLOW_COPY_AND_MOVE(TileSplatter);
+
+  // Rasterize and clear every buffer. Buffers are typically filled by one
+  // tracing thread each; they are binned in parallel.
+  void Splat(std::vector<SegmentBuffer> &buffers) {
+    Splat(buffers, [this](size_t, size_t x, size_t y, const Colour &colour) { image_.Accumulate(x, y, colour); });
+  }
+  // Same, but every pixel step is handed to `deposit(b, x, y, colour)` instead
+  // of being added to the image, `b` being the buffer the segment came from.
+  // The image only gives the geometry. Steps on one tile come from one thread.
+  template <typename Deposit>
+  void Splat(std::vector<SegmentBuffer> &buffers, Deposit &&deposit);
+
+ private:
+  // A segment in pixel space, walked along its major axis: pixel k of the
+  // line sits at (u1_ + k, v1_ + k * inc_) in (major, minor) coordinates.
+  struct Line {
+    double u1_, v1_, inc_;
+    int64_t k0_, k1_;
+    bool x_major_;
+    Colour colour_;
+  };
+
+  auto MakeLine(const Segment &segment) const -> std::optional<Line>;
+  // Call `f(tile)` for every tile `line` may step on.
+  template <typename F>
+  void ForEachTile(const Line &line, F &&f) const;
+  // Convert, clear and bin every buffer.
+  void BinBuffers(std::vector<SegmentBuffer> &buffers);
+  template <typename Deposit>
+  void RasterizeTile(size_t tile, Deposit &deposit) const;
+
+  Image &image_;
+  size_t tile_size_;
+  size_t tiles_x_, tiles_y_;
+  size_t threads_;
+
+  // Per buffer, its lines. The bins of all tiles share `entries_`, indices
+  // of lines ordered by tile then buffer: those of buffer b crossing tile t
+  // sit between `offsets_[t * B + b]` and `offsets_[t * B + b + 1]`, B being
+  // the buffer count. `cursors_` is scratch space for filling the bins.
+  std::vector<std::vector<Line>> lines_;
+  std::vector<uint32_t> entries_;
+  std::vector<size_t> offsets_;
+  std::vector<size_t> cursors_;
+};
+
+template <typename Deposit>
+void TileSplatter::Splat(std::vector<SegmentBuffer> &buffers, Deposit &&deposit) {
+  BinBuffers(buffers);
+#pragma omp parallel num_threads(threads_)
+  {
+    StageScope scope(Stage::kSplatting);
+#pragma omp for schedule(dynamic)
+    for (size_t tile = 0; tile < tiles_x_ * tiles_y_; tile++) {
+      RasterizeTile(tile, deposit);
+    }
+  }
+}
+
+template <typename Deposit>
+void TileSplatter::RasterizeTile(size_t tile, Deposit &deposit) const {
+  const auto t = static_cast<int64_t>(tile_size_);
+  const auto x0 = static_cast<int64_t>(tile % tiles_x_) * t;
+  const auto y0 = static_cast<int64_t>(tile / tiles_x_) * t;
+  const auto x1 = std::min(x0 + t, static_cast<int64_t>(image_.sx_));
+  const auto y1 = std::min(y0 + t, static_cast<int64_t>(image_.sy_));
+
+  const auto num_buffers = lines_.size();
+  for (size_t b = 0; b < num_buffers; b++) {
+    const auto *bin = &offsets_[tile * num_buffers + b];
+    for (auto e = bin[0]; e < bin[1]; e++) {
+      const auto &line = lines_[b][entries_[e]];
+      const auto u0 = line.x_major_ ? x0 : y0;
+      const auto u1 = line.x_major_ ? x1 : y1;
+      const auto v0 = line.x_major_ ? y0 : x0;
+      const auto v1 = line.x_major_ ? y1 : x1;
+      auto ka = std::max(line.k0_, static_cast<int64_t>(std::ceil(u0 - 0.5 - line.u1_)) - 1);
+      auto kb = std::min(line.k1_, static_cast<int64_t>(std::ceil(u1 - 0.5 - line.u1_)));
+      for (auto k = ka; k <= kb; k++) {
+        auto u = static_cast<int64_t>(FastRound(line.u1_ + k));
+        auto v = static_cast<int64_t>(FastRound(line.v1_ + k * line.inc_));
+        if (u < u0 || u >= u1 || v < v0 || v >= v1) {
+          continue;
+        }
+        auto xx = line.x_major_ ? u : v;
+        auto yy = line.x_major_ ? v : u;
+        deposit(b, static_cast<size_t>(xx), static_cast<size_t>(yy), line.colour_);
+      }
+    }
+  }
+}
+
+}  // namespace RayTracer2D
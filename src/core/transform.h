@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cmath>
+#include "core/point.h"
+
+namespace RayTracer2D {
+
+// Affine map of the plane, p -> M p + t with M = [[a_, b_], [c_, d_]].
+struct Affine2d {
+  double a_{1}, b_{0}, c_{0}, d_{1};
+  Point2d t_{0, 0};
+
+  static auto Translation(const Point2d &t) -> Affine2d {
+    return Affine2d{1, 0, 0, 1, t};
+  }
+  // Counterclockwise by `angle` radians around the origin.
+  static auto Rotation(const double angle) -> Affine2d {
+    const auto c = std::cos(angle), s = std::sin(angle);
+    return Affine2d{c, -s, s, c, Point2d(0, 0)};
+  }
+  static auto Scale(const double sx, const double sy) -> Affine2d {
+    return Affine2d{sx, 0, 0, sy, Point2d(0, 0)};
+  }
+
+  Point2d Apply(const Point2d &p) const {
+    return ApplyLinear(p) + t_;
+  }
+  // M v, for directions.
+  Point2d ApplyLinear(const Point2d &v) const {
+    return Point2d(a_ * v.x + b_ * v.y, c_ * v.x + d_ * v.y);
+  }
+  // M^T v: normals of the preimage of this map, by the inverse of the map.
+  Point2d ApplyTransposed(const Point2d &v) const {
+    return Point2d(a_ * v.x + c_ * v.y, b_ * v.x + d_ * v.y);
+  }
+
+  double Determinant() const {
+    return a_ * d_ - b_ * c_;
+  }
+
+  // The map applying `other` first, then this one.
+  auto operator*(const Affine2d &other) const -> Affine2d {
+    return Affine2d{a_ * other.a_ + b_ * other.c_, a_ * other.b_ + b_ * other.d_, c_ * other.a_ + d_ * other.c_,
+                    c_ * other.b_ + d_ * other.d_, Apply(other.t_)};
+  }
+
+  // Only for maps with a non-zero determinant.
+  auto Inverse() const -> Affine2d {
+    const auto r = 1 / Determinant();
+    auto inverse = Affine2d{d_ * r, -b_ * r, -c_ * r, a_ * r, Point2d(0, 0)};
+    inverse.t_ = -1.0 * inverse.ApplyLinear(t_);
+    return inverse;
+  }
+};
+
+}  // namespace RayTracer2D
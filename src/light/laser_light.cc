@@ -9,8 +9,13 @@ LaserLight::LaserLight(const Point2d &p, const Point2d &d, const Colour &colour)
   assert(abs(d_.Length() - 1) < kEpsilon);  // Laser light source need to have unit-lengthed directional vector.
 }
 
-Ray LaserLight::GetLightRay() {
+Ray LaserLight::GetLightRay(const SampleStream &) {
   return Ray(p_, d_, colour_);
 }
 
+bool LaserLight::Translate(const Point2d &offset) {
+  p_ = p_ + offset;
+  return true;
+}
+
 }  // namespace RayTracer2D
@@ -8,11 +8,12 @@
 
 namespace RayTracer2D {
 
-class LaserLight : public Light {
+class LaserLight final : public Light {
  public:
   DISALLOW_COPY_AND_MOVE(LaserLight);
   explicit LaserLight(const Point2d &p, const Point2d &d, const Colour &colour);
-  Ray GetLightRay() override;
+  Ray GetLightRay(const SampleStream &sample) override;
+  bool Translate(const Point2d &offset) override;
 
  private:
   Point2d p_, d_;
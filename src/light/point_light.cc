@@ -1,15 +1,22 @@
-
 #include "light/point_light.h"
+#include <cmath>
+#include "utils/fast_math.h"
 
 namespace RayTracer2D {
 
-PointLight::PointLight(const Point2d &p, const Colour &colour)
-    : p_(p), colour_(colour), gen_(rd_()), distribution_(-1, 1) {}
+PointLight::PointLight(const Point2d &p, const Colour &colour) : p_(p), colour_(colour) {}
+
+// Directions are uniform in angle, so a stratified first dimension gives
+// evenly spread rays.
+Ray PointLight::GetLightRay(const SampleStream &sample) {
+  double s, c;
+  FastSinCos(2 * M_PI * sample.Get(0), &s, &c);
+  return Ray(p_, Point2d(c, s), colour_);
+}
 
-Ray PointLight::GetLightRay() {
-  auto d = Point2d(distribution_(gen_), distribution_(gen_));
-  d.Normalize();
-  return Ray(p_, d, colour_);
+bool PointLight::Translate(const Point2d &offset) {
+  p_ = p_ + offset;
+  return true;
 }
 
 }  // namespace RayTracer2D
@@ -0,0 +1,198 @@
+#include "light/ray_file_light.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+namespace RayTracer2D {
+
+auto RayFileLight::Open(const std::string &path, const Mode mode) -> std::unique_ptr<RayFileLight> {
+  auto fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "RayFileLight: can not open %s\n", path.c_str());
+    return nullptr;
+  }
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(RayFileHeader))) {
+    map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "RayFileLight: can not map %s\n", path.c_str());
+    return nullptr;
+  }
+  const auto bytes = static_cast<size_t>(st.st_size);
+  const auto *header = static_cast<const RayFileHeader *>(map);
+  const auto fits = header->count_ <= (bytes - sizeof(RayFileHeader)) / sizeof(RayFileRecord);
+  if (memcmp(header->magic_, kRayFileMagic, sizeof(kRayFileMagic)) != 0 || header->version_ != kRayFileVersion ||
+      header->record_size_ != sizeof(RayFileRecord) || header->count_ == 0 || !fits ||
+      header->count_ > std::numeric_limits<uint32_t>::max()) {
+    fprintf(stderr, "RayFileLight: %s is not a ray file, or is truncated\n", path.c_str());
+    munmap(map, bytes);
+    return nullptr;
+  }
+  // Sequential replay and the alias table build read ahead, random sampling
+  // then only needs the pages it lands on.
+  madvise(map, bytes, MADV_SEQUENTIAL);
+  auto light = std::unique_ptr<RayFileLight>(new RayFileLight(map, bytes, header->count_, mode));
+  if (mode == Mode::kRandom) {
+    if (!light->BuildAliasTable()) {
+      fprintf(stderr, "RayFileLight: %s emits no power\n", path.c_str());
+      return nullptr;
+    }
+    madvise(map, bytes, MADV_RANDOM);
+  }
+  return light;
+}
+
+bool RayFileLight::Write(const std::string &path, const std::vector<RayFileRecord> &records) {
+  std::ofstream file(path, std::ios::binary);
+  auto header = RayFileHeader{};
+  std::copy(std::begin(kRayFileMagic), std::end(kRayFileMagic), header.magic_);
+  header.version_ = kRayFileVersion;
+  header.record_size_ = sizeof(RayFileRecord);
+  header.count_ = records.size();
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(RayFileRecord));
+  if (!file) {
+    fprintf(stderr, "RayFileLight: can not write %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+RayFileLight::RayFileLight(const void *map, const size_t map_bytes, const size_t count, const Mode mode)
+    : map_(map),
+      map_bytes_(map_bytes),
+      records_(reinterpret_cast<const RayFileRecord *>(static_cast<const char *>(map) + sizeof(RayFileHeader))),
+      count_(count),
+      mode_(mode) {}
+
+RayFileLight::~RayFileLight() {
+  munmap(const_cast<void *>(map_), map_bytes_);
+}
+
+// Vose's alias method: columns of average height, each topped up by at most
+// one other record. The table is built in place, without worklists: a cursor
+// walks the columns below average and another the ones above, which top them
+// up in turn. A column above average that drops below it behind the first
+// cursor is topped up right away. The height of the column topping up is
+// kept in double, the others only need their float.
+bool RayFileLight::BuildAliasTable() {
+  double total = 0;
+  for (size_t i = 0; i < count_; i++) {
+    total += std::max(0.0f, records_[i].power_);
+  }
+  if (!(total > 0)) {
+    return false;
+  }
+  mean_power_ = total / count_;
+  probability_.resize(count_);
+  alias_.resize(count_);
+  for (size_t i = 0; i < count_; i++) {
+    probability_[i] = static_cast<float>(std::max(0.0f, records_[i].power_) / mean_power_);
+    alias_[i] = static_cast<uint32_t>(i);
+  }
+
+  auto next_small = [&](size_t i) {
+    while (i < count_ && !(probability_[i] < 1)) {
+      i++;
+    }
+    return i;
+  };
+  auto next_large = [&](size_t i) {
+    while (i < count_ && probability_[i] < 1) {
+      i++;
+    }
+    return i;
+  };
+  size_t small = next_small(0), large = next_large(0);
+  double height = large < count_ ? probability_[large] : 0;
+  for (auto s = small; s < count_ && large < count_;) {
+    alias_[s] = static_cast<uint32_t>(large);
+    height -= 1 - probability_[s];
+    if (s == small) {
+      small = next_small(small + 1);
+    }
+    s = small;
+    if (height < 1) {
+      const auto drained = large;
+      probability_[drained] = static_cast<float>(std::max(0.0, height));
+      large = next_large(large + 1);
+      height = large < count_ ? probability_[large] : 0;
+      if (drained < small) {
+        s = drained;
+      }
+    }
+  }
+  // Columns nothing was taken from are full, up to rounding.
+  for (size_t i = 0; i < count_; i++) {
+    if (alias_[i] == i) {
+      probability_[i] = 1;
+    }
+  }
+  return true;
+}
+
+Ray RayFileLight::GetLightRay(const SampleStream &sample) {
+  size_t i;
+  double power;
+  if (mode_ == Mode::kSequential) {
+    i = sample.index_ % count_;
+    power = records_[i].power_;
+  } else {
+    i = std::min(static_cast<size_t>(sample.Get(0) * count_), count_ - 1);
+    if (sample.Get(1) >= probability_[i]) {
+      i = alias_[i];
+    }
+    power = mean_power_;
+  }
+  const auto &record = records_[i];
+  auto d = Point2d(record.dx_, record.dy_);
+  d.Normalize();
+  return Ray(Point2d(record.x_, record.y_) + offset_, d, SpectralColour(record.wavelength_) * power);
+}
+
+bool RayFileLight::Translate(const Point2d &offset) {
+  offset_ = offset_ + offset;
+  return true;
+}
+
+// Piecewise linear fit of the visible spectrum (Dan Bruton's), fading out
+// towards both ends.
+auto RayFileLight::SpectralColour(const double nm) -> Colour {
+  if (nm == 0) {
+    return Colour(1, 1, 1);
+  }
+  double r = 0, g = 0, b = 0;
+  if (nm >= 380 && nm < 440) {
+    r = (440 - nm) / 60;
+    b = 1;
+  } else if (nm >= 440 && nm < 490) {
+    g = (nm - 440) / 50;
+    b = 1;
+  } else if (nm >= 490 && nm < 510) {
+    g = 1;
+    b = (510 - nm) / 20;
+  } else if (nm >= 510 && nm < 580) {
+    r = (nm - 510) / 70;
+    g = 1;
+  } else if (nm >= 580 && nm < 645) {
+    r = 1;
+    g = (645 - nm) / 65;
+  } else if (nm >= 645 && nm <= 780) {
+    r = 1;
+  }
+  const auto fade = nm < 420 ? 0.3 + 0.7 * (nm - 380) / 40 : nm > 700 ? 0.3 + 0.7 * (780 - nm) / 80 : 1.0;
+  return Colour(r * fade, g * fade, b * fade);
+}
+
+}  // namespace RayTracer2D
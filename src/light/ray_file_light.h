@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "core/colour.h"
+#include "core/light.h"
+#include "core/point.h"
+#include "core/ray.h"
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// One measured emitter ray: origin, direction (any length), power and
+// wavelength in nanometers, 0 for white light. Stored as is in ray files.
+struct RayFileRecord {
+  float x_, y_;
+  float dx_, dy_;
+  float power_;
+  float wavelength_;
+};
+static_assert(sizeof(RayFileRecord) == 24, "RayFileRecord is a file format");
+
+// Header of a ray file, followed by `count_` records.
+struct RayFileHeader {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t record_size_;
+  uint64_t count_;
+};
+static_assert(sizeof(RayFileHeader) == 24, "RayFileHeader is a file format");
+
+constexpr char kRayFileMagic[8] = {'R', 'T', '2', 'D', 'R', 'A', 'Y', 'S'};
+constexpr uint32_t kRayFileVersion = 1;
+
+// A light emitting the measured rays of a ray file. The file is mapped into
+// memory and rays are read straight from the mapping by every thread, so the
+// pages of the file come and go with the page cache and files larger than
+// memory work.
+//
+// Sequential replay emits record `i % count` as the `i`-th ray, with its own
+// power, and opens in constant time. Random sampling picks records in
+// proportion to their power with an alias table (Vose's method), every ray
+// then carrying the mean power: building the table takes two streaming
+// passes over the file, and the table, 8 bytes per record, is all the memory
+// it needs.
+class RayFileLight final : public Light {
+ public:
+  enum class Mode { kRandom, kSequential };
+
+  // Null after reporting on stderr if the file can not be used.
+  static auto Open(const std::string &path, const Mode mode) -> std::unique_ptr<RayFileLight>;
+  static bool Write(const std::string &path, const std::vector<RayFileRecord> &records);
+
+  ~RayFileLight() override;
+
+  DISALLOW_COPY_AND_MOVE(RayFileLight);
+
+  Ray GetLightRay(const SampleStream &sample) override;
+  bool Translate(const Point2d &offset) override;
+
+  size_t size() const {
+    return count_;
+  }
+
+  // Linear RGB of light of wavelength `nm`, white for 0.
+  static auto SpectralColour(const double nm) -> Colour;
+
+ private:
+  explicit RayFileLight(const void *map, const size_t map_bytes, const size_t count, const Mode mode);
+
+  // Build `probability_` and `alias_`, false if there is no power at all.
+  bool BuildAliasTable();
+
+  const void *map_;
+  size_t map_bytes_;
+  const RayFileRecord *records_;
+  size_t count_;
+  Mode mode_;
+  Point2d offset_{0, 0};
+
+  // Random sampling: column `i` keeps record `i` with `probability_[i]`, and
+  // gives `alias_[i]` otherwise.
+  std::vector<float> probability_;
+  std::vector<uint32_t> alias_;
+  double mean_power_{0};
+};
+
+}  // namespace RayTracer2D
@@ -1,8 +1,438 @@
+// Command line client of the raytracer2d library: renders the default scene,
+// or the one given with --scene, and writes it to output.ppm, or the file
+// given with --output. Built with RT2D_GENERATED_SCENE, it renders the scene
+// it was generated for, see `rt2d_add_scene_executable`.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <utility>
+#include "core/autotune.h"
+#include "core/detector.h"
+#include "core/options.h"
+#include "core/rect.h"
 #include "core/ray_tracer.h"
+#include "core/sampler.h"
+#include "core/scene_file.h"
+#include "core/sequence.h"
+#include "core/stage_profiler.h"
+#include "core/sweep.h"
+#include "utils/parallel.h"
+#include "utils/constants.h"
+#ifdef RT2D_GENERATED_SCENE
+#include "core/generated_scene.h"
+#endif
+
+namespace RayTracer2D {
+
+static void print_usage() {
+  fprintf(stderr, "USAGE: light2D  sx   sy   num_samples   max_depth  [options]\n");
+  fprintf(stderr, "  sx, sy - image resolution in pixels (in [256 4096], [256 65536] with --sparse)\n");
+  fprintf(stderr, "  num_samples - Number of light rays to propagate  (in [1 10,000,000])\n");
+  fprintf(stderr, "  max_depth - Maximum recursion depth (in [1 25])\n");
+  fprintf(stderr, "OPTIONS:\n");
+  fprintf(stderr, "  --scene=FILE - Scene description to render instead of the default scene\n");
+  fprintf(stderr, "  --world=L,T,R,B - World region mapped onto the image (default: -2,-2,2,2)\n");
+  fprintf(stderr, "  --roi=L,T,R,B - Only render this region of the world, at the full image resolution\n");
+  fprintf(stderr, "  --threads=N - Number of worker threads (default: all cores)\n");
+  fprintf(stderr, "  --autotune[=CACHE] - Calibrate threads, batch and tile sizes first, cached in CACHE if given\n");
+  fprintf(stderr, "  --beams - Trace light wedges analytically through mirror walls (point and laser lights)\n");
+  fprintf(stderr, "  --metropolis[=CHAINS] - Explore light paths with Metropolis chains (default: 64)\n");
+  fprintf(stderr, "  --bootstrap=N - Independent paths measuring brightness for --metropolis (default: 65536)\n");
+  fprintf(stderr, "  --deferred - Buffer segments and splat them tile by tile\n");
+  fprintf(stderr, "  --tile=N - Tile edge in pixels for deferred splatting (default: 64)\n");
+  fprintf(stderr, "  --batch=N - Rays traced between two deferred splatting passes (default: 16384)\n");
+  fprintf(stderr, "  --sparse - Allocate the image tile by tile, on first touch\n");
+  fprintf(stderr, "  --memory-budget=MB - Spill cold sparse tiles to disk beyond this budget\n");
+  fprintf(stderr, "  --accumulator=double|fixed32|fixed64 - Accumulator cell format (default: double)\n");
+  fprintf(stderr, "  --fixed-bits=N - Fraction bits of fixed-point cells (default: 12 or 32)\n");
+  fprintf(stderr, "  --spill-dir=DIR - Directory of the spill file (default: /tmp)\n");
+  fprintf(stderr, "  --preview=FILE - Periodically write a PPM preview while rendering (implies --deferred)\n");
+  fprintf(stderr, "  --preview-every=N|Ts - Preview every N rays or every T seconds (default: 10s)\n");
+  fprintf(stderr, "  --preview-size=N - Longer edge of the preview in pixels (default: 1024)\n");
+  fprintf(stderr, "  --output=FILE - Output image, QOI if FILE ends in .qoi, else PPM (default: output.ppm)\n");
+  fprintf(stderr, "  --detectors-only - Only fill the detectors of --scene, without any image\n");
+  fprintf(stderr, "  --detector-output=FILE - Detector histograms (default: detectors.bin)\n");
+  fprintf(stderr, "  --frames=N - Render N frames of the keys of --scene, numbered after --output or its %%0Nd\n");
+  fprintf(stderr, "  --sweep=MATERIAL:A/A/... - One image per albedo A (G or R,G,B) of a scattering material of\n");
+  fprintf(stderr, "      --scene, numbered after --output, all from the same paths\n");
+  fprintf(stderr, "  --sampler=random|sobol|owen - Sample sequence for emission and scattering (default: owen)\n");
+  fprintf(stderr, "  --seed=N - Seed of the sample sequence (default: 0)\n");
+  fprintf(stderr, "  --lambertian - Cosine-weighted instead of uniform scattering\n");
+  fprintf(stderr, "  --fog=SIGMA - Fill the scene with fog of this extinction per unit length\n");
+  fprintf(stderr, "  --profile[=FILE] - Print hardware counters per stage, also as JSON (default: profile.json)\n");
+  fprintf(stderr, "  --trace=FILE - Record light paths into a binary trace, see TraceReplay\n");
+  fprintf(stderr, "  --trace-every=N - Record one path in N (default: 1)\n");
+  fprintf(stderr, "  --trace-limit=MB - Keep only the latest paths beyond this trace size\n");
+}
+
+// "MATERIAL:A/A/...", every albedo A either "G" or "R,G,B" in [0, 1].
+static bool ParseSweep(const std::string &value, Options &option) {
+  const auto colon = value.find(':');
+  if (colon == 0 || colon == std::string::npos) {
+    return false;
+  }
+  option.sweep_material_ = value.substr(0, colon);
+  option.sweep_albedos_.clear();
+  for (auto begin = colon + 1; begin <= value.size();) {
+    const auto end = std::min(value.find('/', begin), value.size());
+    const auto item = value.substr(begin, end - begin);
+    auto albedo = Colour(0, 0, 0);
+    char rest;
+    if (sscanf(item.c_str(), "%lf,%lf,%lf%c", &albedo.R_, &albedo.G_, &albedo.B_, &rest) != 3) {
+      if (sscanf(item.c_str(), "%lf%c", &albedo.R_, &rest) != 1) {
+        return false;
+      }
+      albedo.G_ = albedo.B_ = albedo.R_;
+    }
+    if (!albedo.ValidateColour()) {
+      return false;
+    }
+    option.sweep_albedos_.push_back(albedo);
+    begin = end + 1;
+  }
+  return true;
+}
+
+// "left,top,right,bottom", non-empty.
+static bool ParseRect(const std::string &value, Rect &rect) {
+  return sscanf(value.c_str(), "%lf,%lf,%lf,%lf", &rect.left_, &rect.top_, &rect.right_, &rect.bottom_) == 4 &&
+         rect.left_ < rect.right_ && rect.top_ < rect.bottom_;
+}
 
+static auto parse_args(int argc, char *argv[]) -> Options {
+  if (argc < 5) {
+    print_usage();
+    exit(1);
+  }
+  auto sx = atoi(argv[1]);
+  auto sy = atoi(argv[2]);
+  auto num_rays = atoi(argv[3]);
+  auto max_depth = atoi(argv[4]);
+  auto option = Options(sx, sy, num_rays, max_depth);
+
+  for (auto i = 5; i < argc; i++) {
+    auto arg = std::string(argv[i]);
+    auto eq = arg.find('=');
+    auto key = arg.substr(0, eq);
+    auto value = eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+    Rect rect;
+    if (key == "--deferred") {
+      option.deferred_ = true;
+    } else if (key == "--beams") {
+      option.beams_ = true;
+    } else if (key == "--metropolis") {
+      option.metropolis_ = true;
+      if (atoi(value.c_str()) > 0) {
+        option.metropolis_chains_ = atoi(value.c_str());
+      }
+    } else if (key == "--bootstrap" && atoi(value.c_str()) > 0) {
+      option.metropolis_bootstrap_ = atoi(value.c_str());
+    } else if (key == "--scene" && !value.empty()) {
+      option.scene_path_ = value;
+    } else if ((key == "--world" || key == "--roi") && ParseRect(value, rect)) {
+      if (key == "--world") {
+        option.world_ = rect;
+      } else {
+        option.roi_ = rect;
+      }
+    } else if (key == "--autotune") {
+      option.autotune_ = true;
+      option.autotune_cache_ = value;
+    } else if (key == "--threads" && !value.empty()) {
+      option.threads_ = atoi(value.c_str());
+    } else if (key == "--tile" && atoi(value.c_str()) > 0) {
+      option.tile_size_ = atoi(value.c_str());
+    } else if (key == "--batch" && atoi(value.c_str()) > 0) {
+      option.batch_size_ = atoi(value.c_str());
+    } else if (key == "--sparse") {
+      option.sparse_ = true;
+    } else if (key == "--memory-budget" && atoi(value.c_str()) > 0) {
+      option.memory_budget_mb_ = atoi(value.c_str());
+    } else if (key == "--accumulator" && (value == "double" || value == "fixed32" || value == "fixed64")) {
+      option.accumulator_ = value == "double"    ? AccumulatorFormat::kDouble
+                            : value == "fixed32" ? AccumulatorFormat::kFixed32
+                                                 : AccumulatorFormat::kFixed64;
+    } else if (key == "--fixed-bits" && atoi(value.c_str()) > 0 && atoi(value.c_str()) < 64) {
+      option.fixed_fraction_bits_ = atoi(value.c_str());
+    } else if (key == "--spill-dir" && !value.empty()) {
+      option.spill_dir_ = value;
+    } else if (key == "--preview" && !value.empty()) {
+      option.preview_path_ = value;
+    } else if (key == "--preview-every" && atof(value.c_str()) > 0) {
+      if (value.back() == 's') {
+        option.preview_every_seconds_ = atof(value.c_str());
+      } else {
+        option.preview_every_rays_ = atoi(value.c_str());
+      }
+    } else if (key == "--preview-size" && atoi(value.c_str()) > 0) {
+      option.preview_size_ = atoi(value.c_str());
+    } else if (key == "--detectors-only") {
+      option.detectors_only_ = true;
+    } else if (key == "--detector-output" && !value.empty()) {
+      option.detector_path_ = value;
+    } else if (key == "--frames" && atoi(value.c_str()) > 0) {
+      option.frames_ = atoi(value.c_str());
+    } else if (key == "--sweep" && ParseSweep(value, option)) {
+    } else if (key == "--output" && !value.empty()) {
+      option.output_path_ = value;
+    } else if (key == "--sampler" && (value == "random" || value == "sobol" || value == "owen")) {
+      option.sampler_ = value == "random" ? SamplerType::kRandom
+                        : value == "sobol" ? SamplerType::kSobol
+                                           : SamplerType::kOwenSobol;
+    } else if (key == "--seed" && !value.empty()) {
+      option.seed_ = strtoull(value.c_str(), nullptr, 10);
+    } else if (key == "--lambertian") {
+      option.lambertian_ = true;
+    } else if (key == "--fog" && atof(value.c_str()) > 0) {
+      option.fog_density_ = atof(value.c_str());
+    } else if (key == "--profile") {
+      option.profile_path_ = value.empty() ? "profile.json" : value;
+    } else if (key == "--trace" && !value.empty()) {
+      option.trace_path_ = value;
+    } else if (key == "--trace-every" && atoi(value.c_str()) > 0) {
+      option.trace_every_ = atoi(value.c_str());
+    } else if (key == "--trace-limit" && atoi(value.c_str()) > 0) {
+      option.trace_limit_mb_ = atoi(value.c_str());
+    } else {
+      fprintf(stderr, "Unknown or malformed option '%s'\n", argv[i]);
+      print_usage();
+      exit(1);
+    }
+  }
+
+  // The dense accumulator takes 24 bytes per pixel up front, sparse tiles only
+  // cost memory where light actually lands.
+  const auto max_size = option.sparse_ ? kMaxSparseImageSize : kMaxDenseImageSize;
+  if (sx < 256 || sy < 256 || sx > max_size || sy > max_size || num_rays < 1 || num_rays > 10000000 ||
+      max_depth < 1 || max_depth > 25) {
+    print_usage();
+    exit(1);
+  }
+
+  fprintf(stderr, "Working with:\n");
+  fprintf(stderr, "Image size (%d, %d)\n", sx, sy);
+  fprintf(stderr, "Number of samples: %d\n", num_rays);
+  fprintf(stderr, "Max. recursion depth: %d\n", max_depth);
+  if (!option.preview_path_.empty() && option.preview_every_rays_ == 0 && option.preview_every_seconds_ == 0) {
+    option.preview_every_seconds_ = 10;
+  }
+  if (option.detectors_only_ && (!option.preview_path_.empty() || option.frames_ > 0)) {
+    fprintf(stderr, "--detectors-only renders no image to preview or animate\n");
+    exit(1);
+  }
+  if (!option.sweep_material_.empty() && (option.detectors_only_ || option.frames_ > 0)) {
+    fprintf(stderr, "--sweep renders one still image per albedo\n");
+    exit(1);
+  }
+  if ((option.frames_ > 0 || !option.sweep_material_.empty()) &&
+      SequenceRenderer::FramePath(option.output_path_, 0).empty()) {
+    fprintf(stderr, "--output may only number images with one %%d or %%0Nd\n");
+    exit(1);
+  }
+  if (option.sparse_ && option.accumulator_ != AccumulatorFormat::kDouble) {
+    fprintf(stderr, "--sparse only supports the double accumulator\n");
+    exit(1);
+  }
+  if (option.accumulator_ == AccumulatorFormat::kFixed32 && option.fixed_fraction_bits_ >= 32) {
+    fprintf(stderr, "--fixed-bits must be below 32 for fixed32 cells\n");
+    exit(1);
+  }
+  if (option.sparse_) {
+    fprintf(stderr, "Sparse accumulator: %zux%zu tiles, memory budget %zu MB\n", option.tile_size_,
+            option.tile_size_, option.memory_budget_mb_);
+  }
+  if (option.deferred_) {
+    fprintf(stderr, "Deferred splatting: %zux%zu tiles, %zu rays per batch\n", option.tile_size_, option.tile_size_,
+            option.batch_size_);
+  }
+
+  if (option.roi_) {
+    fprintf(stderr, "Region of interest: (%g, %g) - (%g, %g)\n", option.roi_->left_, option.roi_->top_,
+            option.roi_->right_, option.roi_->bottom_);
+  }
+
+  return option;
+}
+
+static auto MakeRayTracer(const Options &option) -> std::unique_ptr<RayTracer> {
+#ifdef RT2D_GENERATED_SCENE
+  auto light = generated::BuildLight();
+  if (!light) {
+    exit(1);
+  }
+  auto rt = std::make_unique<RayTracer>(option, generated::BuildScene(), std::move(light));
+  rt->SetPathKernel(generated::PropagatePath);
+  return rt;
+#else
+  if (option.scene_path_.empty()) {
+    return std::make_unique<RayTracer>(option);
+  }
+  auto description = SceneDescription{};
+  if (!LoadSceneDescription(option.scene_path_, description)) {
+    exit(1);
+  }
+  auto light = BuildLight(description);
+  if (!light) {
+    exit(1);
+  }
+  return std::make_unique<RayTracer>(option, BuildScene(description), std::move(light));
+#endif
+}
+
+// The detectors of the scene description of `option`, null if it has none.
+static auto MakeDetectors(const Options &option, const RayTracer &rt) -> std::unique_ptr<DetectorSet> {
+#ifdef RT2D_GENERATED_SCENE
+  (void)option;
+  (void)rt;
+  return nullptr;
+#else
+  auto description = SceneDescription{};
+  if (option.scene_path_.empty() || !LoadSceneDescription(option.scene_path_, description) ||
+      description.detectors_.empty()) {
+    return nullptr;
+  }
+  return std::make_unique<DetectorSet>(*rt.scene_, description.detectors_, ResolveThreads(option.threads_));
+#endif
+}
+
+// Render the keyframed scene description of `option` frame by frame.
+static void RenderSequence(const Options &option) {
+#ifdef RT2D_GENERATED_SCENE
+  (void)option;
+  fprintf(stderr, "--frames needs the keys of a --scene, this build has none\n");
+  exit(1);
+#else
+  auto description = SceneDescription{};
+  if (!option.scene_path_.empty() && !LoadSceneDescription(option.scene_path_, description)) {
+    exit(1);
+  }
+  auto rt = MakeRayTracer(option);
+  auto sequence = SequenceRenderer(*rt, MakeTracks(description));
+  if (!sequence.Render(option.frames_, option.output_path_)) {
+    exit(1);
+  }
+#endif
+}
+
+// Render every albedo of the swept material of `option` from the same paths.
+static void RenderSweep(const Options &option) {
+#ifdef RT2D_GENERATED_SCENE
+  (void)option;
+  fprintf(stderr, "--sweep needs the materials of a --scene, this build has none\n");
+  exit(1);
+#else
+  auto description = SceneDescription{};
+  if (option.scene_path_.empty() || !LoadSceneDescription(option.scene_path_, description)) {
+    fprintf(stderr, "--sweep needs a --scene\n");
+    exit(1);
+  }
+  // Materials get their ids in file order.
+  const auto &materials = description.materials_;
+  MaterialId material = 0;
+  while (material < materials.size() && materials[material].name_ != option.sweep_material_) {
+    material++;
+  }
+  auto rt = MakeRayTracer(option);
+  if (material == materials.size() || !SweepRenderer::Supports(*rt, material)) {
+    fprintf(stderr, "Can not sweep material '%s': it must be a scattering material of a scene without media\n",
+            option.sweep_material_.c_str());
+    exit(1);
+  }
+  auto sweep = SweepRenderer(*rt, material, option.sweep_albedos_);
+  if (!sweep.Render(ResolveThreads(option.threads_))) {
+    exit(1);
+  }
+  StageScope scope(Stage::kOutput);
+  for (size_t v = 0; v < sweep.size(); v++) {
+    auto &image = sweep.image(v);
+    image.AdjustGamma();
+    for (const auto &shape : *rt->scene_) {
+      shape->Render(image);
+    }
+    if (!image.Write(SequenceRenderer::FramePath(option.output_path_, v), option.threads_)) {
+      exit(1);
+    }
+  }
+#endif
+}
+
+// Render the single image of `option`, or only its detectors.
+static void RenderImage(const Options &option) {
+  auto rt = MakeRayTracer(option);
+  auto detectors = MakeDetectors(option, *rt);
+  if (detectors) {
+    rt->SetDetectors(detectors.get());
+  } else if (option.detectors_only_) {
+    fprintf(stderr, "--detectors-only needs a --scene with detector lines\n");
+    exit(1);
+  }
+  rt->Render(option.threads_);
+  if (rt->near_zero_hits() > 0) {
+    fprintf(stderr, "%lu bounces re-hit their own surface\n", static_cast<unsigned long>(rt->near_zero_hits()));
+  }
+  if (rt->escaped_rays() > 0) {
+    fprintf(stderr, "%lu rays escaped the scene\n", static_cast<unsigned long>(rt->escaped_rays()));
+  }
+  if (detectors && !detectors->Write(option.detector_path_)) {
+    exit(1);
+  }
+  if (option.detectors_only_) {
+    return;
+  }
+
+  StageScope scope(Stage::kOutput);
+  rt->image_.AdjustGamma();
+  for (const auto &shape : *rt->scene_) {
+    shape->Render(rt->image_);
+  }
+  if (!rt->image_.Write(option.output_path_, option.threads_)) {
+    exit(1);
+  }
+}
+
+static void Main(int argc, char *argv[]) {
+  auto option = parse_args(argc, argv);
+#ifdef RT2D_GENERATED_SCENE
+  if (!option.scene_path_.empty()) {
+    fprintf(stderr, "This build only renders %s\n", generated::kSceneName);
+    exit(1);
+  }
+#endif
+  if (option.autotune_) {
+    auto tuned = Autotune(option, MakeRayTracer);
+    tuned.ApplyTo(option);
+    fprintf(stderr, "Autotune%s: %zu threads, %zu rays per batch, %zux%zu tiles, %s splatting (%.0f rays/s)\n",
+            tuned.cached_ ? " (cached)" : "", tuned.threads_, tuned.batch_size_, tuned.tile_size_, tuned.tile_size_,
+            tuned.deferred_ ? "deferred" : "direct", tuned.rays_per_second_);
+  }
+  if (!option.profile_path_.empty()) {
+    if (kStageProfiling) {
+      StageProfiler::Enable();
+    } else {
+      fprintf(stderr, "--profile needs a build with RT2D_PERF_COUNTERS, ignored\n");
+    }
+  }
+  if (option.frames_ > 0) {
+    RenderSequence(option);
+  } else if (!option.sweep_material_.empty()) {
+    RenderSweep(option);
+  } else {
+    RenderImage(option);
+  }
+  if (StageProfiler::enabled()) {
+    StageProfiler::Print(stderr);
+    if (!StageProfiler::WriteJson(option.profile_path_)) {
+      exit(1);
+    }
+  }
+}
+
+}  // namespace RayTracer2D
 
 int main(int argc, char *argv[]) {
   RayTracer2D::Main(argc, argv);
   return 0;
 }
-
@@ -5,7 +5,7 @@
 
 namespace RayTracer2D {
 
-class ReflectiveMaterial : public Material {
+class ReflectiveMaterial final : public Material {
  public:
   ReflectiveMaterial() = default;
   DISALLOW_COPY_AND_MOVE(ReflectiveMaterial);
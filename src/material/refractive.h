@@ -5,7 +5,7 @@
 
 namespace RayTracer2D {
 
-class RefractiveMaterial : public Material {
+class RefractiveMaterial final : public Material {
  public:
   explicit RefractiveMaterial(const double r_idx);
   DISALLOW_COPY_AND_MOVE(RefractiveMaterial);
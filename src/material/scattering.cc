@@ -1,15 +1,25 @@
 #include "material/scattering.h"
+#include <cmath>
+#include "utils/fast_math.h"
 
 namespace RayTracer2D {
 
-ScatteringMaterial::ScatteringMaterial() : gen_(rd_()), distribution_(-M_PI / 2, M_PI / 2) {}
+ScatteringMaterial::ScatteringMaterial(ScatterDistribution distribution, const Colour &albedo)
+    : distribution_(distribution), albedo_(albedo) {}
 
 Ray ScatteringMaterial::Interact(const Ray &r, const Point2d &p, const Point2d &n) {
-  auto theta = distribution_(gen_);
-  auto c = cos(theta);
-  auto s = sin(theta);
+  // Angle to the normal in [-pi/2, pi/2]. In 2D the cosine density inverts to
+  // sin(theta) = 2u - 1, which needs no trigonometry at all.
+  auto u = r.Sample(0);
+  double c, s;
+  if (distribution_ == ScatterDistribution::kCosine) {
+    s = 2 * u - 1;
+    c = std::sqrt(1 - s * s);
+  } else {
+    FastSinCos((u - 0.5) * M_PI, &s, &c);
+  }
   auto d = Point2d(c * n.x - s * n.y, s * n.x + c * n.y).Normalize();
-  return Ray(p, d, r.colour_);
+  return Ray(p, d, r.colour_ * albedo_);
 }
 
 }  // namespace RayTracer2D
@@ -1,22 +1,40 @@
 #pragma once
 
-#include <random>
+#include "core/colour.h"
 #include "core/material.h"
 #include "utils/macros.h"
 
 namespace RayTracer2D {
 
-class ScatteringMaterial : public Material {
+enum class ScatterDistribution {
+  // Every outgoing angle in the hemisphere is equally likely.
+  kUniform,
+  // Lambertian: outgoing angles are distributed proportional to the cosine
+  // to the normal. Rays carry no weight, so sampling this density exactly is
+  // what makes the surface Lambertian.
+  kCosine,
+};
+
+class ScatteringMaterial final : public Material {
  public:
-  ScatteringMaterial();
+  // Scattered rays keep `albedo` of each channel of the incoming colour.
+  explicit ScatteringMaterial(ScatterDistribution distribution = ScatterDistribution::kUniform,
+                              const Colour &albedo = Colour(1, 1, 1));
   DISALLOW_COPY_AND_MOVE(ScatteringMaterial);
 
   Ray Interact(const Ray &r, const Point2d &p, const Point2d &n) override;
 
+  const Colour &albedo() const {
+    return albedo_;
+  }
+  // The albedo only weighs rays, it never changes where they go.
+  void set_albedo(const Colour &albedo) {
+    albedo_ = albedo;
+  }
+
  private:
-  std::random_device rd_;
-  std::mt19937 gen_;
-  std::uniform_real_distribution<double> distribution_;
+  ScatterDistribution distribution_;
+  Colour albedo_;
 };
 
 }  // namespace RayTracer2D
@@ -0,0 +1,125 @@
+#include "medium/grid_medium.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include "utils/fast_math.h"
+
+namespace RayTracer2D {
+
+GridMedium::GridMedium(const Point2d &min, const Point2d &max, size_t nx, size_t ny, std::vector<double> density,
+                       double scale, const Colour &albedo, size_t block)
+    : Medium(albedo),
+      min_(min),
+      max_(max),
+      nx_(nx),
+      ny_(ny),
+      sigma_(std::move(density)),
+      block_(std::max<size_t>(block, 1)),
+      bx_((nx + block_ - 1) / block_),
+      by_((ny + block_ - 1) / block_),
+      block_size_(Point2d((max.x - min.x) / nx * block_, (max.y - min.y) / ny * block_)),
+      majorant_(bx_ * by_, 0) {
+  for (auto &sigma : sigma_) {
+    sigma *= scale;
+  }
+  // Blocks also bound the ring of cells around them, so that a point rounded
+  // into a neighbouring cell near a block edge never exceeds the majorant.
+  for (size_t y = 0; y < ny_; y++) {
+    for (size_t x = 0; x < nx_; x++) {
+      const auto sigma = sigma_[y * nx_ + x];
+      for (auto by = (y == 0 ? 0 : y - 1) / block_; by <= std::min(y + 1, ny_ - 1) / block_; by++) {
+        for (auto bx = (x == 0 ? 0 : x - 1) / block_; bx <= std::min(x + 1, nx_ - 1) / block_; bx++) {
+          majorant_[by * bx_ + bx] = std::max(majorant_[by * bx_ + bx], sigma);
+        }
+      }
+    }
+  }
+}
+
+double GridMedium::SigmaAt(const Point2d &p) const {
+  if (p.x < min_.x || p.x > max_.x || p.y < min_.y || p.y > max_.y) {
+    return 0;
+  }
+  const auto x = std::min(static_cast<size_t>((p.x - min_.x) / (max_.x - min_.x) * nx_), nx_ - 1);
+  const auto y = std::min(static_cast<size_t>((p.y - min_.y) / (max_.y - min_.y) * ny_), ny_ - 1);
+  return sigma_[y * nx_ + x];
+}
+
+// Parameter range of `ray` inside [lo, hi] along one axis.
+static void ClipSlab(const double p, const double d, const double lo, const double hi, double &t0, double &t1) {
+  if (d == 0) {
+    if (p < lo || p > hi) {
+      t1 = -1;
+    }
+    return;
+  }
+  auto a = (lo - p) / d;
+  auto b = (hi - p) / d;
+  if (a > b) {
+    std::swap(a, b);
+  }
+  t0 = std::max(t0, a);
+  t1 = std::min(t1, b);
+}
+
+// Walk the majorant blocks along the ray (Amanatides-Woo) and run delta
+// tracking in each one with its own bound. Free-flight distances are
+// memoryless, so restarting at every block boundary is unbiased.
+auto GridMedium::SampleCollision(const Ray &ray, double t0, double t1, HashStream &random) const
+    -> std::optional<double> {
+  ClipSlab(ray.p_.x, ray.d_.x, min_.x, max_.x, t0, t1);
+  ClipSlab(ray.p_.y, ray.d_.y, min_.y, max_.y, t0, t1);
+  if (t0 >= t1) {
+    return std::nullopt;
+  }
+
+  const auto speed = ray.d_.Length();
+  const auto start = ray(t0);
+  auto ix = std::min(static_cast<size_t>(std::max((start.x - min_.x) / block_size_.x, 0.0)), bx_ - 1);
+  auto iy = std::min(static_cast<size_t>(std::max((start.y - min_.y) / block_size_.y, 0.0)), by_ - 1);
+
+  constexpr auto kInfinity = std::numeric_limits<double>::infinity();
+  auto next_boundary = [&](double p, double d, double lo, double size, size_t i) {
+    if (d == 0) {
+      return kInfinity;
+    }
+    return (lo + (d > 0 ? i + 1 : i) * size - p) / d;
+  };
+  auto next_x = next_boundary(ray.p_.x, ray.d_.x, min_.x, block_size_.x, ix);
+  auto next_y = next_boundary(ray.p_.y, ray.d_.y, min_.y, block_size_.y, iy);
+  const auto delta_x = ray.d_.x == 0 ? kInfinity : block_size_.x / std::abs(ray.d_.x);
+  const auto delta_y = ray.d_.y == 0 ? kInfinity : block_size_.y / std::abs(ray.d_.y);
+
+  auto t = t0;
+  while (t < t1) {
+    const auto exit = std::min({next_x, next_y, t1});
+    const auto majorant = majorant_[iy * bx_ + ix] * speed;
+    if (majorant > 0) {
+      while (true) {
+        t -= FastLog(1 - random.Next()) / majorant;
+        if (t >= exit) {
+          break;
+        }
+        if (random.Next() * majorant < SigmaAt(ray(t)) * speed) {
+          return t;
+        }
+      }
+    }
+    t = exit;
+    if (next_x < next_y) {
+      if ((ray.d_.x > 0 && ++ix >= bx_) || (ray.d_.x < 0 && ix-- == 0)) {
+        break;
+      }
+      next_x += delta_x;
+    } else {
+      if ((ray.d_.y > 0 && ++iy >= by_) || (ray.d_.y < 0 && iy-- == 0)) {
+        break;
+      }
+      next_y += delta_y;
+    }
+  }
+  return std::nullopt;
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,24 @@
+#include "medium/homogeneous_medium.h"
+#include <cmath>
+#include "utils/fast_math.h"
+
+namespace RayTracer2D {
+
+HomogeneousMedium::HomogeneousMedium(double sigma_t, const Colour &albedo) : Medium(albedo), sigma_t_(sigma_t) {}
+
+// With a constant coefficient the majorant is exact: every tentative collision
+// is a real one.
+auto HomogeneousMedium::SampleCollision(const Ray &ray, double t0, double t1, HashStream &random) const
+    -> std::optional<double> {
+  const auto sigma = sigma_t_ * ray.d_.Length();
+  if (sigma <= 0) {
+    return std::nullopt;
+  }
+  const auto t = t0 - FastLog(1 - random.Next()) / sigma;
+  if (t < t1) {
+    return t;
+  }
+  return std::nullopt;
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "core/medium.h"
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// Constant extinction coefficient `sigma_t`, per unit length.
+class HomogeneousMedium final : public Medium {
+ public:
+  explicit HomogeneousMedium(double sigma_t, const Colour &albedo);
+  DISALLOW_COPY_AND_MOVE(HomogeneousMedium);
+
+  auto SampleCollision(const Ray &ray, double t0, double t1, HashStream &random) const
+      -> std::optional<double> override;
+
+ private:
+  double sigma_t_;
+};
+
+}  // namespace RayTracer2D
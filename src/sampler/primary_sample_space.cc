@@ -0,0 +1,75 @@
+#include "sampler/primary_sample_space.h"
+#include <algorithm>
+#include <cmath>
+#include "utils/hash.h"
+
+namespace RayTracer2D {
+
+PrimarySampleSpace::PrimarySampleSpace(uint64_t seed, double large_step_probability)
+    : random_(Hash64(seed)), large_step_probability_(large_step_probability) {}
+
+double PrimarySampleSpace::Get(const uint64_t index, const uint32_t dimension) const {
+  (void)index;
+  if (dimension >= values_.size()) {
+    values_.resize(dimension + 1);
+  }
+  auto &value = values_[dimension];
+  if (value.modified_ == iteration_) {
+    return value.x_;
+  }
+  // A number drawn for the first time since the last large step stands for
+  // the one that step would have drawn.
+  if (value.modified_ < last_large_step_) {
+    value.x_ = random_.Next();
+    value.modified_ = last_large_step_;
+  }
+  value.backup_x_ = value.x_;
+  value.backup_modified_ = value.modified_;
+  if (large_step_) {
+    value.x_ = random_.Next();
+  } else {
+    // Catch up on the small steps missed since the number was last drawn,
+    // wrapping around [0, 1).
+    const auto steps = std::min<int64_t>(iteration_ - value.modified_, kMaxSteps);
+    for (int64_t i = 0; i < steps; i++) {
+      value.x_ += SmallStep();
+    }
+    value.x_ -= std::floor(value.x_);
+  }
+  value.modified_ = iteration_;
+  return value.x_;
+}
+
+void PrimarySampleSpace::StartIteration() {
+  iteration_++;
+  large_step_ = random_.Next() < large_step_probability_;
+}
+
+void PrimarySampleSpace::Accept() {
+  if (large_step_) {
+    last_large_step_ = iteration_;
+  }
+}
+
+void PrimarySampleSpace::Reject() {
+  for (auto &value : values_) {
+    if (value.modified_ == iteration_) {
+      value.x_ = value.backup_x_;
+      value.modified_ = value.backup_modified_;
+    }
+  }
+  iteration_--;
+}
+
+void PrimarySampleSpace::Reseed(uint64_t seed) {
+  random_ = HashStream(Hash64(seed));
+}
+
+// Kelemen's perturbation: sizes between kMinStep and kMaxStep, exponentially
+// distributed so that tiny features and larger ones are both explored.
+double PrimarySampleSpace::SmallStep() const {
+  const auto size = kMaxStep * std::exp(-std::log(kMaxStep / kMinStep) * random_.Next());
+  return random_.Next() < 0.5 ? -size : size;
+}
+
+}  // namespace RayTracer2D
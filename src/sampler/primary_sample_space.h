@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "core/sampler.h"
+#include "utils/random.h"
+
+namespace RayTracer2D {
+
+// The random numbers of the current path of one Metropolis chain (Kelemen et
+// al., "A Simple and Robust Mutation Strategy for the Metropolis Light
+// Transport Algorithm", 2002). Every iteration proposes either fresh numbers
+// (a large step) or small perturbations of the current ones, and the chain
+// then accepts or rejects the proposal.
+//
+// Numbers are mutated lazily when the path draws them, so dimensions a path
+// never reaches cost nothing. Unlike the other samplers this one has state:
+// it serves a single chain on a single thread, and ignores the point index.
+class PrimarySampleSpace final : public Sampler {
+ public:
+  explicit PrimarySampleSpace(uint64_t seed, double large_step_probability);
+
+  double Get(const uint64_t index, const uint32_t dimension) const override;
+
+  // Propose the next path, drawn by the following calls to `Get`.
+  void StartIteration();
+  // Keep the proposal as the current path, or go back to the previous one.
+  void Accept();
+  void Reject();
+  // Draw the numbers of the following iterations from a stream of `seed`,
+  // keeping the current path: chains starting from the same path must not
+  // mutate it the same way.
+  void Reseed(uint64_t seed);
+
+  bool large_step() const {
+    return large_step_;
+  }
+
+ private:
+  struct Value {
+    double x_{0};
+    // Iteration that last set `x_`, -1 for a dimension never drawn.
+    int64_t modified_{-1};
+    double backup_x_{0};
+    int64_t backup_modified_{-1};
+  };
+
+  double SmallStep() const;
+
+  // Range of the size of one small step, and the most steps a number catches
+  // up on at once.
+  static constexpr double kMinStep = 1.0 / 16384;
+  static constexpr double kMaxStep = 1.0 / 64;
+  static constexpr int64_t kMaxSteps = 1024;
+
+  mutable HashStream random_;
+  mutable std::vector<Value> values_;
+  double large_step_probability_;
+  int64_t iteration_{0};
+  int64_t last_large_step_{0};
+  // The first path of a chain is drawn afresh.
+  bool large_step_{true};
+};
+
+}  // namespace RayTracer2D
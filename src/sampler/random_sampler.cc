@@ -0,0 +1,13 @@
+#include "sampler/random_sampler.h"
+#include "utils/hash.h"
+
+namespace RayTracer2D {
+
+RandomSampler::RandomSampler(uint64_t seed) : seed_(Hash64(seed)) {}
+
+double RandomSampler::Get(const uint64_t index, const uint32_t dimension) const {
+  auto bits = HashCombine(HashCombine(seed_, index), dimension);
+  return static_cast<double>(bits >> 11) * 0x1.0p-53;
+}
+
+}  // namespace RayTracer2D
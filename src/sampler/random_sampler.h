@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include "core/sampler.h"
+
+namespace RayTracer2D {
+
+// Independent uniform samples. Every (index, dimension) pair is hashed, so the
+// numbers of a path do not depend on which thread traces it.
+class RandomSampler final : public Sampler {
+ public:
+  explicit RandomSampler(uint64_t seed);
+
+  double Get(const uint64_t index, const uint32_t dimension) const override;
+
+ private:
+  uint64_t seed_;
+};
+
+}  // namespace RayTracer2D
@@ -0,0 +1,53 @@
+#include "sampler/sobol_sampler.h"
+#include "utils/hash.h"
+
+namespace RayTracer2D {
+
+static uint32_t ReverseBits(uint32_t x) {
+  x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+  x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+  return (x >> 16) | (x << 16);
+}
+
+// Second Sobol dimension; the first one is the van der Corput sequence,
+// i.e. the reversed index.
+static uint32_t Sobol1(uint32_t index) {
+  uint32_t x = 0;
+  for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1) {
+    if (index & 1) {
+      x ^= v;
+    }
+  }
+  return x;
+}
+
+// Laine-Karras style hash: every output bit only depends on the input bits
+// below it. Applied to reversed bits it is a nested uniform (Owen) scramble.
+static uint32_t LaineKarrasPermutation(uint32_t x, uint32_t seed) {
+  x ^= x * 0x3d20adeau;
+  x += seed;
+  x *= (seed >> 16) | 1;
+  x ^= x * 0x05526c56u;
+  x ^= x * 0x53a22864u;
+  return x;
+}
+
+static uint32_t NestedUniformScramble(uint32_t x, uint32_t seed) {
+  return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+}
+
+SobolSampler::SobolSampler(uint64_t seed, bool owen) : seed_(Hash64(seed)), owen_(owen) {}
+
+double SobolSampler::Get(const uint64_t index, const uint32_t dimension) const {
+  const auto pair_seed = HashCombine(seed_, dimension / 2);
+  const auto shuffled = NestedUniformScramble(static_cast<uint32_t>(index), static_cast<uint32_t>(pair_seed));
+
+  auto x = dimension % 2 == 0 ? ReverseBits(shuffled) : Sobol1(shuffled);
+  const auto scramble = static_cast<uint32_t>(HashCombine(pair_seed, 1 + dimension % 2));
+  x = owen_ ? NestedUniformScramble(x, scramble) : x ^ scramble;
+  return static_cast<double>(x) * 0x1.0p-32;
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include "core/sampler.h"
+
+namespace RayTracer2D {
+
+// The two dimensional Sobol sequence, padded to any number of dimensions.
+//
+// Dimensions are consumed in pairs (emission position/angle, then one pair per
+// bounce), and every pair is a (0,2)-sequence of its own. The pairs are
+// decorrelated by shuffling the point index with a per-pair nested uniform
+// scramble, which maps every aligned block of 2^m indices onto another aligned
+// block and thus keeps the stratification of every power-of-two prefix
+// (Burley, "Practical Hash-based Owen Scrambling", 2020).
+//
+// The point itself is then either XOR scrambled (random digit scrambling) or
+// Owen scrambled, the latter also randomizes the order inside each stratum and
+// converges faster for smooth integrands.
+class SobolSampler final : public Sampler {
+ public:
+  explicit SobolSampler(uint64_t seed, bool owen);
+
+  double Get(const uint64_t index, const uint32_t dimension) const override;
+
+ private:
+  uint64_t seed_;
+  bool owen_;
+};
+
+}  // namespace RayTracer2D
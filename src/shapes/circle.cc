@@ -3,50 +3,52 @@
 #include <cmath>
 #include <memory>
 #include "core/material.h"
+#include "utils/fast_math.h"
 
 namespace RayTracer2D {
 
 Circle::Circle(const Point2d &c, const double r, MaterialPtr material) : c_(c), r_(r) {
-  material_ = std::move(material);
+  owned_material_ = std::move(material);
+  material_ = owned_material_.get();
+}
+
+Circle::Circle(const Point2d &c, const double r, Material *material) : c_(c), r_(r) {
+  material_ = material;
 }
 
 std::optional<double> Circle::Intersect(const Ray &ray) const {
+  return IntersectCircle(c_, r_, ray, ray.origin_ == this);
+}
+
+auto Circle::Span(const Ray &ray) const -> std::optional<std::pair<double, double>> {
   auto oc = ray.p_ - c_;
   auto a = Dot(ray.d_, ray.d_);
-  auto b = 2.0 * Dot(ray.d_, oc);
-  auto c = Dot(oc, oc) - r_ * r_;
-
-  auto discriminant = b * b - 4 * a * c;
-  if (discriminant < 0) {
+  auto b = Dot(ray.d_, oc);
+  auto discriminant = b * b - a * (Dot(oc, oc) - r_ * r_);
+  if (discriminant <= 0) {
     return std::nullopt;
   }
+  auto root = std::sqrt(discriminant);
+  return std::make_pair((-b - root) / a, (-b + root) / a);
+}
 
-  auto t1 = (-b - std::sqrt(discriminant)) / (2 * a);
-  auto t2 = (-b + std::sqrt(discriminant)) / (2 * a);
-
-  if (t1 > 0) {
-    return t1;
-  } else if (t2 > 0) {
-    return t2;
-  } else {
-    // Both intersections are behind the ray's origin
-    return std::nullopt;
-  }
+auto Circle::Bounds() const -> std::optional<Rect> {
+  return Rect{c_.x - r_, c_.y - r_, c_.x + r_, c_.y + r_};
 }
 
-Point2d Circle::GetNormal(const Ray &ray, const Point2d &p) const {
-  // The normal is from the center of the circle to the hit point
-  auto normal = p - c_;
-  normal.Normalize();
+bool Circle::Translate(const Point2d &offset) {
+  c_ = c_ + offset;
+  return true;
+}
 
-  // Ensure the normal points towards the ray (forms an obtuse angle with the
-  // ray direction) If the dot product of the ray direction and the normal is
-  // positive, they form an acute angle, so we need to flip the normal
-  if (Dot(ray.d_, normal) > 0) {
-    normal = normal * -1.0;
-  }
+// Fraction of a turn counterclockwise from the +x axis.
+double Circle::SurfaceCoordinate(const Point2d &p) const {
+  const auto turns = std::atan2(p.y - c_.y, p.x - c_.x) / (2 * M_PI);
+  return turns < 0 ? std::min(turns + 1, std::nextafter(1.0, 0.0)) : turns;
+}
 
-  return normal;
+Point2d Circle::GetNormal(const Ray &ray, const Point2d &p) const {
+  return CircleNormal(c_, ray, p);
 }
 
 Ray Circle::Interact(const Ray &r, const Point2d &p, const Point2d &n) {
@@ -57,27 +59,19 @@ void Circle::Render(Image &image) const {
   const auto sx = image.sx_;
   const auto sy = image.sy_;
 
-  auto map = std::unique_ptr<unsigned char[]>(new unsigned char[3 * sx * sy]());
-  double x, y;
+  double x, y, s, c;
   int xx, yy;
   for (double ang = 0; ang < 2 * M_PI; ang += .001) {
-    x = c_.x + (cos(ang) * r_);
-    y = c_.y + (sin(ang) * r_);
-    x -= W_LEFT;
-    y -= W_TOP;
-    x = x / (W_RIGHT - W_LEFT);
-    y = y / (W_BOTTOM - W_TOP);
-    x = x * (sx - 1);
-    y = y * (sy - 1);
-    xx = (int)round(x);
-    yy = (int)round(y);
+    FastSinCos(ang, &s, &c);
+    auto pixel = image.ToPixel(Point2d(c_.x + (c * r_), c_.y + (s * r_)));
+    x = pixel.x;
+    y = pixel.y;
+    xx = FastRound(x);
+    yy = FastRound(y);
     if (0 <= xx && xx < sx && 0 <= yy && yy < sy) {
-      map[(xx + (yy * sx)) * 3 + 0] = 0;
-      map[(xx + (yy * sx)) * 3 + 1] = 255;
-      map[(xx + (yy * sx)) * 3 + 2] = 0;
+      image.Overlay(xx, yy, 0, 255, 0);
     }
   }
-  image.maps_.push_back(std::move(map));
 }
 
 }  // namespace RayTracer2D
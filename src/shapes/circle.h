@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cmath>
 #include <optional>
+#include <utility>
 
 #include "core/image.h"
 #include "core/material.h"
@@ -10,14 +12,76 @@
 
 namespace RayTracer2D {
 
-class Circle : public Shape {
+class Circle final : public Shape {
  public:
   explicit Circle(const Point2d &c, const double r, MaterialPtr material);
+  explicit Circle(const Point2d &c, const double r, Material *material);
 
   std::optional<double> Intersect(const Ray &ray) const override;
   Point2d GetNormal(const Ray &ray, const Point2d &p) const override;
   Ray Interact(const Ray &r, const Point2d &p, const Point2d &n) override;
   void Render(Image &image) const override;
+  auto Bounds() const -> std::optional<Rect> override;
+  bool Translate(const Point2d &offset) override;
+  double SurfaceCoordinate(const Point2d &p) const override;
+
+  const Point2d &center() const {
+    return c_;
+  }
+  double radius() const {
+    return r_;
+  }
+  auto Span(const Ray &ray) const -> std::optional<std::pair<double, double>> override;
+
+  // Geometry of the circle (c, r), inline so that the kernels generated by
+  // SceneCodegen can fold in constant shapes. `from_self` tells that the ray
+  // leaves this very circle.
+  static std::optional<double> IntersectCircle(const Point2d &c, const double r, const Ray &ray,
+                                               const bool from_self) {
+    auto oc = ray.p_ - c;
+    auto a = Dot(ray.d_, ray.d_);
+    auto b = 2.0 * Dot(ray.d_, oc);
+    auto cc = Dot(oc, oc) - r * r;
+
+    auto discriminant = b * b - 4 * a * cc;
+    if (discriminant < 0) {
+      return std::nullopt;
+    }
+
+    auto t1 = (-b - std::sqrt(discriminant)) / (2 * a);
+    auto t2 = (-b + std::sqrt(discriminant)) / (2 * a);
+
+    // One root is the point the ray leaves from, up to rounding: only the other
+    // one can be a hit.
+    if (from_self) {
+      auto t = std::abs(t1) < std::abs(t2) ? t2 : t1;
+      return t > 0 ? std::optional<double>(t) : std::nullopt;
+    }
+
+    if (t1 > 0) {
+      return t1;
+    } else if (t2 > 0) {
+      return t2;
+    } else {
+      // Both intersections are behind the ray's origin
+      return std::nullopt;
+    }
+  }
+
+  static Point2d CircleNormal(const Point2d &c, const Ray &ray, const Point2d &p) {
+    // The normal is from the center of the circle to the hit point
+    auto normal = p - c;
+    normal.Normalize();
+
+    // Ensure the normal points towards the ray (forms an obtuse angle with the
+    // ray direction) If the dot product of the ray direction and the normal is
+    // positive, they form an acute angle, so we need to flip the normal
+    if (Dot(ray.d_, normal) > 0) {
+      normal = normal * -1.0;
+    }
+
+    return normal;
+  }
 
  private:
   Point2d c_;
@@ -0,0 +1,177 @@
+#include "shapes/instance.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "core/material.h"
+#include "utils/fast_math.h"
+
+namespace RayTracer2D {
+
+void Prototype::Grow(const Rect &rect) {
+  if (!bounds_) {
+    bounds_ = rect;
+    return;
+  }
+  bounds_ = Rect{std::min(bounds_->left_, rect.left_), std::min(bounds_->top_, rect.top_),
+                 std::max(bounds_->right_, rect.right_), std::max(bounds_->bottom_, rect.bottom_)};
+}
+
+void Prototype::AddWall(const Point2d &begin, const Point2d &end, const MaterialId material) {
+  walls_.push_back(arena_.Create<Wall>(begin, end, materials_.Get(material)));
+  Grow(*walls_.back()->Bounds());
+}
+
+void Prototype::AddCircle(const Point2d &center, const double r, const MaterialId material) {
+  circles_.push_back(arena_.Create<Circle>(center, r, materials_.Get(material)));
+  Grow(*circles_.back()->Bounds());
+}
+
+auto Prototype::FindFirstHit(const Ray &ray) const -> std::optional<std::pair<double, const Shape *>> {
+  auto t_min = std::numeric_limits<double>::infinity();
+  const Shape *hit = nullptr;
+  for (const auto *circle : circles_) {
+    auto t = circle->Intersect(ray);
+    if (t.has_value() && t.value() < t_min) {
+      t_min = t.value();
+      hit = circle;
+    }
+  }
+  for (const auto *wall : walls_) {
+    auto t = wall->Intersect(ray);
+    if (t.has_value() && t.value() < t_min) {
+      t_min = t.value();
+      hit = wall;
+    }
+  }
+  if (hit == nullptr) {
+    return std::nullopt;
+  }
+  return std::make_pair(t_min, hit);
+}
+
+void Prototype::Render(Image &image, const Affine2d &transform) const {
+  auto outline = [&](const Point2d &p) {
+    auto pixel = image.ToPixel(transform.Apply(p));
+    auto x = FastRound(pixel.x), y = FastRound(pixel.y);
+    if (0 <= x && static_cast<size_t>(x) < image.sx_ && 0 <= y && static_cast<size_t>(y) < image.sy_) {
+      image.Overlay(x, y, 0, 255, 0);
+    }
+  };
+  for (const auto *circle : circles_) {
+    double s, c;
+    for (double ang = 0; ang < 2 * M_PI; ang += .001) {
+      FastSinCos(ang, &s, &c);
+      outline(circle->center() + Point2d(c, s) * circle->radius());
+    }
+  }
+  for (const auto *wall : walls_) {
+    const auto d = wall->end() - wall->begin();
+    const auto steps = std::max(1.0, std::ceil(transform.ApplyLinear(d).Length() * image.scale().x));
+    for (double i = 0; i <= steps; i++) {
+      outline(wall->begin() + d * (i / steps));
+    }
+  }
+}
+
+// Nearest instance hit of the last ray tested on this thread. A bounce asks
+// the shape `Scene::FindFirstHit` picks for its normal and interaction: for
+// an instance, the shape of the prototype found here, without a second scan.
+struct InstanceHit {
+  const Instance *instance_{nullptr};
+  Point2d p_, d_;
+  double t_{0};
+  const Shape *child_{nullptr};
+};
+static thread_local InstanceHit last_hit;
+
+Instance::Instance(const Prototype &prototype, const Affine2d &transform)
+    : prototype_(prototype), transform_(transform), inverse_(transform.Inverse()) {}
+
+Ray Instance::ToPrototype(const Ray &ray) const {
+  auto local = ray;
+  local.p_ = inverse_.Apply(ray.p_);
+  local.d_ = inverse_.ApplyLinear(ray.d_);
+  local.origin_ = nullptr;
+  return local;
+}
+
+std::optional<double> Instance::Intersect(const Ray &ray) const {
+  const auto local = ToPrototype(ray);
+  double t0 = 0, t1 = std::numeric_limits<double>::infinity();
+  if (!prototype_.bounds() || !prototype_.bounds()->Clip(local.p_, local.d_, t0, t1)) {
+    return std::nullopt;
+  }
+  auto hit = prototype_.FindFirstHit(local);
+  if (!hit.has_value()) {
+    return std::nullopt;
+  }
+  auto &last = last_hit;
+  if (last.p_ != ray.p_ || last.d_ != ray.d_ || hit->first < last.t_) {
+    last = InstanceHit{this, ray.p_, ray.d_, hit->first, hit->second};
+  }
+  return hit->first;
+}
+
+// The cached hit only stands for `ray` hitting this instance at `p`. Any
+// other query, like a bounce traced again after the instance moved, scans
+// the prototype.
+auto Instance::Child(const Ray &ray, const Point2d &p) const -> const Shape * {
+  const auto &last = last_hit;
+  if (last.instance_ == this && last.p_ == ray.p_ && last.d_ == ray.d_ && ray(last.t_) == p) {
+    return last.child_;
+  }
+  auto hit = prototype_.FindFirstHit(ToPrototype(ray));
+  return hit.has_value() ? hit->second : nullptr;
+}
+
+Point2d Instance::GetNormal(const Ray &ray, const Point2d &p) const {
+  const auto *child = Child(ray, p);
+  if (child == nullptr) {
+    return -1.0 * ray.d_;
+  }
+  // The local normal faces the local ray, and so does the mapped one.
+  auto n = inverse_.ApplyTransposed(child->GetNormal(ToPrototype(ray), inverse_.Apply(p)));
+  n.Normalize();
+  return n;
+}
+
+// A ray that hits no shape of the prototype, which the hit test rules out,
+// goes on unchanged.
+Ray Instance::Interact(const Ray &r, const Point2d &p, const Point2d &n) {
+  const auto *child = Child(r, p);
+  if (child == nullptr) {
+    auto next = r;
+    next.p_ = p;
+    return next;
+  }
+  return child->material()->Interact(r, p, n);
+}
+
+void Instance::Render(Image &image) const {
+  prototype_.Render(image, transform_);
+}
+
+auto Instance::Bounds() const -> std::optional<Rect> {
+  const auto &b = prototype_.bounds();
+  if (!b) {
+    return std::nullopt;
+  }
+  const Point2d corners[] = {Point2d(b->left_, b->top_), Point2d(b->right_, b->top_), Point2d(b->left_, b->bottom_),
+                             Point2d(b->right_, b->bottom_)};
+  auto first = transform_.Apply(corners[0]);
+  auto bounds = Rect{first.x, first.y, first.x, first.y};
+  for (const auto &corner : corners) {
+    auto p = transform_.Apply(corner);
+    bounds = Rect{std::min(bounds.left_, p.x), std::min(bounds.top_, p.y), std::max(bounds.right_, p.x),
+                  std::max(bounds.bottom_, p.y)};
+  }
+  return bounds;
+}
+
+bool Instance::Translate(const Point2d &offset) {
+  transform_.t_ = transform_.t_ + offset;
+  inverse_ = transform_.Inverse();
+  return true;
+}
+
+}  // namespace RayTracer2D
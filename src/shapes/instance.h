@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include "core/image.h"
+#include "core/material_registry.h"
+#include "core/point.h"
+#include "core/ray.h"
+#include "core/rect.h"
+#include "core/shape.h"
+#include "core/transform.h"
+#include "shapes/circle.h"
+#include "shapes/wall.h"
+#include "utils/arena.h"
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// A group of circles and walls built once and placed many times by
+// `Instance`, see `Scene::AddPrototype`. Like a scene, it keeps its shapes
+// back to back in an arena and scans them in one monomorphic table per type,
+// behind a bounding box that rays missing the group never get past. Add
+// every shape before placing the prototype.
+class Prototype {
+ public:
+  explicit Prototype(const MaterialRegistry &materials) : materials_(materials) {}
+
+  DISALLOW_COPY_AND_MOVE(Prototype);
+
+  // Shapes use the materials of the scene the prototype belongs to.
+  void AddWall(const Point2d &begin, const Point2d &end, const MaterialId material);
+  void AddCircle(const Point2d &center, const double r, const MaterialId material);
+
+  size_t size() const {
+    return circles_.size() + walls_.size();
+  }
+  // Empty before the first shape is added.
+  const std::optional<Rect> &bounds() const {
+    return bounds_;
+  }
+
+  // Nearest hit of `ray`, given in the space of the prototype, and the shape
+  // it hits.
+  auto FindFirstHit(const Ray &ray) const -> std::optional<std::pair<double, const Shape *>>;
+
+  // Outline the shapes mapped by `transform` (for debug purpose).
+  void Render(Image &image, const Affine2d &transform) const;
+
+ private:
+  void Grow(const Rect &rect);
+
+  const MaterialRegistry &materials_;
+  Arena arena_;
+  std::vector<Circle *> circles_;
+  std::vector<Wall *> walls_;
+  std::optional<Rect> bounds_;
+};
+
+// A prototype placed in the world by an affine map with a non-zero
+// determinant. Rays are mapped into the space of the prototype, keeping
+// their parameter `t`: directions are not renormalized, so hits of instances
+// and of other shapes compare as is. Normals go back to the world by the
+// inverse transpose of the map, and the light interacts with the material of
+// the hit shape in world space.
+//
+// An instance costs a couple of maps whatever the size of its prototype, and
+// the shape of the prototype a ray hits is remembered per thread from the
+// hit test to the normal and the interaction.
+// Rays leaving an instance are kept off the shape they leave by the spawn
+// offset of `RayTracer::ContinuePath` alone.
+class Instance final : public Shape {
+ public:
+  explicit Instance(const Prototype &prototype, const Affine2d &transform);
+
+  std::optional<double> Intersect(const Ray &ray) const override;
+  Point2d GetNormal(const Ray &ray, const Point2d &p) const override;
+  Ray Interact(const Ray &r, const Point2d &p, const Point2d &n) override;
+  void Render(Image &image) const override;
+  auto Bounds() const -> std::optional<Rect> override;
+  bool Translate(const Point2d &offset) override;
+
+  const Prototype &prototype() const {
+    return prototype_;
+  }
+  const Affine2d &transform() const {
+    return transform_;
+  }
+
+ private:
+  Ray ToPrototype(const Ray &ray) const;
+  // Shape of the prototype `ray` hits at `p`, null if it misses them all.
+  auto Child(const Ray &ray, const Point2d &p) const -> const Shape *;
+
+  const Prototype &prototype_;
+  Affine2d transform_;
+  Affine2d inverse_;
+};
+
+}  // namespace RayTracer2D
@@ -1,40 +1,41 @@
 #include "wall.h"
+#include <algorithm>
+#include <cmath>
 #include "core/material.h"
 #include "core/ray.h"
 
 namespace RayTracer2D {
 
 Wall::Wall(const Point2d &begin, const Point2d &end, MaterialPtr material) : p_(begin), d_(end - begin) {
-  material_ = std::move(material);
+  owned_material_ = std::move(material);
+  material_ = owned_material_.get();
 }
 
-std::optional<double> Wall::Intersect(const Ray &ray) const {
-  auto cross_product = Cross(ray.d_, d_);
+Wall::Wall(const Point2d &begin, const Point2d &end, Material *material) : p_(begin), d_(end - begin) {
+  material_ = material;
+}
 
-  if (std::abs(cross_product) < PointConstants<double>::kEpsilon) {
-    return std::nullopt;
-  }
+std::optional<double> Wall::Intersect(const Ray &ray) const {
+  return IntersectWall(p_, d_, ray, ray.origin_ == this);
+}
 
-  auto diff = p_ - ray.p_;
-  auto t = Cross(diff, d_) / cross_product;
-  auto s = Cross(diff, ray.d_) / cross_product;
+auto Wall::Bounds() const -> std::optional<Rect> {
+  const auto end = p_ + d_;
+  return Rect{std::min(p_.x, end.x), std::min(p_.y, end.y), std::max(p_.x, end.x), std::max(p_.y, end.y)};
+}
 
-  if (t >= 0 && s >= 0 && s <= 1) {
-    return t;
-  }
+bool Wall::Translate(const Point2d &offset) {
+  p_ = p_ + offset;
+  return true;
+}
 
-  return std::nullopt;
+// Fraction of the way from the beginning to the end of the wall.
+double Wall::SurfaceCoordinate(const Point2d &p) const {
+  return std::clamp(Dot(p - p_, d_) / Dot(d_, d_), 0.0, std::nextafter(1.0, 0.0));
 }
 
 Point2d Wall::GetNormal(const Ray &ray, const Point2d &p) const {
-  auto n = Point2d(-d_.y, d_.x);
-  n.Normalize();
-
-  if (Dot(ray.d_, n) > 0) {
-    n = -1.0 * n;
-  }
-
-  return n;
+  return WallNormal(d_, ray);
 }
 
 Ray Wall::Interact(const Ray &r, const Point2d &p, const Point2d &n) {
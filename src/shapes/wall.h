@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cmath>
 #include <optional>
 
 #include "core/image.h"
@@ -10,14 +11,63 @@
 
 namespace RayTracer2D {
 
-class Wall : public Shape {
+class Wall final : public Shape {
  public:
   explicit Wall(const Point2d &begin, const Point2d &end, MaterialPtr material);
+  explicit Wall(const Point2d &begin, const Point2d &end, Material *material);
 
   std::optional<double> Intersect(const Ray &ray) const override;
   Point2d GetNormal(const Ray &ray, const Point2d &p) const override;
   Ray Interact(const Ray &r, const Point2d &p, const Point2d &n) override;
   void Render(Image &image) const override;
+  auto Bounds() const -> std::optional<Rect> override;
+  bool Translate(const Point2d &offset) override;
+  double SurfaceCoordinate(const Point2d &p) const override;
+
+  Point2d begin() const {
+    return p_;
+  }
+  Point2d end() const {
+    return p_ + d_;
+  }
+
+  // Geometry of the wall from `p` to `p + d`, inline so that the kernels
+  // generated by SceneCodegen can fold in constant shapes. `from_self` tells
+  // that the ray leaves this very wall.
+  static std::optional<double> IntersectWall(const Point2d &p, const Point2d &d, const Ray &ray,
+                                             const bool from_self) {
+    // A straight ray can not come back to the wall it leaves.
+    if (from_self) {
+      return std::nullopt;
+    }
+
+    auto cross_product = Cross(ray.d_, d);
+
+    if (std::abs(cross_product) < PointConstants<double>::kEpsilon) {
+      return std::nullopt;
+    }
+
+    auto diff = p - ray.p_;
+    auto t = Cross(diff, d) / cross_product;
+    auto s = Cross(diff, ray.d_) / cross_product;
+
+    if (t >= 0 && s >= 0 && s <= 1) {
+      return t;
+    }
+
+    return std::nullopt;
+  }
+
+  static Point2d WallNormal(const Point2d &d, const Ray &ray) {
+    auto n = Point2d(-d.y, d.x);
+    n.Normalize();
+
+    if (Dot(ray.d_, n) > 0) {
+      n = -1.0 * n;
+    }
+
+    return n;
+  }
 
  private:
   Point2d p_;
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "utils/macros.h"
+
+namespace RayTracer2D {
+
+// Bump allocator handing out objects from large blocks. Objects created in an
+// arena live until the arena is destroyed, which destroys them in reverse
+// order of creation. Consecutively created objects end up next to each other
+// in memory, which keeps linear scans over them cache friendly.
+class Arena {
+ public:
+  explicit Arena(size_t block_size = 64 * 1024) : block_size_(block_size) {}
+  ~Arena() {
+    for (auto it = destructors_.rbegin(); it != destructors_.rend(); ++it) {
+      it->second(it->first);
+    }
+  }
+
+  DISALLOW_COPY_AND_MOVE(Arena);
+
+  template <typename T, typename... Args>
+  T *Create(Args &&...args) {
+    void *memory = Allocate(sizeof(T), alignof(T));
+    T *object = new (memory) T(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      destructors_.emplace_back(object, [](void *p) { static_cast<T *>(p)->~T(); });
+    }
+    return object;
+  }
+
+  size_t BytesReserved() const {
+    return reserved_;
+  }
+
+ private:
+  // Blocks come from operator new[] and are aligned for any fundamental type,
+  // so aligning the offset within the block is enough.
+  void *Allocate(size_t size, size_t alignment) {
+    auto offset = (used_ + alignment - 1) & ~(alignment - 1);
+    if (blocks_.empty() || offset + size > current_size_) {
+      current_size_ = std::max(block_size_, size + alignment);
+      blocks_.emplace_back(new std::byte[current_size_]);
+      reserved_ += current_size_;
+      offset = 0;
+    }
+    used_ = offset + size;
+    return blocks_.back().get() + offset;
+  }
+
+  size_t block_size_;
+  size_t current_size_{0};
+  size_t used_{0};
+  size_t reserved_{0};
+  std::vector<std::unique_ptr<std::byte[]>> blocks_;
+  std::vector<std::pair<void *, void (*)(void *)>> destructors_;
+};
+
+}  // namespace RayTracer2D
@@ -12,4 +12,15 @@ const auto kBottomRight = Point2d(2, 2);
 constexpr double kPi = 3.1415926;
 constexpr double kEpsilon = 1e-6;
 
+// Rays leaving a surface start this far off it along the normal, relative to
+// max(1, |x|, |y|) of the hit point: a few thousand ulps, well above the
+// rounding error of the intersection tests and far below a pixel.
+constexpr double kSpawnOffset = 1e-9;
+// Hits closer than this to the ray origin count as wasted self-intersections.
+constexpr double kNearZeroHit = 1e-7;
+
+// Largest accepted image edge, in pixels, per accumulator backend.
+constexpr int kMaxDenseImageSize = 4096;
+constexpr int kMaxSparseImageSize = 65536;
+
 };  // namespace RayTracer2D
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace RayTracer2D {
+
+// Inline replacements for the libm functions on the render hot paths. They are
+// branch-free straight-line code with 32-bit integer conversions only, so loops
+// calling them auto-vectorize with plain SSE2 and without relying on a vector
+// math library, and sine and cosine share one range reduction.
+//
+// Worst-case errors against libm (see test/fast_math_test.cc), for sin/cos on
+// |x| <= 2 pi, exp on |x| <= 20 and log on all normal numbers:
+//
+//            sin/cos (abs)   exp (rel)   log (abs or rel)
+//   kLow     5e-7            4e-6        2e-6
+//   kMedium  1e-11           1e-11       3e-11
+//   kHigh    5e-16           5e-15       5e-16
+//
+// The range reductions subtract a two-part constant, which -fassociative-math
+// (part of the -ffast-math release flags) folds back into one. That adds up to
+// |x| * 1.2e-16 to the errors of sin/cos and exp for large arguments.
+enum class Accuracy { kLow, kMedium, kHigh };
+
+namespace fast_math_internal {
+
+// c[0] + c[1] x + ... + c[N-1] x^(N-1)
+template <int N>
+inline double Polynomial(const double x, const double *c) {
+  double p = c[N - 1];
+  for (int i = N - 2; i >= 0; i--) {
+    p = p * x + c[i];
+  }
+  return p;
+}
+
+// Taylor coefficients of sin(r)/r and cos(r) in r^2.
+constexpr double kSin[] = {1.0,           -1.0 / 6,          1.0 / 120,           -1.0 / 5040,
+                           1.0 / 362880,  -1.0 / 39916800,   1.0 / 6227020800,    -1.0 / 1307674368000};
+constexpr double kCos[] = {1.0,         -1.0 / 2,       1.0 / 24,           -1.0 / 720,          1.0 / 40320,
+                           -1.0 / 3628800, 1.0 / 479001600, -1.0 / 87178291200, 1.0 / 20922789888000};
+// Taylor coefficients of exp(g).
+constexpr double kExp[] = {1.0,
+                           1.0,
+                           1.0 / 2,
+                           1.0 / 6,
+                           1.0 / 24,
+                           1.0 / 120,
+                           1.0 / 720,
+                           1.0 / 5040,
+                           1.0 / 40320,
+                           1.0 / 362880,
+                           1.0 / 3628800,
+                           1.0 / 39916800,
+                           1.0 / 479001600,
+                           1.0 / 6227020800};
+// atanh(s)/s in s^2.
+constexpr double kAtanh[] = {1.0,      1.0 / 3,  1.0 / 5,  1.0 / 7,  1.0 / 9,
+                             1.0 / 11, 1.0 / 13, 1.0 / 15, 1.0 / 17, 1.0 / 19};
+
+// Number of polynomial terms per accuracy level.
+template <Accuracy A>
+constexpr int kSinTerms = A == Accuracy::kLow ? 4 : A == Accuracy::kMedium ? 6 : 8;
+template <Accuracy A>
+constexpr int kCosTerms = A == Accuracy::kLow ? 5 : A == Accuracy::kMedium ? 7 : 9;
+template <Accuracy A>
+constexpr int kExpTerms = A == Accuracy::kLow ? 6 : A == Accuracy::kMedium ? 10 : 14;
+template <Accuracy A>
+constexpr int kAtanhTerms = A == Accuracy::kLow ? 3 : A == Accuracy::kMedium ? 6 : 10;
+
+// Cody-Waite split of pi/2 and ln(2): the high parts have enough trailing
+// zero bits that k * high is exact for the supported range of k.
+constexpr double kPiOver2High = 1.57079632673412561417e+00;
+constexpr double kPiOver2Low = 6.07710050650619224932e-11;
+constexpr double kLn2High = 6.93147180369123816490e-01;
+constexpr double kLn2Low = 1.90821492927058770002e-10;
+
+}  // namespace fast_math_internal
+
+// Round half away from zero, like std::round, for |x| < 2^31. Adding the
+// largest double below 0.5 instead of 0.5 keeps 0.49999999999999994 from
+// rounding up.
+inline int32_t FastRound(const double x) {
+  return static_cast<int32_t>(x + std::copysign(0.49999999999999994, x));
+}
+
+// Sine and cosine of `x`, for |x| < 1e6.
+template <Accuracy A = Accuracy::kMedium>
+inline void FastSinCos(const double x, double *s, double *c) {
+  using namespace fast_math_internal;
+  const auto k = FastRound(x * (2 / M_PI));
+  const auto kd = static_cast<double>(k);
+  const auto r = (x - kd * kPiOver2High) - kd * kPiOver2Low;
+  const auto r2 = r * r;
+  const auto sin_r = r * Polynomial<kSinTerms<A>>(r2, kSin);
+  const auto cos_r = Polynomial<kCosTerms<A>>(r2, kCos);
+
+  // Quadrant k mod 4: swap for odd quadrants, flip the signs in the lower
+  // half-plane (sine) and the left half-plane (cosine).
+  const auto swap = (k & 1) != 0;
+  const auto sin_sign = (k & 2) != 0 ? -1.0 : 1.0;
+  const auto cos_sign = ((k + 1) & 2) != 0 ? -1.0 : 1.0;
+  *s = sin_sign * (swap ? cos_r : sin_r);
+  *c = cos_sign * (swap ? sin_r : cos_r);
+}
+
+// e^x, for |x| < 708.
+template <Accuracy A = Accuracy::kMedium>
+inline double FastExp(const double x) {
+  using namespace fast_math_internal;
+  const auto k = FastRound(x * M_LOG2E);
+  const auto kd = static_cast<double>(k);
+  const auto g = (x - kd * kLn2High) - kd * kLn2Low;
+  const auto bits = static_cast<uint64_t>(static_cast<int64_t>(k) + 1023) << 52;
+  double scale;
+  memcpy(&scale, &bits, sizeof(scale));
+  return Polynomial<kExpTerms<A>>(g, kExp) * scale;
+}
+
+// Natural logarithm, for positive normal `x`. With x = m 2^e and m in
+// [sqrt(1/2), sqrt(2)), log(m) = 2 atanh((m - 1) / (m + 1)).
+template <Accuracy A = Accuracy::kMedium>
+inline double FastLog(const double x) {
+  using namespace fast_math_internal;
+  uint64_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  // Offsetting by the bits of sqrt(1/2) centers the mantissa range on 1.
+  constexpr uint64_t kSqrtHalfBits = 0x3fe6a09e667f3bcdull;
+  const auto e = static_cast<int32_t>(static_cast<int64_t>(bits - kSqrtHalfBits) >> 52);
+  const auto mantissa_bits = bits - (static_cast<uint64_t>(static_cast<int64_t>(e)) << 52);
+  double m;
+  memcpy(&m, &mantissa_bits, sizeof(m));
+
+  const auto s = (m - 1) / (m + 1);
+  const auto ed = static_cast<double>(e);
+  return ed * kLn2High + (2 * s * Polynomial<kAtanhTerms<A>>(s * s, kAtanh) + ed * kLn2Low);
+}
+
+// Weights of a unit-variance Gaussian splat over the three pixels around the
+// nearest one, i.e. exp(-(f + 1 - i)^2 / 2) for i = 0, 1, 2, where f is the
+// offset of the sample from the nearest pixel center, in [-0.5, 0.5]. The
+// kernel is separable, so a 3x3 splat needs two lookups instead of nine exp
+// calls. Linear interpolation in a 256-interval table is within 2e-6.
+inline void GaussianSplatWeights(const double f, double w[3]) {
+  constexpr int kIntervals = 256;
+  struct Table {
+    Table() {
+      for (int i = 0; i <= kIntervals; i++) {
+        const auto offset = static_cast<double>(i) / kIntervals - 0.5;
+        for (int k = 0; k < 3; k++) {
+          const auto d = offset + 1 - k;
+          weights_[i][k] = std::exp(-d * d * .5);
+        }
+      }
+    }
+    double weights_[kIntervals + 1][3];
+  };
+  static const Table table;
+
+  const auto position = (f + 0.5) * kIntervals;
+  const auto i = static_cast<int>(std::fmin(std::fmax(position, 0.0), kIntervals - 1.0));
+  const auto t = position - i;
+  for (int k = 0; k < 3; k++) {
+    w[k] = table.weights_[i][k] + t * (table.weights_[i + 1][k] - table.weights_[i][k]);
+  }
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+namespace RayTracer2D {
+
+// SplitMix64 finalizer: a cheap, well mixed 64-bit hash.
+inline uint64_t Hash64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+inline uint64_t HashCombine(uint64_t seed, uint64_t value) {
+  return Hash64(seed ^ Hash64(value));
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace RayTracer2D {
+
+// Resolve a requested thread count, 0 meaning every available core.
+inline int ResolveThreads(const size_t requested) {
+#ifdef _OPENMP
+  return requested == 0 ? omp_get_max_threads() : static_cast<int>(requested);
+#else
+  (void)requested;
+  return 1;
+#endif
+}
+
+// Index of the calling thread inside the current parallel region.
+inline int ThreadIndex() {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include "utils/hash.h"
+
+namespace RayTracer2D {
+
+// Random engine shared by every sampler running on the calling thread. Keeping
+// the engine out of the materials and lights means they carry no per-instance
+// generator state and can be shared across shapes and threads.
+inline std::mt19937 &ThreadLocalGenerator() {
+  thread_local std::mt19937 gen(std::random_device{}());
+  return gen;
+}
+
+// Uniform numbers in [0, 1) that only depend on the seed, for steps that need
+// an unbounded number of draws (e.g. tracking through a medium) but must stay
+// reproducible whichever thread runs them.
+class HashStream {
+ public:
+  explicit HashStream(const uint64_t seed) : seed_(seed) {}
+
+  double Next() {
+    return static_cast<double>(Hash64(seed_ + counter_++) >> 11) * 0x1.0p-53;
+  }
+
+ private:
+  uint64_t seed_;
+  uint64_t counter_{0};
+};
+
+}  // namespace RayTracer2D
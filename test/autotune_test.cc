@@ -0,0 +1,83 @@
+#include "core/autotune.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+#include "utils/parallel.h"
+#include "test_scene.h"
+
+namespace RayTracer2D {
+
+TEST(AutotuneTest, FingerprintFollowsTheScene) {
+  auto option = Options(256, 256, 1000, 6);
+  auto fingerprint = SceneFingerprint(option, MakeDefaultTracer);
+  EXPECT_EQ(SceneFingerprint(option, MakeDefaultTracer), fingerprint);
+  // The image settings are part of the cache key, not of the scene.
+  option.sx_ = 512;
+  option.accumulator_ = AccumulatorFormat::kFixed64;
+  EXPECT_EQ(SceneFingerprint(option, MakeDefaultTracer), fingerprint);
+
+  option.lambertian_ = true;
+  EXPECT_NE(SceneFingerprint(option, MakeDefaultTracer), fingerprint);
+  option.lambertian_ = false;
+  option.fog_density_ = 0.5;
+  EXPECT_NE(SceneFingerprint(option, MakeDefaultTracer), fingerprint);
+}
+
+TEST(AutotuneTest, CachedResultIsReused) {
+  auto option = Options(128, 128, 20000, 4);
+  option.autotune_cache_ = testing::TempDir() + "autotune_test.cache";
+  std::remove(option.autotune_cache_.c_str());
+
+  auto tuned = Autotune(option, MakeDefaultTracer, 0.002);
+  EXPECT_FALSE(tuned.cached_);
+  EXPECT_GT(tuned.threads_, 0u);
+  EXPECT_GT(tuned.rays_per_second_, 0);
+
+  auto again = Autotune(option, MakeDefaultTracer, 0.002);
+  EXPECT_TRUE(again.cached_);
+  EXPECT_EQ(again.threads_, tuned.threads_);
+  EXPECT_EQ(again.batch_size_, tuned.batch_size_);
+  EXPECT_EQ(again.tile_size_, tuned.tile_size_);
+  EXPECT_EQ(again.deferred_, tuned.deferred_);
+
+  // Another scene gets an entry of its own next to the first one.
+  option.lambertian_ = true;
+  EXPECT_FALSE(Autotune(option, MakeDefaultTracer, 0.002).cached_);
+  option.lambertian_ = false;
+  EXPECT_TRUE(Autotune(option, MakeDefaultTracer, 0.002).cached_);
+
+  std::ifstream file(option.autotune_cache_);
+  size_t lines = 0;
+  for (std::string line; std::getline(file, line);) {
+    lines++;
+  }
+  EXPECT_EQ(lines, 2u);
+  std::remove(option.autotune_cache_.c_str());
+}
+
+// Applied parameters select the render path the way calibration measured
+// it: one thread stays direct, more threads splat deferred into a double
+// accumulator and straight into a fixed-point one.
+TEST(AutotuneTest, TunedThreadsSelectTheRenderPath) {
+  if (ResolveThreads(2) == 1) {
+    GTEST_SKIP() << "built without OpenMP";
+  }
+  auto option = Options(64, 64, 1000, 4);
+  auto tuned = TunedParameters{1, 1024, 32, false, 0, false};
+  tuned.ApplyTo(option);
+  EXPECT_EQ(MakeDefaultTracer(option)->SelectPath(option.threads_), RenderPath::kDirect);
+  tuned.threads_ = 2;
+  tuned.ApplyTo(option);
+  EXPECT_EQ(MakeDefaultTracer(option)->SelectPath(option.threads_), RenderPath::kDeferred);
+  option.accumulator_ = AccumulatorFormat::kFixed64;
+  EXPECT_EQ(MakeDefaultTracer(option)->SelectPath(option.threads_), RenderPath::kShared);
+  tuned.deferred_ = true;
+  tuned.ApplyTo(option);
+  EXPECT_EQ(MakeDefaultTracer(option)->SelectPath(option.threads_), RenderPath::kDeferred);
+}
+
+}  // namespace RayTracer2D
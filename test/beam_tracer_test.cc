@@ -0,0 +1,141 @@
+#include "core/beam_tracer.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "core/light.h"
+#include "core/options.h"
+#include "core/ray_tracer.h"
+#include "core/scene.h"
+#include "core/transform.h"
+#include "light/laser_light.h"
+#include "light/point_light.h"
+#include "material/reflective.h"
+#include "material/scattering.h"
+#include "utils/constants.h"
+#include "test_scene.h"
+
+namespace RayTracer2D {
+
+// A box of mirrors with one white wall, a tilted mirror and a white ball.
+static auto MakeRayTracer(const Options &option, std::unique_ptr<Light> light) -> std::unique_ptr<RayTracer> {
+  auto scene = std::make_unique<Scene>();
+  auto white = scene->AddMaterial<ScatteringMaterial>();
+  auto mirror = scene->AddMaterial<ReflectiveMaterial>();
+  scene->AddWall(kTopLeft, kTopRight, mirror);
+  scene->AddWall(kTopRight, kBottomRight, mirror);
+  scene->AddWall(kBottomRight, kBottomLeft, white);
+  scene->AddWall(kBottomLeft, kTopLeft, mirror);
+  scene->AddWall(Point2d(0.5, -1.5), Point2d(1.5, -0.2), mirror);
+  scene->AddCircle(Point2d(-1, 1), 0.3, white);
+  return std::make_unique<RayTracer>(option, std::move(scene), std::move(light));
+}
+
+// A laser beam carries all rays along its mirror bounces, then hands them over
+// at the first white surface: the same image as tracing every ray.
+TEST(BeamTracerTest, LaserMatchesRays) {
+  auto option = Options(80, 80, 2000, 6);
+  auto light = [] {
+    return std::make_unique<LaserLight>(Point2d(0.3, 0.1), Point2d(0.6, 1).Normalize(), Colour(1, 1, 1));
+  };
+  auto rays = MakeRayTracer(option, light());
+  rays->Render(1);
+  option.beams_ = true;
+  auto beams = MakeRayTracer(option, light());
+  ASSERT_TRUE(BeamTracer::Supports(*beams));
+  auto tracer = BeamTracer(*beams);
+  tracer.Render(1);
+  EXPECT_EQ(tracer.rays(), option.num_rays_);
+
+  auto expected = ReadPixels(rays->image_);
+  auto actual = ReadPixels(beams->image_);
+  for (size_t i = 0; i < expected.size(); i++) {
+    ASSERT_NEAR(actual[i], expected[i], 1e-9 * (1 + expected[i])) << i;
+  }
+}
+
+// Wedges of a point light integrate what many rays only sample: 8x8 pixel
+// blocks agree with a dense ray render.
+TEST(BeamTracerTest, PointLightConvergesToRays) {
+  auto option = Options(64, 64, 400000, 4);
+  auto light = [] { return std::make_unique<PointLight>(Point2d(-0.4, 0.3), Colour(1, 1, 1)); };
+  auto rays = MakeRayTracer(option, light());
+  rays->Render(1);
+  option.beams_ = true;
+  auto beams = MakeRayTracer(option, light());
+  auto tracer = BeamTracer(*beams);
+  tracer.Render(1);
+  EXPECT_GT(tracer.wedges(), 4u);
+  EXPECT_LT(tracer.rays(), option.num_rays_ * 3 / 4);
+
+  auto expected = ReadPixels(rays->image_);
+  auto actual = ReadPixels(beams->image_);
+  constexpr size_t kBlock = 8;
+  double worst = 0, expected_total = 0, actual_total = 0;
+  for (size_t by = 0; by < option.sy_; by += kBlock) {
+    for (size_t bx = 0; bx < option.sx_; bx += kBlock) {
+      double e = 0, a = 0;
+      for (size_t y = by; y < by + kBlock; y++) {
+        for (size_t x = bx; x < bx + kBlock; x++) {
+          e += expected[(y * option.sx_ + x) * 3];
+          a += actual[(y * option.sx_ + x) * 3];
+        }
+      }
+      worst = std::max(worst, std::abs(a - e) / e);
+      expected_total += e;
+      actual_total += a;
+    }
+  }
+  EXPECT_LT(worst, 0.015);
+  EXPECT_NEAR(actual_total, expected_total, 0.005 * expected_total);
+}
+
+// Rows of a wedge and handed over rays are shared out between threads: the
+// image is the one rendered on a single thread, up to the order of the sums.
+TEST(BeamTracerTest, RendersOnTheGivenThreads) {
+  auto option = Options(64, 64, 20000, 4);
+  option.beams_ = true;
+  option.batch_size_ = 4096;
+  auto light = [] { return std::make_unique<PointLight>(Point2d(-0.4, 0.3), Colour(1, 1, 1)); };
+  auto one = MakeRayTracer(option, light());
+  auto single = BeamTracer(*one);
+  single.Render(1);
+  auto three = MakeRayTracer(option, light());
+  auto parallel = BeamTracer(*three);
+  parallel.Render(3);
+  EXPECT_GT(parallel.rays(), 0u);
+  EXPECT_EQ(parallel.rays(), single.rays());
+  EXPECT_EQ(parallel.wedges(), single.wedges());
+
+  auto expected = ReadPixels(one->image_);
+  auto actual = ReadPixels(three->image_);
+  for (size_t i = 0; i < expected.size(); i++) {
+    ASSERT_NEAR(actual[i], expected[i], 1e-9 * (1 + std::abs(expected[i]))) << i;
+  }
+}
+
+// Wedges only know circles and walls: a scene with a prototype instance is
+// traced with rays, as if beams had not been asked for.
+TEST(BeamTracerTest, InstancesFallBackToRays) {
+  auto make = [](const Options &option) {
+    auto scene = std::make_unique<Scene>();
+    auto white = scene->AddMaterial<ScatteringMaterial>();
+    auto mirror = scene->AddMaterial<ReflectiveMaterial>();
+    AddBox(scene.get(), white);
+    auto *prototype = scene->AddPrototype();
+    prototype->AddCircle(Point2d(0, 0), 0.3, mirror);
+    scene->AddInstance(prototype, Affine2d::Translation(Point2d(1, 0.5)));
+    return MakeRayTracer(option, std::move(scene), Point2d(-0.4, 0.3));
+  };
+  auto option = Options(64, 64, 2000, 4);
+  auto rays = make(option);
+  rays->Render(1);
+  option.beams_ = true;
+  auto beams = make(option);
+  EXPECT_FALSE(BeamTracer::Supports(*beams));
+  EXPECT_EQ(beams->SelectPath(1), RenderPath::kDirect);
+  beams->Render(1);
+  EXPECT_EQ(ReadPixels(beams->image_), ReadPixels(rays->image_));
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,124 @@
+#include "core/detector.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+#include "core/scene_file.h"
+
+namespace RayTracer2D {
+
+// A white box with a mirror ball, a laser shining straight at the bottom wall
+// (shape 1) and a detector on every wall and on the ball.
+static const char *kScene =
+    "material white scattering\n"
+    "material mirror reflective\n"
+    "wall -2 -2 -2 2 white\n"
+    "wall -2 2 2 2 white\n"
+    "wall 2 2 2 -2 white\n"
+    "wall 2 -2 -2 -2 white\n"
+    "circle 1 -1 0.5 mirror\n"
+    "light laser 0.5 0 0 1 1 0.5 0.25\n"
+    "detector 1 8 5\n"
+    "detector 0 4 4\n"
+    "detector 2 4 4\n"
+    "detector 3 4 4\n"
+    "detector 4 16 3\n";
+
+static auto Load(SceneDescription &description) -> bool {
+  std::istringstream is(kScene);
+  return ParseSceneDescription(is, "test", description);
+}
+
+// Fill detectors with the paths of `rt`, through one of the propagation loops.
+static auto Measure(RayTracer &rt, const SceneDescription &description, const bool closed)
+    -> std::unique_ptr<DetectorSet> {
+  auto detectors = std::make_unique<DetectorSet>(*rt.scene_, description.detectors_, 1);
+  rt.SetDetectors(detectors.get());
+  for (size_t i = 0; i < rt.option_.num_rays_; i++) {
+    if (closed) {
+      rt.PropagateRayClosed(rt.EmitRay(i), rt.option_.depth_);
+    } else {
+      rt.PropagateRayDynamic(rt.EmitRay(i), rt.option_.depth_);
+    }
+  }
+  rt.SetDetectors(nullptr);
+  return detectors;
+}
+
+TEST(DetectorTest, ParsesDetectors) {
+  auto description = SceneDescription{};
+  ASSERT_TRUE(Load(description));
+  ASSERT_EQ(description.detectors_.size(), 5u);
+  EXPECT_EQ(description.detectors_[0].position_bins_, 8u);
+  EXPECT_EQ(description.detectors_[0].angle_bins_, 5u);
+  auto parse = [](const char *text) {
+    std::istringstream is(text);
+    auto description = SceneDescription{};
+    return ParseSceneDescription(is, "test", description);
+  };
+  EXPECT_FALSE(parse("material m reflective\ncircle 0 0 1 m\ndetector 1 4 4\nlight point 0 0 1 1 1\n"));
+  EXPECT_FALSE(parse("material m reflective\ncircle 0 0 1 m\ndetector 0 0 4\nlight point 0 0 1 1 1\n"));
+  EXPECT_FALSE(parse("material m reflective\ncircle 0 0 1 m\ndetector 0 4 4\ndetector 0 2 2\nlight point 0 0 1 1 1\n"));
+}
+
+// The laser hits the bottom wall head on, at 5/8 of its length.
+TEST(DetectorTest, BinsFirstHit) {
+  auto description = SceneDescription{};
+  ASSERT_TRUE(Load(description));
+  auto option = Options(64, 64, 100, 1);
+  auto rt = RayTracer(option, BuildScene(description), BuildLight(description));
+  auto detectors = Measure(rt, description, kClosedSetDispatch);
+  EXPECT_EQ(detectors->Hits(0), 100u);
+  const auto bins = detectors->Bins(0);
+  const auto hit = 3 * (5 * 5 + 2);
+  EXPECT_DOUBLE_EQ(bins[hit], 100);
+  EXPECT_DOUBLE_EQ(bins[hit + 1], 50);
+  EXPECT_DOUBLE_EQ(bins[hit + 2], 25);
+  double total = 0;
+  for (auto v : bins) {
+    total += v;
+  }
+  EXPECT_DOUBLE_EQ(total, 175);
+}
+
+// Both propagation loops feed the detectors alike, and skipping the image
+// changes nothing to the light.
+TEST(DetectorTest, DetectorsOnlyMatchesImageRender) {
+  auto description = SceneDescription{};
+  ASSERT_TRUE(Load(description));
+  auto option = Options(64, 64, 5000, 5);
+  auto with_image = RayTracer(option, BuildScene(description), BuildLight(description));
+  auto dynamic = Measure(with_image, description, false);
+  auto closed = Measure(with_image, description, true);
+
+  option.detectors_only_ = true;
+  option.progress_ = false;
+  auto without_image = RayTracer(option, BuildScene(description), BuildLight(description));
+  EXPECT_EQ(without_image.image_.data_, nullptr);
+  // Sized for one thread, the histograms grow when the render starts on more.
+  auto detectors = DetectorSet(*without_image.scene_, description.detectors_, 1);
+  without_image.SetDetectors(&detectors);
+  without_image.Render(3);
+
+  uint64_t hits = 0;
+  for (size_t d = 0; d < description.detectors_.size(); d++) {
+    EXPECT_EQ(closed->Hits(d), dynamic->Hits(d));
+    EXPECT_EQ(detectors.Hits(d), dynamic->Hits(d));
+    const auto expected = dynamic->Bins(d);
+    const auto actual = detectors.Bins(d);
+    const auto actual_closed = closed->Bins(d);
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_NEAR(actual_closed[i], expected[i], 1e-9 * (1 + expected[i]));
+      // Threads add in another order.
+      EXPECT_NEAR(actual[i], expected[i], 1e-9 * (1 + expected[i]));
+    }
+    hits += detectors.Hits(d);
+  }
+  // Every bounce of every path hits one of the detectors.
+  EXPECT_EQ(hits, option.num_rays_ * option.depth_);
+}
+
+}  // namespace RayTracer2D
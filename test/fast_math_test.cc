@@ -0,0 +1,114 @@
+#include "utils/fast_math.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace RayTracer2D {
+
+// Largest error of `fast` against `reference` over `count` samples of
+// `sample()`, relative to max(|reference|, `floor`).
+template <typename Sample, typename Fast, typename Reference>
+static double MaxError(Sample sample, Fast fast, Reference reference, double floor = 1.0, int count = 200000) {
+  double error = 0;
+  for (int i = 0; i < count; i++) {
+    auto x = sample();
+    auto expected = reference(x);
+    error = std::max(error, std::abs(fast(x) - expected) / std::max(std::abs(expected), floor));
+  }
+  return error;
+}
+
+class FastMathTest : public ::testing::Test {
+ protected:
+  double Uniform(double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(gen_); }
+
+  template <Accuracy A>
+  double SinCosError(double range) {
+    auto sample = [&] { return Uniform(-range, range); };
+    auto sin_error = MaxError(
+        sample,
+        [](double x) {
+          double s, c;
+          FastSinCos<A>(x, &s, &c);
+          return s;
+        },
+        [](double x) { return std::sin(x); });
+    auto cos_error = MaxError(
+        sample,
+        [](double x) {
+          double s, c;
+          FastSinCos<A>(x, &s, &c);
+          return c;
+        },
+        [](double x) { return std::cos(x); });
+    return std::max(sin_error, cos_error);
+  }
+
+  template <Accuracy A>
+  double ExpError(double range) {
+    return MaxError([&] { return Uniform(-range, range); }, FastExp<A>, [](double x) { return std::exp(x); }, 0);
+  }
+
+  // Absolute error near 1, where log crosses zero, relative elsewhere.
+  template <Accuracy A>
+  double LogError() {
+    auto near_one = MaxError([&] { return Uniform(0.5, 2); }, FastLog<A>, [](double x) { return std::log(x); });
+    auto wide = MaxError([&] { return std::exp2(Uniform(-1000, 1000)); }, FastLog<A>,
+                         [](double x) { return std::log(x); });
+    return std::max(near_one, wide);
+  }
+
+  std::mt19937 gen_{42};
+};
+
+TEST_F(FastMathTest, RoundMatchesStd) {
+  for (double x : {0.0, 0.5, -0.5, 1.5, -1.5, 2.5, -2.5, 0.49999999999999994, -0.49999999999999994, 1e9 + 0.5,
+                   4095.5, -4095.5, 2147483646.5}) {
+    EXPECT_EQ(FastRound(x), static_cast<int32_t>(std::round(x))) << x;
+  }
+  for (int i = 0; i < 200000; i++) {
+    auto x = Uniform(-70000, 70000);
+    ASSERT_EQ(FastRound(x), static_cast<int32_t>(std::round(x))) << x;
+  }
+}
+
+TEST_F(FastMathTest, SinCosErrorBound) {
+  EXPECT_LT(SinCosError<Accuracy::kLow>(2 * M_PI), 5e-7);
+  EXPECT_LT(SinCosError<Accuracy::kMedium>(2 * M_PI), 1e-11);
+  EXPECT_LT(SinCosError<Accuracy::kHigh>(2 * M_PI), 5e-16);
+  // Range reduction stays accurate far from the origin, up to the folding of
+  // the two-part constant under -ffast-math.
+  EXPECT_LT(SinCosError<Accuracy::kHigh>(1e5), 2e-11);
+}
+
+TEST_F(FastMathTest, ExpErrorBound) {
+  EXPECT_LT(ExpError<Accuracy::kLow>(20), 4e-6);
+  EXPECT_LT(ExpError<Accuracy::kMedium>(20), 1e-11);
+  EXPECT_LT(ExpError<Accuracy::kHigh>(20), 5e-15);
+  EXPECT_LT(ExpError<Accuracy::kHigh>(700), 1e-13);
+  EXPECT_EQ(FastExp<Accuracy::kHigh>(0), 1.0);
+}
+
+TEST_F(FastMathTest, LogErrorBound) {
+  EXPECT_LT(LogError<Accuracy::kLow>(), 2e-6);
+  EXPECT_LT(LogError<Accuracy::kMedium>(), 3e-11);
+  EXPECT_LT(LogError<Accuracy::kHigh>(), 5e-16);
+  EXPECT_EQ(FastLog<Accuracy::kHigh>(1), 0.0);
+}
+
+TEST_F(FastMathTest, GaussianSplatWeights) {
+  double w[3];
+  for (int i = 0; i < 100000; i++) {
+    auto f = Uniform(-0.5, 0.5);
+    GaussianSplatWeights(f, w);
+    for (int k = 0; k < 3; k++) {
+      auto d = f + 1 - k;
+      ASSERT_NEAR(w[k], std::exp(-d * d * .5), 2e-6) << f;
+    }
+  }
+  GaussianSplatWeights(0.5, w);
+  EXPECT_NEAR(w[2], std::exp(-0.125), 1e-15);
+}
+
+}  // namespace RayTracer2D
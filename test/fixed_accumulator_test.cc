@@ -0,0 +1,117 @@
+#include "core/fixed_accumulator.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "core/colour.h"
+#include "core/options.h"
+#include "core/ray_tracer.h"
+
+namespace RayTracer2D {
+
+TEST(FixedPointAccumulatorTest, RoundsToFractionBits) {
+  for (auto bits : {32, 64}) {
+    auto accumulator = FixedPointAccumulator(4, 2, bits, 10);
+    accumulator.Add(1, 1, Colour(0.5, 1.0 / 3, 0));
+    accumulator.Add(1, 1, Colour(0.25, 1.0 / 3, 1));
+    auto row = std::vector<double>(12);
+    accumulator.ReadRow(1, row.data());
+    EXPECT_EQ(row[3], 0.75);
+    EXPECT_NEAR(row[4], 2.0 / 3, 1.0 / 1024);
+    EXPECT_EQ(row[5], 1.0);
+    EXPECT_EQ(row[0], 0.0);
+    EXPECT_EQ(accumulator.Bytes(), 4 * 2 * 3 * static_cast<size_t>(bits / 8));
+  }
+}
+
+// Integer adds commute, so concurrent splats into one cell sum exactly.
+TEST(FixedPointAccumulatorTest, ConcurrentAddsAreExact) {
+  auto accumulator = FixedPointAccumulator(1, 1, 64, 32);
+  auto threads = std::vector<std::thread>();
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 100000; i++) {
+        accumulator.Add(0, 0, Colour(0.1, 0.2, 0.3));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double row[3];
+  accumulator.ReadRow(0, row);
+  EXPECT_EQ(row[0], 400000 * std::round(0.1 * 4294967296.0) / 4294967296.0);
+  EXPECT_EQ(row[2], 400000 * std::round(0.3 * 4294967296.0) / 4294967296.0);
+}
+
+// Out of range contributions are clamped rather than converted with
+// undefined behaviour, and sums past 2^20 with 12 fraction bits saturate
+// instead of wrapping around to a dark pixel.
+TEST(FixedPointAccumulatorTest, ClampsAndSaturates) {
+  auto accumulator = FixedPointAccumulator(2, 1, 32, 12);
+  const auto max = 4294967295.0 / 4096;
+  accumulator.Add(1, 0, Colour(-1, NAN, 1e30));
+  for (int i = 0; i < 1100; i++) {
+    accumulator.Add(0, 0, Colour(1000, 1, 0));
+  }
+  double row[6];
+  accumulator.ReadRow(0, row);
+  EXPECT_EQ(row[0], max);
+  EXPECT_EQ(row[1], 1100.0);
+  EXPECT_EQ(row[3], 0.0);
+  EXPECT_EQ(row[4], 0.0);
+  EXPECT_EQ(row[5], max);
+
+  auto wide = FixedPointAccumulator(1, 1, 64, 32);
+  wide.Add(0, 0, Colour(1e30, -1e30, 1));
+  wide.ReadRow(0, row);
+  EXPECT_EQ(row[0], 18446744073709551615.0 / 4294967296.0);
+  EXPECT_EQ(row[1], 0.0);
+  EXPECT_EQ(row[2], 1.0);
+}
+
+// Once saturated, a cell stays saturated whichever thread overflowed it.
+TEST(FixedPointAccumulatorTest, ConcurrentAddsSaturate) {
+  auto accumulator = FixedPointAccumulator(1, 1, 32, 12);
+  auto threads = std::vector<std::thread>();
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 100000; i++) {
+        accumulator.Add(0, 0, Colour(4, 0, 0));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double row[3];
+  accumulator.ReadRow(0, row);
+  EXPECT_EQ(row[0], 4294967295.0 / 4096);
+}
+
+// The frame does not depend on how the rays were spread over the threads.
+TEST(FixedPointAccumulatorTest, RenderIsBitIdenticalAcrossThreadCounts) {
+  auto option = Options(128, 128, 4000, 8);
+  option.accumulator_ = AccumulatorFormat::kFixed32;
+  option.batch_size_ = 1000;
+  auto serial = RayTracer(option);
+  auto shared = RayTracer(option);
+  serial.Render(1);
+  shared.Render(4);
+
+  auto expected = std::vector<double>(option.sx_ * 3);
+  auto actual = std::vector<double>(option.sx_ * 3);
+  double total = 0;
+  for (size_t y = 0; y < option.sy_; y++) {
+    serial.image_.ReadRow(y, expected.data());
+    shared.image_.ReadRow(y, actual.data());
+    ASSERT_EQ(expected, actual) << "row " << y;
+    for (auto v : expected) {
+      total += v;
+    }
+  }
+  EXPECT_GT(total, 0);
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,75 @@
+#include "core/incremental.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+#include "core/scene.h"
+#include "light/point_light.h"
+#include "material/reflective.h"
+#include "material/scattering.h"
+#include "utils/constants.h"
+#include "test_scene.h"
+
+namespace RayTracer2D {
+
+// A point light in a box with a mirror ball and a small white ball; the
+// second scene has the white ball moved and the mirror turned white.
+static auto MakeRayTracer(const Options &option, bool edited) -> std::unique_ptr<RayTracer> {
+  auto scene = std::make_unique<Scene>();
+  auto white = scene->AddMaterial<ScatteringMaterial>();
+  auto mirror = scene->AddMaterial<ReflectiveMaterial>();
+  scene->AddCircle(Point2d(1, 1), 0.5, edited ? white : mirror);
+  scene->AddCircle(edited ? Point2d(-1.2, 1.3) : Point2d(-1, 1.5), 0.1, white);
+  AddBox(scene.get(), white);
+  return MakeRayTracer(option, std::move(scene), Point2d(-0.5, 0.2));
+}
+
+TEST(IncrementalTest, UpdateMatchesFullRender) {
+  for (auto deferred : {false, true}) {
+    auto option = Options(96, 96, 4000, 4);
+    option.deferred_ = deferred;
+    option.threads_ = 2;
+    auto rt = MakeRayTracer(option, false);
+    auto incremental = IncrementalRenderer(*rt);
+    incremental.Render();
+
+    // Only the paths hitting the small ball change with its material.
+    auto white = rt->scene_->shape(2)->material_id();
+    auto mirror = rt->scene_->shape(0)->material_id();
+    auto mirrored = incremental.Update({SceneEdit{1, mirror}});
+    EXPECT_GT(mirrored, 0u);
+    EXPECT_LT(mirrored, option.num_rays_ / 4);
+    auto retraced = incremental.Update({SceneEdit{0, white}, SceneEdit{1, white, Point2d(-0.2, -0.2)}});
+    EXPECT_LT(retraced, option.num_rays_);
+
+    auto fresh = MakeRayTracer(option, true);
+    fresh->Render();
+    auto expected = ReadPixels(fresh->image_);
+    auto actual = ReadPixels(rt->image_);
+    double total = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+      ASSERT_NEAR(actual[i], expected[i], 1e-9 * (1 + expected[i])) << i << (deferred ? " deferred" : "");
+      total += expected[i];
+    }
+    EXPECT_GT(total, 0);
+  }
+}
+
+// A segment marks the cells it crosses, parts outside the world marking the
+// border cells.
+TEST(IncrementalTest, SegmentCells) {
+  auto touches = PathTouches(Rect{-2, -2, 2, 2}, 1);
+  auto cell = [](int x, int y) { return uint64_t{1} << (y * PathTouches::kGrid + x); };
+  EXPECT_EQ(touches.SegmentCells(Point2d(-1.9, -1.9), Point2d(-1.6, -1.6)), cell(0, 0));
+  EXPECT_EQ(touches.SegmentCells(Point2d(-1.9, -1.9), Point2d(-1.4, -1.9)), cell(0, 0) | cell(1, 0));
+  EXPECT_EQ(touches.SegmentCells(Point2d(-3, -1.9), Point2d(5, -1.9)), uint64_t{0xff});
+  auto diagonal = touches.SegmentCells(Point2d(-1.99, -1.99), Point2d(1.99, 1.99));
+  for (int i = 0; i < 8; i++) {
+    EXPECT_NE(diagonal & cell(i, i), 0u) << i;
+  }
+  EXPECT_EQ(touches.RectCells(Rect{-1.1, -1.1, -0.9, -0.9}), cell(1, 1) | cell(1, 2) | cell(2, 1) | cell(2, 2));
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,167 @@
+#include "shapes/instance.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+#include "core/scene.h"
+#include "core/transform.h"
+#include "light/point_light.h"
+#include "material/reflective.h"
+#include "material/scattering.h"
+#include "utils/constants.h"
+#include "test_scene.h"
+
+namespace RayTracer2D {
+
+// Placements of a mirror ball next to a white wall, rotated by quarter turns.
+static auto Placements() -> std::vector<Affine2d> {
+  std::vector<Affine2d> placements;
+  const Affine2d quarter = {0, -1, 1, 0, Point2d(0, 0)};
+  auto rotation = Affine2d{};
+  for (int i = 0; i < 6; i++) {
+    placements.push_back(Affine2d::Translation(Point2d(-1.25 + 0.5 * i, i % 2 ? 1 : -1)) * rotation);
+    rotation = quarter * rotation;
+  }
+  return placements;
+}
+
+static auto MakeRayTracer(const Options &option, bool instanced) -> std::unique_ptr<RayTracer> {
+  auto scene = std::make_unique<Scene>();
+  auto white = scene->AddMaterial<ScatteringMaterial>();
+  auto mirror = scene->AddMaterial<ReflectiveMaterial>();
+  AddBox(scene.get(), white);
+  const auto center = Point2d(0.2, 0);
+  const auto begin = Point2d(-0.1, -0.2), end = Point2d(-0.1, 0.2);
+  auto *prototype = scene->AddPrototype();
+  prototype->AddCircle(center, 0.125, mirror);
+  prototype->AddWall(begin, end, white);
+  for (const auto &placement : Placements()) {
+    if (instanced) {
+      scene->AddInstance(prototype, placement);
+    } else {
+      scene->AddCircle(placement.Apply(center), 0.125, mirror);
+      scene->AddWall(placement.Apply(begin), placement.Apply(end), white);
+    }
+  }
+  return MakeRayTracer(option, std::move(scene), Point2d(0.1, 0.05));
+}
+
+TEST(InstanceTest, TransformsRoundTrip) {
+  const auto map = Affine2d::Translation(Point2d(1, -2)) * Affine2d::Rotation(0.3) * Affine2d::Scale(2, 0.5);
+  const auto p = Point2d(0.7, -0.4);
+  const auto q = map.Inverse().Apply(map.Apply(p));
+  EXPECT_NEAR(q.x, p.x, 1e-12);
+  EXPECT_NEAR(q.y, p.y, 1e-12);
+  EXPECT_NEAR(map.Determinant(), 1, 1e-12);
+}
+
+// A unit circle scaled into an ellipse with semi-axes 2 and 0.5: rays keep
+// their parameter, and normals follow the ellipse.
+TEST(InstanceTest, IntersectsScaledPrototype) {
+  auto scene = Scene();
+  auto mirror = scene.AddMaterial<ReflectiveMaterial>();
+  auto *prototype = scene.AddPrototype();
+  prototype->AddCircle(Point2d(0, 0), 1, mirror);
+  auto id = scene.AddInstance(prototype, Affine2d::Translation(Point2d(1, 1)) * Affine2d::Scale(2, 0.5));
+  const auto *ellipse = scene.shape(id);
+
+  auto ray = Ray(Point2d(1, -3), Point2d(0, 1), Colour(1, 1, 1));
+  auto t = ellipse->Intersect(ray);
+  ASSERT_TRUE(t.has_value());
+  EXPECT_NEAR(t.value(), 3.5, 1e-12);
+  auto n = ellipse->GetNormal(ray, ray(t.value()));
+  EXPECT_NEAR(n.x, 0, 1e-12);
+  EXPECT_NEAR(n.y, -1, 1e-12);
+
+  // At (1 + sqrt(2), 1 + sqrt(2) / 4) the normal of x^2/4 + y^2/0.25 = 1
+  // is along (x / 4, y / 0.25).
+  const auto p = Point2d(1 + std::sqrt(2.0), 1 + std::sqrt(2.0) / 4);
+  ray = Ray(p + Point2d(3, 0), Point2d(-1, 0), Colour(1, 1, 1));
+  t = ellipse->Intersect(ray);
+  ASSERT_TRUE(t.has_value());
+  EXPECT_NEAR(t.value(), 3, 1e-12);
+  n = ellipse->GetNormal(ray, ray(t.value()));
+  const auto expected = Point2d(std::sqrt(2.0) / 4, std::sqrt(2.0) / 4 / 0.25).Normalize();
+  EXPECT_NEAR(n.x, expected.x, 1e-12);
+  EXPECT_NEAR(n.y, expected.y, 1e-12);
+
+  EXPECT_FALSE(ellipse->Intersect(Ray(Point2d(4, -3), Point2d(0, 1), Colour(1, 1, 1))).has_value());
+  auto bounds = ellipse->Bounds();
+  ASSERT_TRUE(bounds.has_value());
+  EXPECT_DOUBLE_EQ(bounds->left_, -1);
+  EXPECT_DOUBLE_EQ(bounds->bottom_, 1.5);
+}
+
+// Every instance gets the normal and material of its own child shape, be it
+// the nearest hit of the ray, remembered from the hit test, or a farther one
+// or a miss, found again.
+TEST(InstanceTest, QueriesUseTheChildOfTheirInstance) {
+  auto scene = Scene();
+  auto white = scene.AddMaterial<ScatteringMaterial>();
+  auto mirror = scene.AddMaterial<ReflectiveMaterial>();
+  auto *prototype = scene.AddPrototype();
+  prototype->AddCircle(Point2d(0, 0), 0.5, mirror);
+  prototype->AddWall(Point2d(-0.8, -1), Point2d(-0.6, 1), white);
+  // The ray meets the wall of the first instance, and the circle of the
+  // second one, turned around.
+  auto *near = scene.shape(scene.AddInstance(prototype, Affine2d::Translation(Point2d(2, 0))));
+  const auto turned = Affine2d::Translation(Point2d(5, 0)) * Affine2d::Rotation(M_PI);
+  auto *far = scene.shape(scene.AddInstance(prototype, turned));
+
+  auto ray = Ray(Point2d(-1, 0), Point2d(1, 0), Colour(1, 1, 1));
+  auto t_near = near->Intersect(ray);
+  auto t_far = far->Intersect(ray);
+  ASSERT_TRUE(t_near.has_value() && t_far.has_value());
+  EXPECT_NEAR(t_near.value(), 2.3, 1e-12);
+  EXPECT_NEAR(t_far.value(), 5.5, 1e-12);
+
+  const auto wall_normal = Point2d(-2, 0.2).Normalize();
+  auto n = near->GetNormal(ray, ray(t_near.value()));
+  EXPECT_NEAR(n.x, wall_normal.x, 1e-12);
+  EXPECT_NEAR(n.y, wall_normal.y, 1e-12);
+  n = far->GetNormal(ray, ray(t_far.value()));
+  EXPECT_NEAR(n.x, -1, 1e-12);
+  EXPECT_NEAR(n.y, 0, 1e-12);
+  auto reflected = far->Interact(ray, ray(t_far.value()), n);
+  EXPECT_NEAR(reflected.d_.x, -1, 1e-12);
+  EXPECT_NEAR(reflected.d_.y, 0, 1e-12);
+
+  auto miss = Ray(Point2d(-1, 3), Point2d(1, 0), Colour(1, 1, 1));
+  EXPECT_FALSE(near->Intersect(miss).has_value());
+  n = near->GetNormal(miss, miss(1));
+  EXPECT_EQ(n.x, -1);
+  auto next = near->Interact(miss, miss(1), n);
+  EXPECT_EQ(next.p_.x, 0);
+  EXPECT_EQ(next.d_.x, 1);
+}
+
+// Instances render like separate copies of their prototype shapes.
+TEST(InstanceTest, InstancesMatchCopies) {
+  auto option = Options(128, 128, 20000, 6);
+  option.progress_ = false;
+  auto copies = MakeRayTracer(option, false);
+  auto instances = MakeRayTracer(option, true);
+  EXPECT_EQ(copies->scene_->size(), 4 + 2 * Placements().size());
+  EXPECT_EQ(instances->scene_->size(), 4 + Placements().size());
+  copies->Render(1);
+  instances->Render(1);
+
+  auto expected = ReadPixels(copies->image_);
+  auto actual = ReadPixels(instances->image_);
+  size_t matching = 0;
+  double expected_total = 0, actual_total = 0;
+  for (size_t i = 0; i < expected.size(); i++) {
+    matching += std::abs(actual[i] - expected[i]) <= 1e-6 * (1 + expected[i]);
+    expected_total += expected[i];
+    actual_total += actual[i];
+  }
+  EXPECT_GT(expected_total, 0);
+  // Paths mapped into the prototype round differently, a few of them end up
+  // elsewhere.
+  EXPECT_GT(matching, expected.size() * 0.99);
+  EXPECT_NEAR(actual_total, expected_total, 1e-3 * expected_total);
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,102 @@
+#include "core/material_registry.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+#include "core/scene.h"
+#include "light/point_light.h"
+#include "material/scattering.h"
+#include "utils/arena.h"
+#include "utils/constants.h"
+
+namespace RayTracer2D {
+
+// Logs its destruction into `log`.
+struct Tracked {
+  Tracked(std::vector<int> *log, int id) : log_(log), id_(id) {}
+  ~Tracked() {
+    log_->push_back(id_);
+  }
+  std::vector<int> *log_;
+  int id_;
+  // Large enough for a few objects to fill a small block.
+  char payload_[40];
+};
+
+class TrackedMaterial final : public Material {
+ public:
+  explicit TrackedMaterial(int *destroyed) : destroyed_(destroyed) {}
+  ~TrackedMaterial() override {
+    (*destroyed_)++;
+  }
+  // Back where the ray came from, so that it stays in the scene.
+  Ray Interact(const Ray &r, const Point2d &p, const Point2d &n) override {
+    (void)n;
+    return Ray(p, Point2d(-r.d_.x, -r.d_.y), r.colour_);
+  }
+
+ private:
+  int *destroyed_;
+};
+
+// Objects spread over several blocks are aligned, and destroyed exactly once
+// with the arena, in reverse order of creation.
+TEST(ArenaTest, DestroysObjectsInReverseOrder) {
+  std::vector<int> log;
+  {
+    auto arena = Arena(128);
+    for (int i = 0; i < 10; i++) {
+      auto *object = arena.Create<Tracked>(&log, i);
+      EXPECT_EQ(reinterpret_cast<uintptr_t>(object) % alignof(Tracked), 0u);
+      EXPECT_EQ(object->id_, i);
+      // Trivially destructible objects are not tracked at all.
+      arena.Create<double>(i);
+    }
+    EXPECT_GT(arena.BytesReserved(), 128u);
+    EXPECT_TRUE(log.empty());
+  }
+  ASSERT_EQ(log.size(), 10u);
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(log[i], 9 - i);
+  }
+}
+
+// Shapes referencing a material share the registry's single instance, also
+// through the tracer that takes the scene over; materials built in the arena
+// and adopted ones are both destroyed once with the scene.
+TEST(MaterialRegistryTest, ShapesShareMaterials) {
+  int destroyed = 0;
+  {
+    auto scene = std::make_unique<Scene>();
+    auto white = scene->AddMaterial<ScatteringMaterial>();
+    auto tracked = scene->AddMaterial<TrackedMaterial>(&destroyed);
+    auto adopted = scene->AddMaterial(std::make_unique<TrackedMaterial>(&destroyed));
+    EXPECT_NE(scene->material(white), scene->material(tracked));
+    scene->AddWall(kTopLeft, kTopRight, white);
+    scene->AddWall(kTopRight, kBottomRight, white);
+    scene->AddWall(kBottomRight, kBottomLeft, tracked);
+    scene->AddWall(kBottomLeft, kTopLeft, adopted);
+    scene->AddCircle(Point2d(0, 0), 0.5, tracked);
+    auto *white_material = scene->material(white);
+    auto *tracked_material = scene->material(tracked);
+
+    auto option = Options(64, 64, 100, 4);
+    option.progress_ = false;
+    auto rt = RayTracer(option, std::move(scene), std::make_unique<PointLight>(Point2d(1, 1), Colour(1, 1, 1)));
+    const auto &shapes = *rt.scene_;
+    EXPECT_EQ(shapes.shape(0)->material(), white_material);
+    EXPECT_EQ(shapes.shape(1)->material(), white_material);
+    EXPECT_EQ(shapes.shape(2)->material(), tracked_material);
+    EXPECT_EQ(shapes.shape(4)->material(), tracked_material);
+    EXPECT_EQ(shapes.shape(3)->material(), shapes.material(adopted));
+    EXPECT_EQ(shapes.shape(0)->material_id(), white);
+    EXPECT_EQ(shapes.shape(4)->material_id(), tracked);
+    rt.Render(1);
+    EXPECT_EQ(destroyed, 0);
+  }
+  EXPECT_EQ(destroyed, 2);
+}
+
+}  // namespace RayTracer2D
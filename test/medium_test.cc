@@ -0,0 +1,147 @@
+#include "core/medium.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "core/options.h"
+#include "core/path_recorder.h"
+#include "core/point.h"
+#include "core/ray.h"
+#include "core/ray_tracer.h"
+#include "core/scene.h"
+#include "light/point_light.h"
+#include "material/refractive.h"
+#include "material/scattering.h"
+#include "medium/grid_medium.h"
+#include "medium/homogeneous_medium.h"
+#include "utils/constants.h"
+#include "utils/random.h"
+#include "test_scene.h"
+
+namespace RayTracer2D {
+
+static constexpr int kNumFlights = 200000;
+
+// Fraction of `ray` flights that cross [t0, t1] without a collision, and the
+// mean collision distance of the others.
+static double Transmittance(const Medium &medium, const Ray &ray, double t0, double t1, double *mean_t = nullptr) {
+  int escaped = 0;
+  double sum_t = 0;
+  for (int i = 0; i < kNumFlights; i++) {
+    auto random = HashStream(i);
+    auto t = medium.SampleCollision(ray, t0, t1, random);
+    if (t.has_value()) {
+      EXPECT_GE(t.value(), t0);
+      EXPECT_LT(t.value(), t1);
+      sum_t += t.value();
+    } else {
+      escaped++;
+    }
+  }
+  if (mean_t != nullptr) {
+    *mean_t = sum_t / (kNumFlights - escaped);
+  }
+  return static_cast<double>(escaped) / kNumFlights;
+}
+
+// Three standard deviations of a fraction estimated from `kNumFlights` trials.
+static double Tolerance(double p) {
+  return 3 * std::sqrt(p * (1 - p) / kNumFlights) + 1e-4;
+}
+
+TEST(MediumTest, HomogeneousFreeFlight) {
+  auto medium = HomogeneousMedium(0.8, Colour(1, 1, 1));
+  auto ray = Ray(Point2d(0, 0), Point2d(0.6, 0.8), Colour(1, 1, 1));
+  double mean_t;
+  auto expected = std::exp(-0.8 * 2);
+  EXPECT_NEAR(Transmittance(medium, ray, 1, 3, &mean_t), expected, Tolerance(expected));
+  // Collisions are exponentially distributed from t0, truncated at t1.
+  auto expected_t = 1 + 1 / 0.8 - 2 * expected / (1 - expected);
+  EXPECT_NEAR(mean_t, expected_t, 0.01);
+}
+
+// A ray crossing a grid of varying density, with empty blocks, dense blocks
+// and blocks of mixed cells, sees the optical depth of the cells it crosses.
+TEST(MediumTest, GridMatchesOpticalDepth) {
+  const size_t nx = 40, ny = 10;
+  auto density = std::vector<double>(nx * ny);
+  for (size_t y = 0; y < ny; y++) {
+    for (size_t x = 0; x < nx; x++) {
+      density[y * nx + x] = x < 8 ? 0 : x < 16 ? 2 : x % 3 == 0 ? 1 : 0.1;
+    }
+  }
+  auto medium = GridMedium(Point2d(0, 0), Point2d(4, 1), nx, ny, density, 0.5, Colour(1, 1, 1), 8);
+  auto optical_depth = [&](const Ray &ray, double t0, double t1) {
+    const int steps = 200000;
+    double sum = 0;
+    for (int i = 0; i < steps; i++) {
+      sum += medium.SigmaAt(ray(t0 + (i + 0.5) * (t1 - t0) / steps));
+    }
+    return sum * (t1 - t0) * ray.d_.Length() / steps;
+  };
+
+  // Along the x axis, diagonally with a non-unit direction, and backwards from
+  // outside the box.
+  for (auto ray : {Ray(Point2d(-1, 0.55), Point2d(1, 0), Colour(1, 1, 1)),
+                   Ray(Point2d(0.1, 0.05), Point2d(1.5, 0.36), Colour(1, 1, 1)),
+                   Ray(Point2d(5, 0.3), Point2d(-1, 0.05), Colour(1, 1, 1))}) {
+    auto expected = std::exp(-optical_depth(ray, 0, 5));
+    EXPECT_NEAR(Transmittance(medium, ray, 0, 5), expected, Tolerance(expected)) << ray;
+  }
+  // A partial span ends inside the box.
+  auto ray = Ray(Point2d(0, 0.5), Point2d(1, 0), Colour(1, 1, 1));
+  auto expected = std::exp(-optical_depth(ray, 1, 2.5));
+  EXPECT_NEAR(Transmittance(medium, ray, 1, 2.5), expected, Tolerance(expected));
+}
+
+// A scattering gel ball: collisions only happen inside it, and renders stay
+// independent of the thread count.
+TEST(MediumTest, RenderScattersInsideTheBoundingShape) {
+  auto make = [](const Options &option) {
+    auto scene = std::make_unique<Scene>();
+    auto white = scene->AddMaterial<ScatteringMaterial>();
+    auto ball = scene->AddCircle(Point2d(1, 0), 0.5, std::make_unique<RefractiveMaterial>(1.3));
+    scene->AddMedium(std::make_unique<HomogeneousMedium>(4, Colour(0.5, 0.5, 0.5)), ball);
+    AddBox(scene.get(), white);
+    return MakeRayTracer(option, std::move(scene), Point2d(-1, 0));
+  };
+
+  auto option = Options(64, 64, 4000, 6);
+  option.trace_path_ = testing::TempDir() + "medium_test.trace";
+  auto serial = make(option);
+  serial->Render(1);
+  auto reader = TraceReader(option.trace_path_);
+  ASSERT_TRUE(reader.ok());
+  auto record = PathRecord{}, previous = PathRecord{};
+  size_t collisions = 0;
+  while (reader.Next(record)) {
+    if (record.depth_ > 0 && record.shape_ == kNoId) {
+      collisions++;
+      EXPECT_LE((Point2d(record.x_, record.y_) - Point2d(1, 0)).Length(), 0.5 + 1e-5);
+    }
+    // Records carry the colour of the incoming ray: the albedo shows on the
+    // vertex after a collision.
+    if (record.depth_ > 1 && previous.shape_ == kNoId) {
+      EXPECT_FLOAT_EQ(record.r_, previous.r_ * 0.5f);
+    }
+    previous = record;
+  }
+  std::remove(option.trace_path_.c_str());
+  EXPECT_GT(collisions, 100u);
+
+  option.trace_path_.clear();
+  option.deferred_ = true;
+  auto parallel = make(option);
+  parallel->Render(3);
+  auto serial_row = std::vector<double>(option.sx_ * 3), parallel_row = serial_row;
+  for (size_t y = 0; y < option.sy_; y++) {
+    serial->image_.ReadRow(y, serial_row.data());
+    parallel->image_.ReadRow(y, parallel_row.data());
+    for (size_t i = 0; i < serial_row.size(); i++) {
+      ASSERT_NEAR(parallel_row[i], serial_row[i], 1e-9 * (1 + serial_row[i]));
+    }
+  }
+}
+
+}  // namespace RayTracer2D
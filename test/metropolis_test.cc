@@ -0,0 +1,143 @@
+#include "core/metropolis.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+#include "core/scene.h"
+#include "light/point_light.h"
+#include "material/scattering.h"
+#include "sampler/primary_sample_space.h"
+#include "utils/constants.h"
+#include "test_scene.h"
+
+namespace RayTracer2D {
+
+// A white box split in two by a wall with a narrow slit, lit on the left and
+// viewed on the right only.
+static auto MakeRayTracer(const Options &option) -> std::unique_ptr<RayTracer> {
+  auto scene = std::make_unique<Scene>();
+  auto white = scene->AddMaterial<ScatteringMaterial>();
+  AddBox(scene.get(), white);
+  scene->AddWall(Point2d(0, -2), Point2d(0, 0.9), white);
+  scene->AddWall(Point2d(0, 0.92), Point2d(0, 2), white);
+  return MakeRayTracer(option, std::move(scene), Point2d(-1, -1));
+}
+
+// Root mean square relative error of the 8x8 pixel blocks of `actual` against
+// `expected`.
+static double BlockError(const Options &option, const std::vector<double> &actual,
+                         const std::vector<double> &expected) {
+  constexpr size_t kBlock = 8;
+  double sum = 0;
+  size_t blocks = 0;
+  for (size_t by = 0; by < option.sy_; by += kBlock) {
+    for (size_t bx = 0; bx < option.sx_; bx += kBlock) {
+      double e = 0, a = 0;
+      for (size_t y = by; y < by + kBlock; y++) {
+        for (size_t x = bx; x < bx + kBlock; x++) {
+          e += expected[(y * option.sx_ + x) * 3];
+          a += actual[(y * option.sx_ + x) * 3];
+        }
+      }
+      sum += (a - e) * (a - e) / (e * e);
+      blocks++;
+    }
+  }
+  return std::sqrt(sum / blocks);
+}
+
+TEST(MetropolisTest, RejectRestoresTheCurrentPath) {
+  auto sampler = PrimarySampleSpace(3, 0);
+  auto current = std::vector<double>(6);
+  for (uint32_t d = 0; d < current.size(); d++) {
+    current[d] = sampler.Get(0, d);
+  }
+  sampler.Accept();
+  for (int i = 0; i < 100; i++) {
+    sampler.StartIteration();
+    EXPECT_FALSE(sampler.large_step());
+    for (uint32_t d = 0; d < current.size(); d++) {
+      auto u = sampler.Get(0, d);
+      EXPECT_GE(u, 0.0);
+      EXPECT_LT(u, 1.0);
+      // Small steps stay close, modulo wrapping around.
+      auto step = std::abs(u - current[d]);
+      EXPECT_LT(std::min(step, 1 - step), 0.1);
+    }
+    sampler.Reject();
+  }
+  sampler.StartIteration();
+  sampler.Reject();
+  for (uint32_t d = 0; d < current.size(); d++) {
+    EXPECT_EQ(sampler.Get(0, d), current[d]);
+  }
+}
+
+// Bright bootstrap paths seed several chains, which start from the same
+// numbers. Reseeded, their proposals differ from the first iteration on.
+TEST(MetropolisTest, ChainsFromOneBootstrapPathDiverge) {
+  auto start = [](uint64_t mutation_seed) {
+    auto sampler = PrimarySampleSpace(7, MetropolisRenderer::kLargeStepProbability);
+    for (uint32_t d = 0; d < 6; d++) {
+      sampler.Get(0, d);
+    }
+    sampler.Accept();
+    sampler.Reseed(mutation_seed);
+    return sampler;
+  };
+  auto a = start(1);
+  auto b = start(2);
+  for (uint32_t d = 0; d < 6; d++) {
+    EXPECT_EQ(a.Get(0, d), b.Get(0, d));
+  }
+  size_t same = 0;
+  for (int i = 0; i < 20; i++) {
+    a.StartIteration();
+    b.StartIteration();
+    same += a.Get(0, 0) == b.Get(0, 0);
+    a.Accept();
+    b.Accept();
+  }
+  EXPECT_EQ(same, 0u);
+}
+
+// Seen through the slit, the right half only gets about one path in a hundred.
+// Chains stay on those paths and converge to the same image, up to the
+// brightness measured by the bootstrap, which every iteration deposits.
+TEST(MetropolisTest, ConvergesBehindSlit) {
+  auto option = Options(48, 48, 200000, 3);
+  option.roi_ = Rect{0.1, -1.9, 1.9, -0.1};
+  option.progress_ = false;
+  auto reference_option = option;
+  reference_option.num_rays_ = 4000000;
+  auto reference = MakeRayTracer(reference_option);
+  reference->Render(0);
+  option.metropolis_ = true;
+  option.metropolis_bootstrap_ = 1 << 20;
+  auto chains = MakeRayTracer(option);
+  auto renderer = MetropolisRenderer(*chains);
+  renderer.Render(2);
+  EXPECT_GT(renderer.acceptance(), 0.05);
+
+  auto expected = ReadPixels(reference->image_);
+  for (auto &v : expected) {
+    v *= static_cast<double>(option.num_rays_) / reference_option.num_rays_;
+  }
+  auto actual = ReadPixels(chains->image_);
+  double expected_total = 0, actual_total = 0;
+  for (size_t i = 0; i < expected.size(); i++) {
+    expected_total += expected[i];
+    actual_total += actual[i];
+  }
+  EXPECT_NEAR(actual_total, 3 * renderer.brightness() * option.num_rays_, 1e-9 * actual_total);
+  // The brightness is a plain estimate from the bootstrap paths.
+  EXPECT_NEAR(actual_total, expected_total, 0.1 * expected_total);
+  for (auto &v : actual) {
+    v *= expected_total / actual_total;
+  }
+  EXPECT_LT(BlockError(option, actual, expected), 0.2);
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,128 @@
+#include "core/path_recorder.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "core/options.h"
+#include "core/point.h"
+#include "core/rect.h"
+#include "core/ray_tracer.h"
+#include "core/scene.h"
+#include "light/point_light.h"
+#include "material/reflective.h"
+#include "material/scattering.h"
+#include "utils/constants.h"
+#include "utils/macros.h"
+#include "test_scene.h"
+
+namespace RayTracer2D {
+
+static auto ReadTrace(const std::string &path) -> std::map<uint64_t, std::vector<PathRecord>> {
+  auto reader = TraceReader(path);
+  EXPECT_TRUE(reader.ok());
+  auto paths = std::map<uint64_t, std::vector<PathRecord>>();
+  auto record = PathRecord{};
+  while (reader.Next(record)) {
+    paths[record.path_].push_back(record);
+  }
+  return paths;
+}
+
+TEST(PathRecorderTest, RecordsSampledPathsInOrder) {
+  auto option = Options(64, 64, 3000, 5);
+  option.trace_path_ = testing::TempDir() + "path_recorder_test.trace";
+  option.trace_every_ = 7;
+  option.deferred_ = true;
+  option.batch_size_ = 500;
+  auto rt = MakeMirrorBallTracer(option);
+  rt->Render(3);
+
+  auto paths = ReadTrace(option.trace_path_);
+  std::remove(option.trace_path_.c_str());
+  EXPECT_EQ(paths.size(), (option.num_rays_ + 6) / 7);
+  for (const auto &[id, path] : paths) {
+    EXPECT_EQ(id % 7, 0u);
+    ASSERT_EQ(path.size(), option.depth_ + 1) << id;
+    for (size_t i = 0; i < path.size(); i++) {
+      EXPECT_EQ(path[i].depth_, i);
+      if (i == 0) {
+        EXPECT_EQ(path[i].shape_, kNoId);
+      } else {
+        ASSERT_LT(path[i].shape_, rt->scene_->size());
+        EXPECT_LT(path[i].material_, 2u);
+        EXPECT_GT(path[i].t_, kNearZeroHit);
+        EXPECT_LE(std::abs(path[i].x_), W_RIGHT + 1e-4);
+        EXPECT_LE(std::abs(path[i].y_), W_BOTTOM + 1e-4);
+      }
+    }
+    // The mirror ball keeps the colour, the walls only attenuate it.
+    EXPECT_LE(path.back().r_, path.front().r_);
+  }
+}
+
+// The header keeps the world and the region of interest, which replays
+// rasterize into.
+TEST(PathRecorderTest, HeaderKeepsTheView) {
+  auto option = Options(32, 32, 100, 3);
+  option.trace_path_ = testing::TempDir() + "path_recorder_view_test.trace";
+  option.roi_ = Rect{-0.5, -0.25, 1, 0.75};
+  auto rt = MakeMirrorBallTracer(option);
+  rt->Render(1);
+
+  auto reader = TraceReader(option.trace_path_);
+  ASSERT_TRUE(reader.ok());
+  const auto &header = reader.header();
+  std::remove(option.trace_path_.c_str());
+  EXPECT_EQ(header.world_.left_, option.world_.left_);
+  EXPECT_EQ(header.world_.top_, option.world_.top_);
+  EXPECT_EQ(header.world_.right_, option.world_.right_);
+  EXPECT_EQ(header.world_.bottom_, option.world_.bottom_);
+  EXPECT_EQ(header.view_.left_, -0.5);
+  EXPECT_EQ(header.view_.top_, -0.25);
+  EXPECT_EQ(header.view_.right_, 1);
+  EXPECT_EQ(header.view_.bottom_, 0.75);
+}
+
+// Past the limit, full rings overwrite their oldest records: the file stays
+// within the limit plus one ring per thread, and ends with the last paths.
+TEST(PathRecorderTest, LimitKeepsLatestRecords) {
+  auto option = Options(64, 64, 100000, 4);
+  option.trace_path_ = testing::TempDir() + "path_recorder_limit_test.trace";
+  option.trace_limit_mb_ = 1;
+  const size_t ring = 1024;
+  {
+    auto recorder = PathRecorder(option, 1, ring);
+    for (uint64_t path = 0; path < option.num_rays_; path++) {
+      for (uint16_t depth = 0; depth <= option.depth_; depth++) {
+        auto record = PathRecord{};
+        record.path_ = path;
+        record.depth_ = depth;
+        recorder.Record(record);
+      }
+    }
+    EXPECT_GT(recorder.dropped(), 0u);
+  }
+
+  auto reader = TraceReader(option.trace_path_);
+  ASSERT_TRUE(reader.ok());
+  auto records = std::vector<PathRecord>();
+  auto record = PathRecord{};
+  while (reader.Next(record)) {
+    records.push_back(record);
+  }
+  std::remove(option.trace_path_.c_str());
+  EXPECT_LE(records.size() * sizeof(PathRecord), (1u << 20) + ring * sizeof(PathRecord));
+  ASSERT_GT(records.size(), ring);
+  EXPECT_EQ(records.front().path_, 0u);
+  EXPECT_EQ(records.back().path_, option.num_rays_ - 1);
+  EXPECT_EQ(records.back().depth_, option.depth_);
+  // The tail is contiguous.
+  for (size_t i = records.size() - ring + 1; i < records.size(); i++) {
+    EXPECT_EQ(records[i].path_ * 5 + records[i].depth_, records[i - 1].path_ * 5 + records[i - 1].depth_ + 1);
+  }
+}
+
+}  // namespace RayTracer2D
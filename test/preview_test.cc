@@ -0,0 +1,55 @@
+#include "core/preview.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+
+namespace RayTracer2D {
+
+static auto ReadFile(const std::string &path) -> std::vector<char> {
+  std::ifstream ifs(path, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+// The only snapshot of the render is due at the batch starting at ray 1500,
+// when the accumulator holds exactly the first 1500 rays. The preview must
+// be the one of a full render of those rays.
+TEST(PreviewTest, MatchesFullRenderAtSameRayCount) {
+  const auto path = std::string("/tmp/raytracer2d_preview_test.ppm");
+  const auto reference_path = std::string("/tmp/raytracer2d_preview_test_reference.ppm");
+  auto option = Options(128, 96, 2000, 6);
+  option.deferred_ = true;
+  option.batch_size_ = 500;
+  option.preview_size_ = 40;
+  option.preview_every_rays_ = 1500;
+
+  option.preview_path_ = path;
+  auto progressive = RayTracer(option);
+  progressive.Render(1);
+
+  option.preview_path_.clear();
+  option.num_rays_ = 1500;
+  auto full = RayTracer(option);
+  full.Render(1);
+  option.preview_path_ = reference_path;
+  option.preview_every_rays_ = 1;
+  {
+    auto writer = PreviewWriter(full.image_, option);
+    writer.MaybeSnapshot(1);
+    writer.WaitForSnapshot();
+  }
+
+  const auto preview = ReadFile(path);
+  const auto reference = ReadFile(reference_path);
+  // 128x96 downsampled by 4.
+  EXPECT_EQ(preview.size(), std::string("P6\n32 24\n255\n").size() + 32 * 24 * 3);
+  EXPECT_EQ(preview, reference);
+  std::remove(path.c_str());
+  std::remove(reference_path.c_str());
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,154 @@
+#include "core/qoi.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "core/image.h"
+#include "core/options.h"
+
+namespace RayTracer2D {
+
+// Straightforward decoder following the specification, RGB output only.
+static bool DecodeQoi(const std::string &bytes, size_t &width, size_t &height, std::vector<unsigned char> &rgb) {
+  auto read32 = [&](size_t at) {
+    return static_cast<uint32_t>(static_cast<unsigned char>(bytes[at])) << 24 |
+           static_cast<uint32_t>(static_cast<unsigned char>(bytes[at + 1])) << 16 |
+           static_cast<uint32_t>(static_cast<unsigned char>(bytes[at + 2])) << 8 |
+           static_cast<uint32_t>(static_cast<unsigned char>(bytes[at + 3]));
+  };
+  if (bytes.size() < 22 || bytes.compare(0, 4, "qoif") != 0) {
+    return false;
+  }
+  width = read32(4);
+  height = read32(8);
+  rgb.clear();
+
+  unsigned char index[64][4] = {};
+  unsigned char px[4] = {0, 0, 0, 255};
+  size_t p = 14;
+  const size_t end = bytes.size() - 8;
+  while (rgb.size() < width * height * 3 && p < end) {
+    auto b1 = static_cast<unsigned char>(bytes[p++]);
+    int run = 1;
+    if (b1 == 0xfe) {
+      for (int c = 0; c < 3; c++) {
+        px[c] = bytes[p++];
+      }
+    } else if (b1 == 0xff) {
+      for (int c = 0; c < 4; c++) {
+        px[c] = bytes[p++];
+      }
+    } else if ((b1 & 0xc0) == 0x00) {
+      std::copy(index[b1], index[b1] + 4, px);
+    } else if ((b1 & 0xc0) == 0x40) {
+      px[0] += ((b1 >> 4) & 3) - 2;
+      px[1] += ((b1 >> 2) & 3) - 2;
+      px[2] += (b1 & 3) - 2;
+    } else if ((b1 & 0xc0) == 0x80) {
+      auto b2 = static_cast<unsigned char>(bytes[p++]);
+      int dg = (b1 & 0x3f) - 32;
+      px[0] += dg - 8 + ((b2 >> 4) & 0x0f);
+      px[1] += dg;
+      px[2] += dg - 8 + (b2 & 0x0f);
+    } else {
+      run = (b1 & 0x3f) + 1;
+    }
+    std::copy(px, px + 4, index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64]);
+    for (int i = 0; i < run; i++) {
+      rgb.insert(rgb.end(), px, px + 3);
+    }
+  }
+  return rgb.size() == width * height * 3 && p == end && bytes.compare(end, 8, std::string("\0\0\0\0\0\0\0\1", 8)) == 0;
+}
+
+// Flat areas (long runs), gradients (diff and luma chunks), a small palette
+// (index chunks), black pixels and noise (full RGB chunks).
+static auto MakeTestImage(size_t width, size_t height) -> std::vector<unsigned char> {
+  auto gen = std::mt19937(5);
+  auto rgb = std::vector<unsigned char>(width * height * 3);
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      auto *px = &rgb[(y * width + x) * 3];
+      switch ((x / 50 + y / 40) % 5) {
+        case 0:
+          px[0] = px[1] = px[2] = 0;
+          break;
+        case 1:
+          px[0] = x, px[1] = y, px[2] = x + y;
+          break;
+        case 2:
+          px[0] = 10 * (x % 3), px[1] = 100, px[2] = 50 * (y % 2);
+          break;
+        case 3:
+          px[0] = gen(), px[1] = gen(), px[2] = gen();
+          break;
+        default:
+          px[0] = 200, px[1] = 3 * x, px[2] = 7;
+      }
+    }
+  }
+  return rgb;
+}
+
+TEST(QoiTest, StripsRoundTrip) {
+  const size_t width = 301, height = 157;
+  auto image = MakeTestImage(width, height);
+  auto read_row = [&](size_t y, unsigned char *rgb) {
+    std::copy(&image[y * width * 3], &image[(y + 1) * width * 3], rgb);
+  };
+
+  size_t single_size = 0;
+  for (auto [threads, strip_rows] : {std::pair{1, height}, {1, 1}, {3, 7}, {4, 32}}) {
+    std::ostringstream os;
+    ASSERT_TRUE(WriteQoi(os, width, height, read_row, threads, strip_rows));
+    size_t w, h;
+    std::vector<unsigned char> decoded;
+    ASSERT_TRUE(DecodeQoi(os.str(), w, h, decoded)) << threads << " threads, " << strip_rows << " rows per strip";
+    EXPECT_EQ(w, width);
+    EXPECT_EQ(h, height);
+    EXPECT_EQ(decoded, image) << threads << " threads, " << strip_rows << " rows per strip";
+    if (strip_rows == height) {
+      single_size = os.str().size();
+    } else if (strip_rows >= 7) {
+      // Restarting every strip costs little.
+      EXPECT_LT(os.str().size(), single_size * 1.02);
+    }
+  }
+}
+
+TEST(QoiTest, MatchesPpmOutput) {
+  auto option = Options(97, 64, 1, 1);
+  auto image = Image(option);
+  for (size_t y = 0; y < image.sy_; y++) {
+    for (size_t x = 0; x < image.sx_; x++) {
+      image.Accumulate(x, y, Colour(x % 7 == 0 ? 1 : 0, (x * y) % 13 / 13.0, y / 64.0));
+    }
+  }
+  image.Overlay(3, 5, 0, 255, 0);
+
+  auto ppm_path = testing::TempDir() + "qoi_test.ppm";
+  auto qoi_path = testing::TempDir() + "qoi_test.qoi";
+  ASSERT_TRUE(image.Write(ppm_path, 2));
+  ASSERT_TRUE(image.Write(qoi_path, 2));
+
+  std::ifstream ppm_file(ppm_path, std::ios::binary);
+  auto ppm = std::string(std::istreambuf_iterator<char>(ppm_file), {});
+  std::ifstream qoi_file(qoi_path, std::ios::binary);
+  auto qoi = std::string(std::istreambuf_iterator<char>(qoi_file), {});
+  std::remove(ppm_path.c_str());
+  std::remove(qoi_path.c_str());
+
+  size_t w, h;
+  std::vector<unsigned char> decoded;
+  ASSERT_TRUE(DecodeQoi(qoi, w, h, decoded));
+  ASSERT_EQ(decoded.size(), image.sx_ * image.sy_ * 3);
+  EXPECT_EQ(ppm.substr(ppm.size() - decoded.size()), std::string(decoded.begin(), decoded.end()));
+  EXPECT_EQ(decoded[(5 * image.sx_ + 3) * 3 + 1], 255);
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,141 @@
+#include "light/ray_file_light.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+#include "core/sampler.h"
+#include "core/scene_file.h"
+#include "light/laser_light.h"
+#include "test_scene.h"
+
+namespace RayTracer2D {
+
+static const std::vector<RayFileRecord> kRecords = {
+    {0, 0, 1, 0, 1, 0},
+    {0.5f, -0.25f, 0, 2, 2, 0},
+    {-1, 1, 3, 4, 5, 600},
+};
+
+TEST(RayFileLightTest, ReplaysRecordsInOrder) {
+  const auto path = testing::TempDir() + "sequential.rays";
+  ASSERT_TRUE(RayFileLight::Write(path, kRecords));
+  auto light = RayFileLight::Open(path, RayFileLight::Mode::kSequential);
+  ASSERT_NE(light, nullptr);
+  EXPECT_EQ(light->size(), 3u);
+  auto sampler = MakeSampler(SamplerType::kRandom, 0);
+  for (size_t i = 0; i < 6; i++) {
+    const auto &record = kRecords[i % 3];
+    auto ray = light->GetLightRay(SampleStream(sampler.get(), i));
+    EXPECT_EQ(ray.p_, Point2d(record.x_, record.y_));
+    auto d = Point2d(record.dx_, record.dy_);
+    d.Normalize();
+    EXPECT_NEAR(ray.d_.x, d.x, 1e-12);
+    EXPECT_NEAR(ray.d_.y, d.y, 1e-12);
+    const auto colour = RayFileLight::SpectralColour(record.wavelength_) * record.power_;
+    EXPECT_EQ(ray.colour_.R_, colour.R_);
+    EXPECT_EQ(ray.colour_.G_, colour.G_);
+  }
+  // 600 nm is orange.
+  const auto orange = RayFileLight::SpectralColour(600);
+  EXPECT_EQ(orange.R_, 1);
+  EXPECT_GT(orange.G_, 0.5);
+  EXPECT_EQ(orange.B_, 0);
+}
+
+// Records come up in proportion to their power, every ray carrying the mean.
+TEST(RayFileLightTest, SamplesInProportionToPower) {
+  const auto path = testing::TempDir() + "random.rays";
+  ASSERT_TRUE(RayFileLight::Write(path, kRecords));
+  auto light = RayFileLight::Open(path, RayFileLight::Mode::kRandom);
+  ASSERT_NE(light, nullptr);
+  auto sampler = MakeSampler(SamplerType::kOwenSobol, 7);
+  constexpr size_t kSamples = 1 << 16;
+  size_t counts[3] = {0, 0, 0};
+  for (size_t i = 0; i < kSamples; i++) {
+    auto ray = light->GetLightRay(SampleStream(sampler.get(), i));
+    for (size_t r = 0; r < 3; r++) {
+      if (ray.p_ == Point2d(kRecords[r].x_, kRecords[r].y_)) {
+        counts[r]++;
+        const auto colour = RayFileLight::SpectralColour(kRecords[r].wavelength_) * (8.0 / 3);
+        EXPECT_NEAR(ray.colour_.R_, colour.R_, 1e-6);
+      }
+    }
+  }
+  EXPECT_EQ(counts[0] + counts[1] + counts[2], kSamples);
+  EXPECT_NEAR(counts[0] / static_cast<double>(kSamples), 1.0 / 8, 0.005);
+  EXPECT_NEAR(counts[1] / static_cast<double>(kSamples), 2.0 / 8, 0.005);
+  EXPECT_NEAR(counts[2] / static_cast<double>(kSamples), 5.0 / 8, 0.005);
+}
+
+// Skewed powers, with empty records and records far above the mean, make
+// columns drain below average on both sides of the cursor building the table.
+TEST(RayFileLightTest, SamplesManyRecordsInProportionToPower) {
+  constexpr size_t kCount = 200;
+  auto records = std::vector<RayFileRecord>(kCount);
+  double total = 0;
+  for (size_t i = 0; i < kCount; i++) {
+    const auto power = i % 7 == 3 ? 0.0f : i % 23 == 5 ? 40.0f : static_cast<float>((i * 37) % 11) / 4;
+    records[i] = RayFileRecord{static_cast<float>(i), 0, 1, 0, power, 0};
+    total += power;
+  }
+  const auto path = testing::TempDir() + "skewed.rays";
+  ASSERT_TRUE(RayFileLight::Write(path, records));
+  auto light = RayFileLight::Open(path, RayFileLight::Mode::kRandom);
+  ASSERT_NE(light, nullptr);
+  auto sampler = MakeSampler(SamplerType::kOwenSobol, 3);
+  constexpr size_t kSamples = 1 << 18;
+  auto counts = std::vector<size_t>(kCount);
+  for (size_t i = 0; i < kSamples; i++) {
+    counts[static_cast<size_t>(light->GetLightRay(SampleStream(sampler.get(), i)).p_.x)]++;
+  }
+  for (size_t i = 0; i < kCount; i++) {
+    const auto expected = records[i].power_ / total;
+    EXPECT_NEAR(counts[i] / static_cast<double>(kSamples), expected, 4 * std::sqrt(expected / kSamples) + 1e-9) << i;
+  }
+}
+
+TEST(RayFileLightTest, RejectsBadFiles) {
+  EXPECT_EQ(RayFileLight::Open(testing::TempDir() + "missing.rays", RayFileLight::Mode::kRandom), nullptr);
+  const auto path = testing::TempDir() + "bad.rays";
+  ASSERT_TRUE(RayFileLight::Write(path, kRecords));
+  {
+    // Drop the last record.
+    std::ifstream in(path, std::ios::binary);
+    auto bytes = std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    std::ofstream out(path, std::ios::binary);
+    out.write(bytes.data(), bytes.size() - sizeof(RayFileRecord));
+  }
+  EXPECT_EQ(RayFileLight::Open(path, RayFileLight::Mode::kSequential), nullptr);
+  ASSERT_TRUE(RayFileLight::Write(path, {{0, 0, 1, 0, 0, 0}}));
+  EXPECT_NE(RayFileLight::Open(path, RayFileLight::Mode::kSequential), nullptr);
+  EXPECT_EQ(RayFileLight::Open(path, RayFileLight::Mode::kRandom), nullptr);
+}
+
+// A file replaying a single record renders like the laser it measures.
+TEST(RayFileLightTest, SceneLightMatchesLaser) {
+  const auto path = testing::TempDir() + "laser.rays";
+  ASSERT_TRUE(RayFileLight::Write(path, {{0, 0, 0.6f, 0.8f, 1, 0}}));
+  std::istringstream is("material white scattering\n"
+                        "wall -2 -2 -2 2 white\nwall -2 2 2 2 white\nwall 2 2 2 -2 white\nwall 2 -2 -2 -2 white\n"
+                        "light rayfile " +
+                        path + " sequential\n");
+  auto description = SceneDescription{};
+  ASSERT_TRUE(ParseSceneDescription(is, "test", description));
+  auto option = Options(64, 64, 2000, 4);
+  option.progress_ = false;
+  auto measured = RayTracer(option, BuildScene(description), BuildLight(description));
+  auto d = Point2d(0.6f, 0.8f);
+  d.Normalize();
+  auto laser =
+      RayTracer(option, BuildScene(description), std::make_unique<LaserLight>(Point2d(0, 0), d, Colour(1, 1, 1)));
+  measured.Render(1);
+  laser.Render(1);
+  EXPECT_EQ(ReadPixels(measured.image_), ReadPixels(laser.image_));
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,231 @@
+#include "core/ray_tracer.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <memory>
+#include <vector>
+#include "core/colour.h"
+#include "core/options.h"
+#include "core/path_recorder.h"
+#include "core/point.h"
+#include "core/scene.h"
+#include "core/tile_splatter.h"
+#include "light/point_light.h"
+#include "material/reflective.h"
+#include "material/refractive.h"
+#include "material/scattering.h"
+#include "shapes/circle.h"
+#include "shapes/wall.h"
+#include "utils/constants.h"
+#include "utils/parallel.h"
+#include "test_scene.h"
+
+namespace RayTracer2D {
+
+// Copy the accumulator out through the zero-copy views.
+static auto Gather(const Image &image) -> std::vector<double> {
+  auto pixels = std::vector<double>(image.sx_ * image.sy_ * 3, image.background_);
+  image.ForEachView([&](const ImageView &view) {
+    for (size_t y = 0; y < view.height_; y++) {
+      const auto *row = view.Row(y);
+      std::copy(row, row + view.width_ * 3, pixels.begin() + ((view.y_ + y) * image.sx_ + view.x_) * 3);
+    }
+  });
+  return pixels;
+}
+
+TEST(RayTracerTest, RenderIsIndependentOfThreadCount) {
+  auto option = Options(96, 80, 3000, 6);
+  option.batch_size_ = 512;
+  auto serial = MakeMirrorBallTracer(option);
+  auto parallel = MakeMirrorBallTracer(option);
+  serial->Render(1);
+  parallel->Render(3);
+
+  auto expected = Gather(serial->image_);
+  auto actual = Gather(parallel->image_);
+  double total = 0;
+  for (size_t i = 0; i < expected.size(); i++) {
+    ASSERT_NEAR(actual[i], expected[i], 1e-9 * (1 + expected[i])) << i;
+    total += expected[i];
+  }
+  EXPECT_GT(total, 0);
+}
+
+// On one thread the tiles add the segments of a pixel in the order rays are
+// traced, so deferred splatting reproduces direct rendering bit for bit.
+// Fixed-point sums do not depend on the order at all, so any thread count
+// does.
+TEST(RayTracerTest, DeferredSplattingMatchesDirect) {
+  for (auto format : {AccumulatorFormat::kDouble, AccumulatorFormat::kFixed64}) {
+    auto option = Options(96, 80, 3000, 6);
+    option.accumulator_ = format;
+    auto direct = MakeMirrorBallTracer(option);
+    direct->Render(1);
+    option.deferred_ = true;
+    option.tile_size_ = 16;
+    option.batch_size_ = 256;
+    auto deferred = MakeMirrorBallTracer(option);
+    deferred->Render(format == AccumulatorFormat::kDouble ? 1 : 3);
+
+    const auto expected = ReadPixels(direct->image_);
+    const auto actual = ReadPixels(deferred->image_);
+    double total = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+      ASSERT_EQ(actual[i], expected[i]) << i;
+      total += expected[i];
+    }
+    EXPECT_GT(total, 0);
+  }
+}
+
+// Splatting stays on the threads it is given, whatever the OpenMP default.
+TEST(RayTracerTest, SplattingUsesTheGivenThreads) {
+  auto option = Options(96, 80, 1, 1);
+  auto image = Image(option);
+  auto splatter = TileSplatter(image, 16, 2);
+  auto buffers = std::vector<SegmentBuffer>(2);
+  for (size_t i = 0; i < 64; i++) {
+    const auto y = -2 + static_cast<double>(i) / 16;
+    buffers[i % 2].push_back(Segment{Point2d(-2, y), Point2d(2, -y), Colour(1, 1, 1)});
+  }
+  std::atomic<size_t> steps{0};
+  std::atomic<bool> beyond{false};
+  splatter.Splat(buffers, [&](size_t, size_t, size_t, const Colour &) {
+    steps++;
+    if (ThreadIndex() >= 2) {
+      beyond = true;
+    }
+  });
+  EXPECT_GT(steps.load(), 0u);
+  EXPECT_FALSE(beyond.load());
+}
+
+// Rays leaving a scene that is not closed end their path, the render goes on.
+TEST(RayTracerTest, EscapingRaysEndTheirPath) {
+  auto option = Options(64, 64, 500, 4);
+  option.progress_ = false;
+  auto scene = std::make_unique<Scene>();
+  auto mirror = scene->AddMaterial<ReflectiveMaterial>();
+  scene->AddCircle(Point2d(1, 1), 0.5, mirror);
+  auto rt = MakeRayTracer(option, std::move(scene), Point2d(-0.5, 0.2));
+  rt->Render(1);
+  EXPECT_EQ(rt->escaped_rays(), option.num_rays_);
+}
+
+TEST(RayTracerTest, SparseViewsMatchRows) {
+  auto option = Options(150, 100, 2000, 4);
+  option.sparse_ = true;
+  option.tile_size_ = 32;
+  auto rt = MakeMirrorBallTracer(option);
+  rt->Render(2);
+
+  auto pixels = Gather(rt->image_);
+  auto row = std::vector<double>(option.sx_ * 3);
+  size_t views = 0;
+  rt->image_.ForEachView([&](const ImageView &view) {
+    EXPECT_LE(view.x_ + view.width_, option.sx_);
+    EXPECT_LE(view.y_ + view.height_, option.sy_);
+    views++;
+  });
+  EXPECT_GT(views, 0u);
+  for (size_t y = 0; y < option.sy_; y++) {
+    rt->image_.ReadRow(y, row.data());
+    for (size_t i = 0; i < row.size(); i++) {
+      ASSERT_EQ(row[i], pixels[y * option.sx_ * 3 + i]);
+    }
+  }
+}
+
+// Rays leaving a surface exactly at the hit point re-hit it at t = 0 unless
+// they know where they come from.
+TEST(RayTracerTest, SpawnedRaysSkipTheirOrigin) {
+  auto wall = Wall(Point2d(2, -2), Point2d(2, 2), std::make_unique<ReflectiveMaterial>());
+  auto leaving = Ray(Point2d(2, 0.5), Point2d(-1, 0.3), Colour(1, 1, 1));
+  auto t = wall.Intersect(leaving);
+  ASSERT_TRUE(t.has_value());
+  EXPECT_EQ(t.value(), 0);
+  leaving.origin_ = &wall;
+  EXPECT_FALSE(wall.Intersect(leaving).has_value());
+
+  // Leaving a circle outwards misses it, refracting inwards hits the far side.
+  auto circle = Circle(Point2d(0, 0), 1, std::make_unique<RefractiveMaterial>(1.5));
+  auto outwards = Ray(Point2d(0.6, 0.8), Point2d(1, 1), Colour(1, 1, 1));
+  outwards.origin_ = &circle;
+  EXPECT_FALSE(circle.Intersect(outwards).has_value());
+  auto inwards = Ray(Point2d(0.6, 0.8), Point2d(-0.6, -0.8), Colour(1, 1, 1));
+  inwards.origin_ = &circle;
+  ASSERT_TRUE(circle.Intersect(inwards).has_value());
+  EXPECT_NEAR(circle.Intersect(inwards).value(), 2, 1e-12);
+}
+
+// The demo laser used to stick to the first wall it hit, spending every
+// further bounce on zero-length segments.
+TEST(RayTracerTest, NoBounceIsWasted) {
+  for (auto deferred : {false, true}) {
+    auto option = Options(64, 64, 500, 8);
+    option.deferred_ = deferred;
+    option.trace_path_ = testing::TempDir() + "ray_tracer_spawn_test.trace";
+    auto rt = RayTracer(option);
+    rt.Render(1);
+    EXPECT_EQ(rt.near_zero_hits(), 0u);
+
+    auto reader = TraceReader(option.trace_path_);
+    ASSERT_TRUE(reader.ok());
+    auto record = PathRecord{};
+    size_t hits = 0, shapes = 0;
+    uint32_t previous = kNoId;
+    while (reader.Next(record)) {
+      if (record.depth_ > 0) {
+        EXPECT_GT(record.t_, kNearZeroHit);
+        hits++;
+        shapes += record.shape_ != previous;
+      }
+      previous = record.shape_;
+    }
+    std::remove(option.trace_path_.c_str());
+    EXPECT_EQ(hits, option.num_rays_ * option.depth_);
+    // Every bounce moves on to another surface.
+    EXPECT_EQ(shapes, hits);
+  }
+}
+
+// A region of interest at the pixel pitch of a full frame gives the matching
+// crop of it, whether segments are drawn right away or deferred, while most
+// segments and last bounces are culled.
+TEST(RayTracerTest, RegionOfInterestMatchesCrop) {
+  auto full_option = Options(401, 401, 4000, 5);
+  auto full = MakeMirrorBallTracer(full_option);
+  full->Render(1);
+  auto frame = Gather(full->image_);
+
+  for (auto deferred : {false, true}) {
+    auto option = Options(101, 81, 4000, 5);
+    option.roi_ = Rect{0.5, -0.2, 1.5, 0.6};
+    option.deferred_ = deferred;
+    auto roi = MakeMirrorBallTracer(option);
+    roi->Render(1);
+    auto crop = Gather(roi->image_);
+
+    size_t matching = 0;
+    double crop_total = 0, frame_total = 0;
+    for (size_t y = 0; y < option.sy_; y++) {
+      for (size_t x = 0; x < option.sx_; x++) {
+        for (size_t c = 0; c < 3; c++) {
+          auto expected = frame[((y + 180) * full_option.sx_ + x + 250) * 3 + c];
+          auto actual = crop[(y * option.sx_ + x) * 3 + c];
+          matching += std::abs(actual - expected) <= 1e-9 * (1 + expected);
+          crop_total += actual;
+          frame_total += expected;
+        }
+      }
+    }
+    // Rounding ties may land a few steps in the neighbouring pixel.
+    EXPECT_GT(matching, crop.size() * 0.999) << deferred;
+    EXPECT_NEAR(crop_total, frame_total, 1e-6 * frame_total) << deferred;
+  }
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,112 @@
+#include "core/sampler.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "core/point.h"
+#include "core/ray.h"
+#include "material/scattering.h"
+
+namespace RayTracer2D {
+
+static constexpr size_t kNumSamples = 1024;
+static constexpr size_t kNumSeeds = 16;
+
+// Root mean square error of `kNumSamples`-point estimates of `expected`, over
+// independently seeded samplers of the given type.
+static double EstimateRmse(SamplerType type, double expected,
+                           const std::function<double(const SampleStream &)> &integrand) {
+  double squared_error = 0;
+  for (size_t seed = 0; seed < kNumSeeds; seed++) {
+    auto sampler = MakeSampler(type, seed);
+    double sum = 0;
+    for (size_t i = 0; i < kNumSamples; i++) {
+      sum += integrand(SampleStream(sampler.get(), i));
+    }
+    auto error = sum / kNumSamples - expected;
+    squared_error += error * error;
+  }
+  return std::sqrt(squared_error / kNumSeeds);
+}
+
+TEST(SamplerTest, DeterministicAndInUnitInterval) {
+  for (auto type : {SamplerType::kRandom, SamplerType::kSobol, SamplerType::kOwenSobol}) {
+    auto a = MakeSampler(type, 7);
+    auto b = MakeSampler(type, 7);
+    for (uint64_t i = 0; i < 4096; i++) {
+      for (uint32_t d = 0; d < 8; d++) {
+        auto u = a->Get(i, d);
+        EXPECT_GE(u, 0.0);
+        EXPECT_LT(u, 1.0);
+        EXPECT_EQ(u, b->Get(i, d));
+      }
+    }
+  }
+}
+
+// The first 2^m points of every dimension pair put exactly one point in each
+// elementary interval of area 2^-m, whatever the pair and the scrambling.
+TEST(SamplerTest, SobolPrefixIsStratified) {
+  constexpr uint32_t m = 8;
+  constexpr uint32_t n = 1u << m;
+  for (auto type : {SamplerType::kSobol, SamplerType::kOwenSobol}) {
+    auto sampler = MakeSampler(type, 3);
+    for (uint32_t pair = 0; pair < 4; pair++) {
+      for (uint32_t k = 0; k <= m; k++) {
+        auto counts = std::vector<int>(n, 0);
+        for (uint32_t i = 0; i < n; i++) {
+          auto x = static_cast<uint32_t>(sampler->Get(i, 2 * pair) * (1u << k));
+          auto y = static_cast<uint32_t>(sampler->Get(i, 2 * pair + 1) * (1u << (m - k)));
+          counts[(y << k) | x]++;
+        }
+        for (auto count : counts) {
+          ASSERT_EQ(count, 1) << "pair " << pair << ", " << (1u << k) << "x" << (1u << (m - k)) << " strata";
+        }
+      }
+    }
+  }
+}
+
+// Fraction of the unit square inside the quarter disk, a discontinuous 2D
+// integrand over the dimensions of the first bounce.
+TEST(SamplerTest, ScrambledSobolConvergesFasterThanRandom) {
+  auto disk = [](const SampleStream &sample) {
+    auto x = sample.Get(kEmissionDimensions);
+    auto y = sample.Get(kEmissionDimensions + 1);
+    return x * x + y * y < 1 ? 1.0 : 0.0;
+  };
+  auto random = EstimateRmse(SamplerType::kRandom, M_PI / 4, disk);
+  auto sobol = EstimateRmse(SamplerType::kSobol, M_PI / 4, disk);
+  auto owen = EstimateRmse(SamplerType::kOwenSobol, M_PI / 4, disk);
+  EXPECT_LT(sobol, random / 3);
+  EXPECT_LT(owen, random / 3);
+}
+
+// Mean cosine to the normal of rays leaving a scattering surface: 2/pi for
+// uniform angles, pi/4 for Lambertian scattering.
+TEST(SamplerTest, ScatteringConvergence) {
+  auto uniform = ScatteringMaterial(ScatterDistribution::kUniform);
+  auto lambertian = ScatteringMaterial(ScatterDistribution::kCosine);
+  auto mean_cosine = [](ScatteringMaterial &material) {
+    return [&material](const SampleStream &sample) {
+      auto ray = Ray(Point2d(0, 1), Point2d(0, -1), Colour(1, 1, 1));
+      ray.sample_ = sample;
+      return material.Interact(ray, Point2d(0, 0), Point2d(0, 1)).d_.y;
+    };
+  };
+
+  auto random_uniform = EstimateRmse(SamplerType::kRandom, 2 / M_PI, mean_cosine(uniform));
+  auto owen_uniform = EstimateRmse(SamplerType::kOwenSobol, 2 / M_PI, mean_cosine(uniform));
+  auto random_lambertian = EstimateRmse(SamplerType::kRandom, M_PI / 4, mean_cosine(lambertian));
+  auto owen_lambertian = EstimateRmse(SamplerType::kOwenSobol, M_PI / 4, mean_cosine(lambertian));
+
+  // Plain Monte Carlo is within a few standard errors...
+  EXPECT_LT(random_uniform, 0.05);
+  EXPECT_LT(random_lambertian, 0.05);
+  // ...and the same accuracy takes far fewer stratified samples.
+  EXPECT_LT(owen_uniform, random_uniform / 10);
+  EXPECT_LT(owen_lambertian, random_lambertian / 10);
+}
+
+}  // namespace RayTracer2D
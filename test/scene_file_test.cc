@@ -0,0 +1,63 @@
+#include "core/scene_file.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "core/generated_scene.h"
+#include "core/options.h"
+#include "core/ray_tracer.h"
+#include "test_scene.h"
+
+namespace RayTracer2D {
+
+TEST(SceneFileTest, ReportsErrors) {
+  auto parse = [](const char *text) {
+    std::istringstream is(text);
+    auto description = SceneDescription{};
+    return ParseSceneDescription(is, "test", description);
+  };
+  EXPECT_TRUE(parse("material m reflective  # mirror\ncircle 0 0 1 m\nlight point 0 0 1 1 1\n"));
+  EXPECT_FALSE(parse("circle 0 0 1 m\nlight point 0 0 1 1 1\n"));
+  EXPECT_FALSE(parse("material m reflective\ncircle 0 0 -1 m\nlight point 0 0 1 1 1\n"));
+  EXPECT_FALSE(parse("material m glass\nlight point 0 0 1 1 1\n"));
+  EXPECT_TRUE(parse("material m scattering cosine 0.5 0.6 0.7\nlight point 0 0 1 1 1\n"));
+  EXPECT_FALSE(parse("material m scattering uniform 0.5\nlight point 0 0 1 1 1\n"));
+  EXPECT_FALSE(parse("material m scattering uniform 0.5 2 0.5\nlight point 0 0 1 1 1\n"));
+  EXPECT_FALSE(parse("material m reflective\nwall 0 0 1 m\nlight point 0 0 1 1 1\n"));
+  EXPECT_FALSE(parse("light point 0 0 1 1 1 1\n"));
+  EXPECT_FALSE(parse("material m reflective\n"));
+}
+
+// The demo scene description reproduces the built-in default scene, and its
+// generated kernel renders it like the generic propagation loop.
+TEST(SceneFileTest, GeneratedKernelMatchesGenericRender) {
+  auto description = SceneDescription{};
+  ASSERT_TRUE(LoadSceneDescription(RT2D_SCENE_DIR "/demo.scene", description));
+  auto option = Options(128, 128, 3000, 6);
+
+  auto builtin = RayTracer(option);
+  auto loaded = RayTracer(option, BuildScene(description), BuildLight(description));
+  auto kernel = RayTracer(option, generated::BuildScene(), generated::BuildLight());
+  kernel.SetPathKernel(generated::PropagatePath);
+  builtin.Render(1);
+  loaded.Render(1);
+  kernel.Render(1);
+
+  auto expected = ReadPixels(builtin.image_);
+  EXPECT_EQ(ReadPixels(loaded.image_), expected);
+  auto actual = ReadPixels(kernel.image_);
+  size_t matching = 0;
+  double expected_total = 0, actual_total = 0;
+  for (size_t i = 0; i < expected.size(); i++) {
+    matching += std::abs(actual[i] - expected[i]) <= 1e-9 * (1 + expected[i]);
+    expected_total += expected[i];
+    actual_total += actual[i];
+  }
+  EXPECT_GT(expected_total, 0);
+  // Closed-set builds break ties between shapes in another order.
+  EXPECT_GT(matching, expected.size() * 0.999);
+  EXPECT_NEAR(actual_total, expected_total, 1e-6 * expected_total);
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,117 @@
+#include "core/sequence.h"
+#include <gtest/gtest.h>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+#include "core/scene_file.h"
+
+namespace RayTracer2D {
+
+// A white box with a mirror ball and a white ball, both animated, and a point
+// light moving the other way.
+static const char *kScene =
+    "material white scattering\n"
+    "material mirror reflective\n"
+    "wall -2 -2 -2 2 white\n"
+    "wall -2 2 2 2 white\n"
+    "wall 2 2 2 -2 white\n"
+    "wall 2 -2 -2 -2 white\n"
+    "circle 1 1 0.5 mirror\n"
+    "circle -1 1.5 0.1 white\n"
+    "light point -0.5 0.2 1 1 1\n"
+    "key 0 4 0 0\n"
+    "key 1 4 -0.5 0.25\n"
+    "key 0.5 5 0.25 0\n"
+    "key 0 light 0 0\n"
+    "key 1 light 0.5 -0.5\n";
+
+static auto Parse(const char *text, SceneDescription &description) -> bool {
+  std::istringstream is(text);
+  return ParseSceneDescription(is, "test", description);
+}
+
+static auto ReadFile(const std::string &path) -> std::string {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+TEST(SequenceTest, TracksInterpolateKeys) {
+  auto description = SceneDescription{};
+  ASSERT_TRUE(Parse(kScene, description));
+  EXPECT_FALSE(Parse("material m reflective\ncircle 0 0 1 m\nkey 0 1 0 0\nlight point 0 0 1 1 1\n", description));
+  EXPECT_FALSE(Parse("material m reflective\ncircle 0 0 1 m\nkey 2 0 0 0\nlight point 0 0 1 1 1\n", description));
+  ASSERT_TRUE(Parse(kScene, description));
+
+  auto tracks = MakeTracks(description);
+  ASSERT_EQ(tracks.size(), 3u);
+  EXPECT_EQ(tracks[0].shape_, 4u);
+  EXPECT_EQ(tracks[0].At(0.5), Point2d(-0.25, 0.125));
+  EXPECT_EQ(tracks[0].At(2), Point2d(-0.5, 0.25));
+  // A single key holds for the whole sequence.
+  EXPECT_EQ(tracks[1].At(0), Point2d(0.25, 0));
+  EXPECT_EQ(tracks[1].At(1), Point2d(0.25, 0));
+  EXPECT_FALSE(tracks[2].shape_);
+  EXPECT_EQ(tracks[2].At(0.25), Point2d(0.125, -0.125));
+
+  EXPECT_EQ(SequenceRenderer::FramePath("out/f_%03d.qoi", 7), "out/f_007.qoi");
+  EXPECT_EQ(SequenceRenderer::FramePath("out/f_%d.qoi", 1234), "out/f_1234.qoi");
+  EXPECT_EQ(SequenceRenderer::FramePath("out/f_%02d.qoi", 1234), "out/f_1234.qoi");
+  // Anything printf would interpret beyond one frame number is rejected.
+  EXPECT_EQ(SequenceRenderer::FramePath("out/f_%03zu.qoi", 7), "");
+  EXPECT_EQ(SequenceRenderer::FramePath("out/f_%s.qoi", 7), "");
+  EXPECT_EQ(SequenceRenderer::FramePath("out/%d_%n.qoi", 7), "");
+  EXPECT_EQ(SequenceRenderer::FramePath("out/%3d.qoi", 7), "");
+  EXPECT_EQ(SequenceRenderer::FramePath("out/%099d.qoi", 7), "");
+  EXPECT_EQ(SequenceRenderer::FramePath("out/f_%", 7), "");
+  EXPECT_EQ(SequenceRenderer::FramePath("out.v2/frame.ppm", 12), "out.v2/frame_0012.ppm");
+  EXPECT_EQ(SequenceRenderer::FramePath("out.v2/frame", 3), "out.v2/frame_0003");
+}
+
+// Moving the objects in place and writing in the background gives the frames
+// of scenes built at every time from scratch.
+TEST(SequenceTest, FramesMatchSeparateRenders) {
+  auto description = SceneDescription{};
+  ASSERT_TRUE(Parse(kScene, description));
+  auto option = Options(64, 64, 20000, 4);
+  option.threads_ = 1;
+  option.progress_ = false;
+  const auto pattern = testing::TempDir() + "sequence_%d.ppm";
+  constexpr size_t kFrames = 3;
+
+  auto animated = RayTracer(option, BuildScene(description), BuildLight(description));
+  auto sequence = SequenceRenderer(animated, MakeTracks(description));
+  ASSERT_TRUE(sequence.Render(kFrames, pattern));
+
+  const auto tracks = MakeTracks(description);
+  for (size_t frame = 0; frame < kFrames; frame++) {
+    const auto time = static_cast<double>(frame) / (kFrames - 1);
+    auto moved = description;
+    for (const auto &track : tracks) {
+      const auto offset = track.At(time);
+      if (track.shape_) {
+        moved.shapes_[*track.shape_].x0_ += offset.x;
+        moved.shapes_[*track.shape_].y0_ += offset.y;
+      } else {
+        moved.light_.x_ += offset.x;
+        moved.light_.y_ += offset.y;
+      }
+    }
+    auto rt = RayTracer(option, BuildScene(moved), BuildLight(moved));
+    rt.Render();
+    rt.image_.AdjustGamma();
+    for (const auto &shape : *rt.scene_) {
+      shape->Render(rt.image_);
+    }
+    const auto path = testing::TempDir() + "reference.ppm";
+    ASSERT_TRUE(rt.image_.Write(path, 1));
+    const auto expected = ReadFile(path);
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(ReadFile(SequenceRenderer::FramePath(pattern, frame)), expected) << "frame " << frame;
+  }
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,98 @@
+#include "core/sparse_accumulator.h"
+#include <gtest/gtest.h>
+#include <vector>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+
+namespace RayTracer2D {
+
+// Every pass touches all tiles, so with room for two of them most tiles are
+// spilled after each pass and reloaded by the next one.
+TEST(SparseAccumulatorTest, SpilledTilesReloadTheirContent) {
+  constexpr size_t kSx = 100, kSy = 70, kTile = 16;
+  constexpr size_t kTileBytes = kTile * kTile * 3 * sizeof(double);
+  auto sparse = SparseAccumulator(kSx, kSy, kTile, 2 * kTileBytes, "/tmp");
+  auto dense = std::vector<double>(kSx * kSy * 3);
+  for (size_t pass = 0; pass < 4; pass++) {
+    for (size_t y = pass; y < kSy; y += 3) {
+      for (size_t x = 0; x < kSx; x++) {
+        const auto v = static_cast<double>(x * 7 + y * 13 + pass) / 64;
+        auto *pixel = sparse.Pixel(x, y);
+        auto *expected = &dense[(y * kSx + x) * 3];
+        for (size_t c = 0; c < 3; c++) {
+          pixel[c] += v + c;
+          expected[c] += v + c;
+        }
+      }
+    }
+    sparse.Trim();
+    EXPECT_LE(sparse.ResidentBytes(), 2 * kTileBytes);
+  }
+
+  for (size_t y = 0; y < kSy; y++) {
+    for (size_t x = 0; x < kSx; x++) {
+      const auto *pixel = sparse.Peek(x, y);
+      ASSERT_NE(pixel, nullptr);
+      for (size_t c = 0; c < 3; c++) {
+        ASSERT_EQ(pixel[c], dense[(y * kSx + x) * 3 + c]) << x << " " << y;
+      }
+    }
+  }
+}
+
+// A budget far below the lit tiles makes every batch spill and reload, the
+// frame still matches the dense accumulator bit for bit.
+TEST(SparseAccumulatorTest, SpillingRenderMatchesDense) {
+  auto option = Options(512, 512, 6000, 6);
+  option.batch_size_ = 500;
+  option.tile_size_ = 16;
+  auto dense = RayTracer(option);
+  dense.Render(1);
+  option.sparse_ = true;
+  option.memory_budget_mb_ = 1;
+  auto sparse = RayTracer(option);
+  sparse.Render(1);
+
+  auto expected = std::vector<double>(option.sx_ * 3);
+  auto actual = std::vector<double>(option.sx_ * 3);
+  double total = 0;
+  for (size_t y = 0; y < option.sy_; y++) {
+    dense.image_.ReadRow(y, expected.data());
+    sparse.image_.ReadRow(y, actual.data());
+    for (size_t i = 0; i < expected.size(); i++) {
+      ASSERT_EQ(actual[i], expected[i]) << y;
+      total += expected[i];
+    }
+  }
+  EXPECT_GT(total, 0);
+}
+
+// Outlines are drawn after tone mapping, partly on tiles no ray touched: those
+// must start at the tone-mapped background, like the dense pixels they mirror.
+TEST(SparseAccumulatorTest, DrawingAfterToneMappingMatchesDense) {
+  auto option = Options(256, 256, 20, 2);
+  option.progress_ = false;
+  option.tile_size_ = 16;
+  auto dense = RayTracer(option);
+  option.sparse_ = true;
+  auto sparse = RayTracer(option);
+  for (auto *rt : {&dense, &sparse}) {
+    rt->Render(1);
+    rt->image_.AdjustGamma();
+    for (const auto &shape : *rt->scene_) {
+      shape->Render(rt->image_);
+    }
+  }
+
+  auto expected = std::vector<double>(option.sx_ * 3);
+  auto actual = std::vector<double>(option.sx_ * 3);
+  for (size_t y = 0; y < option.sy_; y++) {
+    dense.image_.ReadRow(y, expected.data());
+    sparse.image_.ReadRow(y, actual.data());
+    for (size_t i = 0; i < expected.size(); i++) {
+      ASSERT_EQ(actual[i], expected[i]) << y;
+    }
+  }
+}
+
+}  // namespace RayTracer2D
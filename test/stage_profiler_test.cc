@@ -0,0 +1,88 @@
+#include "core/stage_profiler.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include "core/generated_scene.h"
+#include "core/options.h"
+#include "core/ray_tracer.h"
+
+namespace RayTracer2D {
+
+// Calls and seconds of every stage in a JSON profile.
+static auto ReadProfile(const std::string &path) -> std::map<std::string, std::pair<unsigned long, double>> {
+  std::map<std::string, std::pair<unsigned long, double>> stages;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    char name[32];
+    unsigned long calls;
+    double seconds;
+    if (sscanf(line.c_str(), " {\"stage\": \"%31[a-z]\", \"calls\": %lu, \"seconds\": %lf", name, &calls,
+               &seconds) == 3) {
+      stages[name] = {calls, seconds};
+    }
+  }
+  return stages;
+}
+
+// Without RT2D_PERF_COUNTERS profiling can not be turned on. With it, every
+// stage of a direct render is counted, whether or not the counters open.
+TEST(StageProfilerTest, AttributesStages) {
+  if (!kStageProfiling) {
+    StageProfiler::Enable();
+    EXPECT_FALSE(StageProfiler::enabled());
+    GTEST_SKIP() << "built without RT2D_PERF_COUNTERS";
+  }
+  auto option = Options(64, 64, 1000, 4);
+  option.progress_ = false;
+  auto rt = RayTracer(option);
+  StageProfiler::Reset();
+  StageProfiler::Enable();
+  rt.Render(1);
+  {
+    StageScope scope(Stage::kOutput);
+    rt.image_.AdjustGamma();
+  }
+  StageProfiler::Disable();
+
+  const auto path = testing::TempDir() + "stage_profiler_test.json";
+  ASSERT_TRUE(StageProfiler::WriteJson(path));
+  auto stages = ReadProfile(path);
+  ASSERT_EQ(stages.size(), kNumStages);
+  EXPECT_EQ(stages["emission"].first, option.num_rays_);
+  EXPECT_GE(stages["intersection"].first, option.num_rays_);
+  // Every hit is shaded and its segment splatted within the shading.
+  EXPECT_EQ(stages["shading"].first, stages["intersection"].first);
+  EXPECT_EQ(stages["splatting"].first, stages["intersection"].first);
+  EXPECT_EQ(stages["output"].first, 1u);
+  for (const auto &[name, stage] : stages) {
+    EXPECT_GT(stage.second, 0) << name;
+  }
+}
+
+// The bounces of a generated scene kernel switch stages like the generic loop.
+TEST(StageProfilerTest, AttributesKernelBounces) {
+  if (!kStageProfiling) {
+    GTEST_SKIP() << "built without RT2D_PERF_COUNTERS";
+  }
+  auto option = Options(64, 64, 1000, 4);
+  option.progress_ = false;
+  auto rt = RayTracer(option, generated::BuildScene(), generated::BuildLight());
+  rt.SetPathKernel(generated::PropagatePath);
+  StageProfiler::Reset();
+  StageProfiler::Enable();
+  rt.Render(1);
+  StageProfiler::Disable();
+
+  const auto path = testing::TempDir() + "stage_profiler_kernel_test.json";
+  ASSERT_TRUE(StageProfiler::WriteJson(path));
+  auto stages = ReadProfile(path);
+  EXPECT_EQ(stages["emission"].first, option.num_rays_);
+  EXPECT_GE(stages["intersection"].first, option.num_rays_);
+  EXPECT_EQ(stages["shading"].first, stages["intersection"].first);
+  EXPECT_EQ(stages["splatting"].first, stages["intersection"].first);
+}
+
+}  // namespace RayTracer2D
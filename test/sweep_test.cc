@@ -0,0 +1,82 @@
+#include "core/sweep.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "core/options.h"
+#include "core/ray_tracer.h"
+#include "core/scene_file.h"
+#include "material/scattering.h"
+#include "test_scene.h"
+
+namespace RayTracer2D {
+
+// A grey box with a swept ball and a swept wall, lit by a point light.
+static const char *kScene =
+    "material grey scattering uniform 0.5 0.5 0.5\n"
+    "material paint scattering cosine\n"
+    "material mirror reflective\n"
+    "wall -2 -2 -2 2 grey\n"
+    "wall -2 2 2 2 grey\n"
+    "wall 2 2 2 -2 paint\n"
+    "wall 2 -2 -2 -2 grey\n"
+    "circle 0.5 0.5 0.4 paint\n"
+    "circle -1 1 0.3 mirror\n"
+    "light point -0.5 -0.5 1 1 1\n";
+
+static auto MakeRayTracer(const Options &option) -> std::unique_ptr<RayTracer> {
+  std::istringstream is(kScene);
+  auto description = SceneDescription{};
+  EXPECT_TRUE(ParseSceneDescription(is, "test", description));
+  return std::make_unique<RayTracer>(option, BuildScene(description), BuildLight(description));
+}
+
+// Every variant is the image a separate render with its albedo would give.
+TEST(SweepTest, VariantsMatchSeparateRenders) {
+  constexpr MaterialId kPaint = 1;
+  auto option = Options(64, 64, 20000, 6);
+  option.progress_ = false;
+  option.batch_size_ = 4096;
+  const auto albedos = std::vector<Colour>{Colour(1, 1, 1), Colour(0.8, 0.2, 0.4), Colour(0, 0.5, 1)};
+
+  auto rt = MakeRayTracer(option);
+  ASSERT_TRUE(SweepRenderer::Supports(*rt, kPaint));
+  EXPECT_FALSE(SweepRenderer::Supports(*rt, 2));
+  EXPECT_FALSE(SweepRenderer::Supports(*rt, 3));
+  auto sweep = SweepRenderer(*rt, kPaint, albedos);
+  ASSERT_TRUE(sweep.Render(2));
+  ASSERT_EQ(sweep.size(), albedos.size());
+  // The material is left as it was, white.
+  const auto &albedo = dynamic_cast<ScatteringMaterial *>(rt->scene_->material(kPaint))->albedo();
+  EXPECT_EQ(albedo.R_ + albedo.G_ + albedo.B_, 3);
+
+  for (size_t v = 0; v < albedos.size(); v++) {
+    auto separate = MakeRayTracer(option);
+    dynamic_cast<ScatteringMaterial *>(separate->scene_->material(kPaint))->set_albedo(albedos[v]);
+    separate->Render(1);
+    const auto expected = ReadPixels(separate->image_);
+    const auto actual = ReadPixels(sweep.image(v));
+    double total = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+      ASSERT_NEAR(actual[i], expected[i], 1e-9 * std::max(1.0, expected[i])) << "variant " << v << ", value " << i;
+      total += expected[i];
+    }
+    EXPECT_GT(total, 0);
+  }
+}
+
+// Sweeping a mirror or a missing material is refused, not traced.
+TEST(SweepTest, RefusesMaterialsWithoutAlbedo) {
+  auto option = Options(16, 16, 100, 4);
+  option.progress_ = false;
+  auto rt = MakeRayTracer(option);
+  for (MaterialId material : {2, 3}) {
+    auto sweep = SweepRenderer(*rt, material, {Colour(1, 1, 1)});
+    EXPECT_FALSE(sweep.Render(1));
+    EXPECT_EQ(sweep.size(), 0u);
+  }
+}
+
+}  // namespace RayTracer2D
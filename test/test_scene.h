@@ -0,0 +1,63 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+#include "core/colour.h"
+#include "core/image.h"
+#include "core/material_registry.h"
+#include "core/options.h"
+#include "core/point.h"
+#include "core/ray_tracer.h"
+#include "core/scene.h"
+#include "light/point_light.h"
+#include "material/reflective.h"
+#include "material/scattering.h"
+#include "utils/constants.h"
+
+// Scenes and helpers shared by the tests.
+
+namespace RayTracer2D {
+
+// Close the world with four walls of `material`, so that every ray hits a
+// shape.
+inline void AddBox(Scene *scene, const MaterialId material) {
+  scene->AddWall(kTopLeft, kTopRight, material);
+  scene->AddWall(kTopRight, kBottomRight, material);
+  scene->AddWall(kBottomRight, kBottomLeft, material);
+  scene->AddWall(kBottomLeft, kTopLeft, material);
+}
+
+// `scene` lit by a white point light at `light`.
+inline auto MakeRayTracer(const Options &option, std::unique_ptr<Scene> scene, const Point2d &light)
+    -> std::unique_ptr<RayTracer> {
+  return std::make_unique<RayTracer>(option, std::move(scene),
+                                     std::make_unique<PointLight>(light, Colour(1, 1, 1)));
+}
+
+// A point light in a white box with one mirror ball, built through the
+// library API.
+inline auto MakeMirrorBallTracer(const Options &option) -> std::unique_ptr<RayTracer> {
+  auto scene = std::make_unique<Scene>();
+  auto white = scene->AddMaterial<ScatteringMaterial>();
+  auto mirror = scene->AddMaterial<ReflectiveMaterial>();
+  scene->AddCircle(Point2d(1, 1), 0.5, mirror);
+  AddBox(scene.get(), white);
+  return MakeRayTracer(option, std::move(scene), Point2d(-0.5, 0.2));
+}
+
+// The built-in demo scene.
+inline auto MakeDefaultTracer(const Options &option) -> std::unique_ptr<RayTracer> {
+  return std::make_unique<RayTracer>(option);
+}
+
+// Every row of the accumulator, whatever its format.
+inline auto ReadPixels(const Image &image) -> std::vector<double> {
+  auto pixels = std::vector<double>(image.sx_ * image.sy_ * 3);
+  for (size_t y = 0; y < image.sy_; y++) {
+    image.ReadRow(y, &pixels[y * image.sx_ * 3]);
+  }
+  return pixels;
+}
+
+}  // namespace RayTracer2D
@@ -0,0 +1,205 @@
+// Generates a C++ translation unit specialized for one scene description: the
+// geometry becomes constexpr tables, the shape loop of a path is unrolled into
+// one intersection per shape and every bounce calls its final material
+// directly. Used through `rt2d_add_scene_executable` in CMakeLists.txt.
+//
+// USAGE: SceneCodegen input.scene output.cc
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include "core/scene_file.h"
+
+using namespace RayTracer2D;
+
+// Shortest form that reads back as the same double.
+static auto Literal(const double x) -> std::string {
+  char buffer[32];
+  for (int precision = 1; precision <= 17; precision++) {
+    snprintf(buffer, sizeof(buffer), "%.*g", precision, x);
+    if (strtod(buffer, nullptr) == x) {
+      break;
+    }
+  }
+  return buffer;
+}
+
+// C++ string literal of `s`.
+static auto StringLiteral(const std::string &s) -> std::string {
+  std::string literal = "\"";
+  for (auto c : s) {
+    if (c == '"' || c == '\\') {
+      literal += '\\';
+    }
+    literal += c;
+  }
+  return literal + "\"";
+}
+
+static auto MaterialType(const SceneDescription::MaterialSpec &material) -> const char * {
+  switch (material.kind_) {
+    case SceneDescription::MaterialKind::kScattering:
+      return "ScatteringMaterial";
+    case SceneDescription::MaterialKind::kReflective:
+      return "ReflectiveMaterial";
+    default:
+      return "RefractiveMaterial";
+  }
+}
+
+static void Generate(const SceneDescription &description, const std::string &name, std::ostream &os) {
+  const auto &shapes = description.shapes_;
+  os << "// Generated by SceneCodegen from " << name << ", do not edit.\n\n";
+  os << "#include \"core/generated_scene.h\"\n";
+  os << "#include <limits>\n";
+  os << "#include \"core/stage_profiler.h\"\n";
+  os << "#include \"light/laser_light.h\"\n";
+  os << "#include \"light/point_light.h\"\n";
+  os << "#include \"light/ray_file_light.h\"\n";
+  os << "#include \"material/reflective.h\"\n";
+  os << "#include \"material/refractive.h\"\n";
+  os << "#include \"material/scattering.h\"\n";
+  os << "#include \"shapes/circle.h\"\n";
+  os << "#include \"shapes/wall.h\"\n\n";
+  os << "namespace RayTracer2D::generated {\n\n";
+
+  os << "const char kSceneName[] = " << StringLiteral(name) << ";\n\n";
+
+  // Shapes keep their description index, circles as (cx, cy, r) and walls as
+  // (x0, y0, x1, y1).
+  os << "namespace {\n\n";
+  os << "struct ShapeData {\n  double a_, b_, c_, d_;\n};\n\n";
+  os << "constexpr ShapeData kShapes[] = {\n";
+  for (const auto &shape : shapes) {
+    if (shape.kind_ == SceneDescription::ShapeKind::kCircle) {
+      os << "    {" << Literal(shape.x0_) << ", " << Literal(shape.y0_) << ", " << Literal(shape.r_) << ", 0},\n";
+    } else {
+      os << "    {" << Literal(shape.x0_) << ", " << Literal(shape.y0_) << ", " << Literal(shape.x1_) << ", "
+         << Literal(shape.y1_) << "},\n";
+    }
+  }
+  os << "};\n\n";
+  os << "}  // namespace\n\n";
+
+  os << "auto BuildScene() -> std::unique_ptr<Scene> {\n";
+  os << "  auto scene = std::make_unique<Scene>();\n";
+  for (const auto &material : description.materials_) {
+    os << "  scene->AddMaterial<" << MaterialType(material) << ">(";
+    if (material.kind_ == SceneDescription::MaterialKind::kScattering) {
+      os << (material.distribution_ == ScatterDistribution::kCosine ? "ScatterDistribution::kCosine"
+                                                                    : "ScatterDistribution::kUniform");
+      const auto &albedo = material.albedo_;
+      if (albedo.R_ != 1 || albedo.G_ != 1 || albedo.B_ != 1) {
+        os << ", Colour(" << Literal(albedo.R_) << ", " << Literal(albedo.G_) << ", " << Literal(albedo.B_) << ")";
+      }
+    } else if (material.kind_ == SceneDescription::MaterialKind::kRefractive) {
+      os << Literal(material.index_);
+    }
+    os << ");  // " << material.name_ << "\n";
+  }
+  for (size_t i = 0; i < shapes.size(); i++) {
+    const auto s = "kShapes[" + std::to_string(i) + "]";
+    if (shapes[i].kind_ == SceneDescription::ShapeKind::kCircle) {
+      os << "  scene->AddCircle(Point2d(" << s << ".a_, " << s << ".b_), " << s << ".c_, " << shapes[i].material_
+         << ");\n";
+    } else {
+      os << "  scene->AddWall(Point2d(" << s << ".a_, " << s << ".b_), Point2d(" << s << ".c_, " << s << ".d_), "
+         << shapes[i].material_ << ");\n";
+    }
+  }
+  os << "  return scene;\n}\n\n";
+
+  const auto &light = description.light_;
+  const auto colour = "Colour(" + Literal(light.r_) + ", " + Literal(light.g_) + ", " + Literal(light.b_) + ")";
+  os << "auto BuildLight() -> std::unique_ptr<Light> {\n";
+  if (!light.ray_file_.empty()) {
+    // Resolved from the working directory at run time, like the runtime
+    // loader does.
+    os << "  return RayFileLight::Open(" << StringLiteral(light.ray_file_) << ", RayFileLight::Mode::"
+       << (light.sequential_ ? "kSequential" : "kRandom") << ");\n";
+  } else if (light.laser_) {
+    os << "  return std::make_unique<LaserLight>(Point2d(" << Literal(light.x_) << ", " << Literal(light.y_)
+       << "), Point2d(" << Literal(light.dx_) << ", " << Literal(light.dy_) << ").Normalize(), " << colour << ");\n";
+  } else {
+    os << "  return std::make_unique<PointLight>(Point2d(" << Literal(light.x_) << ", " << Literal(light.y_) << "), "
+       << colour << ");\n";
+  }
+  os << "}\n\n";
+
+  // Same steps and stages as RayTracer::PropagateRayDynamic, with ties going
+  // to the first shape in description order like Scene::FindFirstHit.
+  os << "void PropagatePath(RayTracer &rt, Ray ray, const size_t depth, SegmentBuffer *segments) {\n";
+  os << "  StageScope scope(Stage::kIntersection);\n";
+  os << "  const auto &scene = *rt.scene_;\n";
+  for (size_t i = 0; i < shapes.size(); i++) {
+    os << "  Shape *const shape" << i << " = scene.shape(" << i << ");\n";
+    os << "  auto *const material" << i << " = static_cast<"
+       << MaterialType(description.materials_[shapes[i].material_]) << " *>(shape" << i << "->material());\n";
+  }
+  os << "  for (size_t i = 0; i < depth; i++) {\n";
+  os << "    if (i + 1 == depth && rt.CullLastBounce(ray)) {\n      break;\n    }\n";
+  os << "    scope.Switch(Stage::kIntersection);\n";
+  os << "    auto t_hit = std::numeric_limits<double>::infinity();\n";
+  os << "    int hit = -1;\n";
+  for (size_t i = 0; i < shapes.size(); i++) {
+    const auto s = "kShapes[" + std::to_string(i) + "]";
+    os << "    if (auto t = ";
+    if (shapes[i].kind_ == SceneDescription::ShapeKind::kCircle) {
+      os << "Circle::IntersectCircle(Point2d(" << s << ".a_, " << s << ".b_), " << s << ".c_, ray, ray.origin_ == shape"
+         << i << ")";
+    } else {
+      os << "Wall::IntersectWall(Point2d(" << s << ".a_, " << s << ".b_), Point2d(" << s << ".c_ - " << s << ".a_, "
+         << s << ".d_ - " << s << ".b_), ray, ray.origin_ == shape" << i << ")";
+    }
+    os << "; t && *t < t_hit) {\n      t_hit = *t;\n      hit = " << i << ";\n    }\n";
+  }
+  os << "    if (hit < 0) {\n      rt.CountEscape();\n      break;\n    }\n";
+  os << "    scope.Switch(Stage::kShading);\n";
+  os << "    rt.CountHit(t_hit);\n";
+  os << "    const auto p = ray(t_hit);\n";
+  os << "    switch (hit) {\n";
+  for (size_t i = 0; i < shapes.size(); i++) {
+    const auto s = "kShapes[" + std::to_string(i) + "]";
+    os << "      case " << i << ": {\n";
+    if (shapes[i].kind_ == SceneDescription::ShapeKind::kCircle) {
+      os << "        const auto n = Circle::CircleNormal(Point2d(" << s << ".a_, " << s << ".b_), ray, p);\n";
+    } else {
+      os << "        const auto n = Wall::WallNormal(Point2d(" << s << ".c_ - " << s << ".a_, " << s << ".d_ - " << s
+         << ".b_), ray);\n";
+    }
+    os << "        rt.EmitSegment(ray, p, segments);\n";
+    os << "        auto next = material" << i << "->Interact(ray, p, n);\n";
+    os << "        RayTracer::ContinuePath(ray, next, shape" << i << ", n);\n";
+    os << "        ray = next;\n";
+    os << "        break;\n";
+    os << "      }\n";
+  }
+  os << "    }\n";
+  os << "  }\n";
+  os << "}\n\n";
+  os << "}  // namespace RayTracer2D::generated\n";
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "USAGE: SceneCodegen input.scene output.cc\n");
+    return 1;
+  }
+  auto description = SceneDescription{};
+  if (!LoadSceneDescription(argv[1], description)) {
+    return 1;
+  }
+  if (description.shapes_.empty()) {
+    fprintf(stderr, "%s: no shapes\n", argv[1]);
+    return 1;
+  }
+
+  std::ofstream file(argv[2]);
+  Generate(description, argv[1], file);
+  if (!file) {
+    fprintf(stderr, "can not write %s\n", argv[2]);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,202 @@
+// Offline analysis of traces written with RayTracer --trace.
+//
+// USAGE: TraceReplay trace.bin [options]
+//   --shape=ID - Only keep paths that hit shape ID
+//   --min-depth=N, --max-depth=N - Only keep vertices of these bounces
+//   --render=FILE - Re-rasterize the kept segments into FILE (PPM or QOI)
+//   --size=WxH - Size of the re-rasterized image (default: the traced one),
+//                which shows the traced view of the world
+//   --stats - Print depth, shape and material histograms (default without --render)
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "core/colour.h"
+#include "core/image.h"
+#include "core/options.h"
+#include "core/path_recorder.h"
+#include "core/point.h"
+#include "core/ray.h"
+#include "core/shape.h"
+
+using namespace RayTracer2D;
+
+// Number of consecutive bounces back to the shape hit two bounces before after
+// which a path counts as trapped, e.g. between two facing mirrors.
+static constexpr size_t kTrappedRun = 8;
+
+struct Filter {
+  uint32_t shape_{kNoId};
+  uint32_t min_depth_{0};
+  uint32_t max_depth_{UINT16_MAX};
+};
+
+struct Stats {
+  std::map<uint32_t, uint64_t> depths_;
+  std::map<uint32_t, uint64_t> shapes_;
+  std::map<uint32_t, uint64_t> materials_;
+  uint64_t paths_{0};
+  uint64_t hits_{0};
+  double total_t_{0};
+  uint64_t trapped_{0};
+};
+
+static void Usage() {
+  fprintf(stderr, "USAGE: TraceReplay trace.bin [--shape=ID] [--min-depth=N] [--max-depth=N]\n");
+  fprintf(stderr, "                   [--render=FILE] [--size=WxH] [--stats]\n");
+  exit(1);
+}
+
+// Longest run of hits going back to the shape hit two bounces before. The
+// first vertex is the emission.
+static size_t LongestAlternation(const std::vector<PathRecord> &path) {
+  size_t longest = 0, run = 0;
+  for (size_t i = 3; i < path.size(); i++) {
+    run = path[i].shape_ == path[i - 2].shape_ && path[i].shape_ != path[i - 1].shape_ ? run + 1 : 0;
+    longest = std::max(longest, run);
+  }
+  return longest;
+}
+
+static void Replay(const std::vector<PathRecord> &path, const Filter &filter, Stats &stats, Image *image) {
+  if (filter.shape_ != kNoId &&
+      std::none_of(path.begin(), path.end(), [&](const PathRecord &r) { return r.shape_ == filter.shape_; })) {
+    return;
+  }
+  stats.paths_++;
+  if (LongestAlternation(path) >= kTrappedRun) {
+    stats.trapped_++;
+  }
+  for (size_t i = 0; i < path.size(); i++) {
+    const auto &r = path[i];
+    if (r.depth_ < filter.min_depth_ || r.depth_ > filter.max_depth_) {
+      continue;
+    }
+    stats.depths_[r.depth_]++;
+    if (r.depth_ == 0) {
+      continue;
+    }
+    stats.hits_++;
+    stats.total_t_ += r.t_;
+    stats.shapes_[r.shape_]++;
+    stats.materials_[r.material_]++;
+    // The segment ending at this hit starts at the previous vertex.
+    if (image != nullptr && i > 0) {
+      const auto &from = path[i - 1];
+      auto ray = Ray(Point2d(from.x_, from.y_), Point2d(r.x_ - from.x_, r.y_ - from.y_), Colour(r.r_, r.g_, r.b_));
+      ray.Render(*image, Point2d(r.x_, r.y_));
+    }
+  }
+}
+
+static void PrintHistogram(const char *title, const std::map<uint32_t, uint64_t> &histogram) {
+  printf("%s\n", title);
+  for (const auto &[key, count] : histogram) {
+    if (key == kNoId) {
+      printf("  %8s %12lu\n", "none", static_cast<unsigned long>(count));
+    } else {
+      printf("  %8u %12lu\n", key, static_cast<unsigned long>(count));
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    Usage();
+  }
+  auto filter = Filter{};
+  std::string render_path;
+  size_t sx = 0, sy = 0;
+  bool stats_requested = false;
+  for (int i = 2; i < argc; i++) {
+    auto arg = std::string(argv[i]);
+    auto eq = arg.find('=');
+    auto key = arg.substr(0, eq);
+    auto value = eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+    if (key == "--shape" && !value.empty()) {
+      filter.shape_ = atoi(value.c_str());
+    } else if (key == "--min-depth" && !value.empty()) {
+      filter.min_depth_ = atoi(value.c_str());
+    } else if (key == "--max-depth" && !value.empty()) {
+      filter.max_depth_ = atoi(value.c_str());
+    } else if (key == "--render" && !value.empty()) {
+      render_path = value;
+    } else if (key == "--size") {
+      if (sscanf(value.c_str(), "%zux%zu", &sx, &sy) != 2 || sx == 0 || sy == 0) {
+        Usage();
+      }
+    } else if (key == "--stats") {
+      stats_requested = true;
+    } else {
+      fprintf(stderr, "Unknown or malformed option '%s'\n", argv[i]);
+      Usage();
+    }
+  }
+
+  auto reader = TraceReader(argv[1]);
+  if (!reader.ok()) {
+    fprintf(stderr, "%s is not a path trace\n", argv[1]);
+    return 1;
+  }
+  const auto &header = reader.header();
+  std::unique_ptr<Image> image;
+  if (!render_path.empty()) {
+    auto option = Options(sx > 0 ? sx : header.sx_, sy > 0 ? sy : header.sy_, 1, header.depth_);
+    option.world_ = header.world_;
+    const auto &view = header.view_;
+    const auto &world = header.world_;
+    if (view.left_ != world.left_ || view.top_ != world.top_ || view.right_ != world.right_ ||
+        view.bottom_ != world.bottom_) {
+      option.roi_ = view;
+    }
+    image = std::make_unique<Image>(option);
+  }
+
+  // Records of a path are in order, but the paths of different threads are
+  // interleaved: gather them by path and replay each one once it is complete,
+  // that is when its deepest vertex arrives, or at the end of the trace.
+  auto stats = Stats{};
+  auto open = std::unordered_map<uint64_t, std::vector<PathRecord>>();
+  auto record = PathRecord{};
+  uint64_t records = 0;
+  while (reader.Next(record)) {
+    records++;
+    auto &path = open[record.path_];
+    if (record.depth_ == 0 && !path.empty()) {
+      // A dropped tail: the path id came around again in limit mode.
+      Replay(path, filter, stats, image.get());
+      path.clear();
+    }
+    path.push_back(record);
+    if (record.depth_ >= header.depth_) {
+      Replay(path, filter, stats, image.get());
+      open.erase(record.path_);
+    }
+  }
+  for (const auto &[id, path] : open) {
+    Replay(path, filter, stats, image.get());
+  }
+
+  if (image) {
+    image->AdjustGamma();
+    if (!image->Write(render_path, 0)) {
+      return 1;
+    }
+  }
+  if (stats_requested || !image) {
+    printf("%lu records, %lu paths (one in %lu), image %ux%u, depth %u\n", static_cast<unsigned long>(records),
+           static_cast<unsigned long>(stats.paths_), static_cast<unsigned long>(header.sample_every_), header.sx_,
+           header.sy_, header.depth_);
+    printf("mean hit distance %.6f\n", stats.hits_ > 0 ? stats.total_t_ / stats.hits_ : 0.0);
+    printf("trapped paths (%zu+ alternating bounces) %lu\n", kTrappedRun, static_cast<unsigned long>(stats.trapped_));
+    PrintHistogram("vertices per depth", stats.depths_);
+    PrintHistogram("hits per shape", stats.shapes_);
+    PrintHistogram("hits per material", stats.materials_);
+  }
+  return 0;
+}